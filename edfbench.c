@@ -0,0 +1,1797 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+/* Measures the throughput of the generator, the generation stage (waveform kernels, noise generators
+ * and conversion to digital samples) and the write stage (edflib) are timed separately.
+ * Every case of the sweep (waveform, filetype, number of signals, samplerate and datarecord duration)
+ * is generated with the scalar reference kernels and with the SIMD kernels selected for this cpu,
+ * and with the generation loop of edfgenerator 1.10 (per sample sin() and fmod()) as the baseline.
+ * A table is printed to stderr, the results are written to stdout (or a file) as JSON.
+ * With --kernels only the waveform kernels are timed, with --api the sample writing functions of edflib.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "edflib.h"
+#include "utils.h"
+#include "wavegen.h"
+#include "prng.h"
+#include "pinknoise.h"
+#include "generate.h"
+
+#define PROGRAM_NAME       "edfbench"
+#define PROGRAM_VERSION    "1.00"
+
+#define BENCH_WAVES        (6)
+#define BENCH_ENGINES      (4)
+
+#define ENGINE_LEGACY      (0)   /* the generation loop of edfgenerator 1.10 */
+#define ENGINE_SCALAR      (1)   /* the scalar reference kernels */
+#define ENGINE_EXACT       (2)
+#define ENGINE_FAST        (3)
+
+/* number of double arrays in struct legacy_par_struct */
+#define LEGACY_PAR_ARRAYS  (18)
+#define BENCH_MAX_SWEEP    (16)
+
+#define BENCH_ALIGN        (64)
+
+/* the write stage writes the generated datarecords from a buffer of at most this size, again and again */
+#define BENCH_WRITE_BYTES  (16 * 1024 * 1024)
+
+/* the sample writing functions of edflib */
+#define API_WRITE_PHYSICAL         (0)
+#define API_BLOCK_PHYSICAL         (1)
+#define API_WRITE_DIGITAL_SHORT    (2)
+#define API_WRITE_DIGITAL          (3)
+#define API_BLOCK_DIGITAL          (4)
+#define API_BLOCK_DIGITAL_SHORT    (5)
+#define API_BLOCK_DIGITAL_3BYTE    (6)
+#define API_BLOCK_DIGITAL_2BYTE    (7)
+
+#define BENCH_APIS         (8)
+
+
+/* one combination of the sweep */
+struct bench_case_struct
+{
+  int wave;
+  int filetype;
+  int chns;
+  int rate;          /* samplerate in Hz */
+  double duration;   /* datarecord duration in seconds */
+  int sf;            /* samples per datarecord */
+  int datrecs;
+  int recsize;       /* bytes per datarecord */
+};
+
+/* the signals of a case, they are generated by the code of edfgenerator */
+struct bench_sig_struct
+{
+  struct sig_par_struct sp;
+  struct gen_job_struct job;
+  double *scratch;
+};
+
+/* the signal parameters of edfgenerator 1.10, one element per signal */
+struct legacy_par_struct
+{
+  int *sf;
+  int *digmax;
+  int *digmin;
+  int *waveform;
+
+  double *w;
+  double *q;
+  double *sine_1;
+  double *square_1;
+  double *triangle_1;
+  double *signalfreq;
+  double *physmax;
+  double *physmin;
+  double *peakamp;
+  double *dutycycle;
+  double *dc_offset;
+
+  double *b0;
+  double *b1;
+  double *b2;
+  double *b3;
+  double *b4;
+  double *b5;
+  double *b6;
+
+  double **buf;
+
+  int **randbuf;
+
+  double *mem;
+};
+
+struct bench_stage_struct
+{
+  double seconds;
+  long long samples;
+  long long bytes;
+  long long calls;   /* number of calls of the write function, 0 if not applicable */
+};
+
+
+static const char waveforms_str[BENCH_WAVES][16]={"sine", "square", "ramp", "triangle", "white-noise", "pink-noise"};
+
+static const char engines_str[BENCH_ENGINES][16]={"legacy", "scalar", "exact", "fast"};
+
+static const char api_str[BENCH_APIS][40]={"edfwrite_physical_samples",
+                                           "edf_blockwrite_physical_samples",
+                                           "edfwrite_digital_short_samples",
+                                           "edfwrite_digital_samples",
+                                           "edf_blockwrite_digital_samples",
+                                           "edf_blockwrite_digital_short_samples",
+                                           "edf_blockwrite_digital_3byte_samples",
+                                           "edf_blockwrite_digital_2byte_samples"};
+
+
+static int parse_list(const char *, double *, int);
+static void select_engine(int);
+static const char * engine_isa(int, int);
+static int bench_sig_alloc(struct bench_sig_struct *, const struct bench_case_struct *);
+static void bench_sig_free(struct bench_sig_struct *, const struct bench_case_struct *);
+static void bench_sig_reset(struct bench_sig_struct *, const struct bench_case_struct *);
+static int bench_generate(const struct bench_case_struct *, int, struct bench_stage_struct *);
+static int bench_generate_legacy(const struct bench_case_struct *, int, struct bench_stage_struct *);
+static int bench_kernels(const double *, int, const double *, int, long long, int, FILE *);
+static int bench_kernel(const struct bench_case_struct *, int, struct bench_stage_struct *);
+static int legacy_par_alloc(struct legacy_par_struct *, const struct bench_case_struct *);
+static void legacy_par_free(struct legacy_par_struct *, const struct bench_case_struct *);
+static int bench_open(const struct bench_case_struct *, const char *);
+static int bench_write(const struct bench_case_struct *, int, const char *, struct bench_stage_struct *);
+static int bench_api(const double *, int, const double *, int, const double *, int, long long, int, const char *, FILE *);
+static int api_supported(int, int);
+static int bench_api_case(const struct bench_case_struct *, int, const char *, int, struct bench_stage_struct *);
+static void print_stage(FILE *, const char *, const struct bench_stage_struct *);
+static long long bench_time_ns(void);
+
+
+int main(int argc, char **argv)
+{
+  int i, w, t, c, r, d, e,
+      option_index=0,
+      ch=0,
+      n_signals,
+      n_rates,
+      n_durations,
+      repeat=3,
+      api_set=0,
+      kernels_set=0,
+      dir_set=0,
+      first=1;
+
+  long long samples=4000000,
+            per_rec;
+
+  double signals[BENCH_MAX_SWEEP]={1, 16},
+         rates[BENCH_MAX_SWEEP]={500, 8000},
+         durations[BENCH_MAX_SWEEP]={0.25, 1};
+
+  char dir[1024]=".",
+       path[2048]="",
+       json_path[1024]="-";
+
+  FILE *json=stdout;
+
+  struct bench_case_struct bcase;
+
+  struct bench_stage_struct gen,
+                            wr,
+                            tmp;
+
+  struct option long_options[] = {
+    {"signals",   required_argument, 0, 0},  /* 0 */
+    {"rates",     required_argument, 0, 0},  /* 1 */
+    {"durations", required_argument, 0, 0},  /* 2 */
+    {"samples",   required_argument, 0, 0},  /* 3 */
+    {"repeat",    required_argument, 0, 0},  /* 4 */
+    {"dir",       required_argument, 0, 0},  /* 5 */
+    {"json",      required_argument, 0, 0},  /* 6 */
+    {"help",      no_argument,       0, 0},  /* 7 */
+    {"api",       no_argument,       0, 0},  /* 8 */
+    {"kernels",   no_argument,       0, 0},  /* 9 */
+    {0, 0, 0, 0}
+  };
+
+  setlocale(LC_ALL, "C");
+
+  setlinebuf(stderr);
+
+  n_signals = 2;
+  n_rates = 2;
+  n_durations = 2;
+
+  while(1)
+  {
+    ch = getopt_long_only(argc, argv, "", long_options, &option_index);
+
+    if(ch == -1)  break;
+
+    if(ch != 0)
+    {
+      fprintf(stderr, "--help for help\n");
+      return EXIT_FAILURE;
+    }
+
+    if(option_index == 0)  /* signals */
+    {
+      n_signals = parse_list(optarg, signals, 1);
+      if(n_signals < 1)
+      {
+        fprintf(stderr, "illegal value for option %s\n", long_options[option_index].name);
+        return EXIT_FAILURE;
+      }
+    }
+
+    if(option_index == 1)  /* rates */
+    {
+      n_rates = parse_list(optarg, rates, 1);
+      if(n_rates < 1)
+      {
+        fprintf(stderr, "illegal value for option %s\n", long_options[option_index].name);
+        return EXIT_FAILURE;
+      }
+    }
+
+    if(option_index == 2)  /* durations */
+    {
+      n_durations = parse_list(optarg, durations, 0);
+      if(n_durations < 1)
+      {
+        fprintf(stderr, "illegal value for option %s\n", long_options[option_index].name);
+        return EXIT_FAILURE;
+      }
+    }
+
+    if(option_index == 3)  /* samples */
+    {
+      samples = atoll(optarg);
+      if(samples < 1)
+      {
+        fprintf(stderr, "illegal value for option %s\n", long_options[option_index].name);
+        return EXIT_FAILURE;
+      }
+    }
+
+    if(option_index == 4)  /* repeat */
+    {
+      repeat = atoi(optarg);
+      if(repeat < 1)
+      {
+        fprintf(stderr, "illegal value for option %s\n", long_options[option_index].name);
+        return EXIT_FAILURE;
+      }
+    }
+
+    if(option_index == 5)  /* dir */
+    {
+      strlcpy(dir, optarg, 1024);
+
+      dir_set = 1;
+    }
+
+    if(option_index == 8)  /* api */
+    {
+      api_set = 1;
+    }
+
+    if(option_index == 9)  /* kernels */
+    {
+      kernels_set = 1;
+    }
+
+    if(option_index == 6)  /* json */
+    {
+      strlcpy(json_path, optarg, 1024);
+    }
+
+    if(option_index == 7)  /* help */
+    {
+      fprintf(stdout, "\n Usage: " PROGRAM_NAME " [OPTION]...\n"
+        "\n Measures the throughput of the generation stage and the write stage of edfgenerator\n"
+        " for every waveform, EDF and BDF, and every combination of the values below.\n"
+        " The engines: legacy (the per sample sin() and fmod() loop of edfgenerator 1.10), scalar (the reference kernels),\n"
+        " exact and fast (the SIMD kernels selected for this cpu, see --precision of edfgenerator).\n"
+        "\n options:\n"
+        "\n --signals=list of the number of signals default: 1,16\n"
+        "\n --rates=list of samplerates in Hertz default: 500,8000\n"
+        "\n --durations=list of datarecord durations in seconds default: 0.25,1\n"
+        "\n --samples=number of samples generated and written per case default: 4000000\n"
+        "\n --repeat=number of runs per case, the fastest run is reported default: 3\n"
+        "\n --dir=directory of the temporary file of the write stage default: . (/dev/shm with --api)\n"
+        "\n --json=path of the JSON output default: - (stdout)\n"
+        "\n --api  measure the sample writing functions of edflib instead of the generator,\n"
+        "        every function writes into a file in --dir and into /dev/null\n"
+        "\n --kernels  measure the waveform kernels of sine, square, ramp and triangle only, one signal,\n"
+        "            without the conversion to digital samples and without the write stage\n"
+        "\n --help\n\n");
+      return EXIT_SUCCESS;
+    }
+  }
+
+  if(optind < argc)
+  {
+    fprintf(stderr, "unrecognized argument(s), --help for help\n");
+    return EXIT_FAILURE;
+  }
+
+  for(d=0; d<n_durations; d++)
+  {
+    if((durations[d] < 0.001) || (durations[d] > 60))
+    {
+      fprintf(stderr, "illegal value for option durations, must be in the range 0.001 to 60\n");
+      return EXIT_FAILURE;
+    }
+
+    for(r=0; r<n_rates; r++)
+    {
+      if(((int)(rates[r] * durations[d] + 0.5)) < 4)
+      {
+        fprintf(stderr, "error: samplerate %f with datarecord duration %f gives less than 4 samples per datarecord\n", rates[r], durations[d]);
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  for(c=0; c<n_signals; c++)
+  {
+    if(signals[c] > EDFLIB_MAXSIGNALS)
+    {
+      fprintf(stderr, "illegal value for option signals, must be in the range 1 to %i\n", EDFLIB_MAXSIGNALS);
+      return EXIT_FAILURE;
+    }
+  }
+
+  snprintf(path, 2048, "%s/" PROGRAM_NAME "_tmp", dir);
+
+  if(strcmp(json_path, "-"))
+  {
+    json = fopen(json_path, "wb");
+    if(json == NULL)
+    {
+      fprintf(stderr, "error: can not open file %s for writing\n", json_path);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if(api_set)
+  {
+    /* a tmpfs keeps the disk out of the measurement */
+    if(!dir_set && !access("/dev/shm", W_OK))
+    {
+      strlcpy(dir, "/dev/shm", 1024);
+    }
+
+    i = bench_api(signals, n_signals, rates, n_rates, durations, n_durations, samples, repeat, dir, json);
+
+    if(json != stdout)
+    {
+      fclose(json);
+    }
+
+    return i;
+  }
+
+  if(kernels_set)
+  {
+    i = bench_kernels(rates, n_rates, durations, n_durations, samples, repeat, json);
+
+    if(json != stdout)
+    {
+      fclose(json);
+    }
+
+    return i;
+  }
+
+  wavegen_init(WAVEGEN_PRECISION_FAST);
+
+  pinknoise_init();
+
+  fprintf(json, "{\n"
+                "  \"program\": \"" PROGRAM_NAME "\",\n"
+                "  \"version\": \"" PROGRAM_VERSION "\",\n"
+                "  \"wavegen_isa\": \"%s\",\n"
+                "  \"pinknoise_isa\": \"%s\",\n"
+                "  \"samples_per_case\": %lli,\n"
+                "  \"repeat\": %i,\n"
+                "  \"cases\": [",
+          wavegen_get_isa(), pinknoise_get_isa(), samples, repeat);
+
+  fprintf(stderr, "%-11s %-4s %7s %7s %8s %-8s %-8s %12s %10s %9s  %12s %10s %9s\n",
+          "wave", "type", "signals", "rate", "duration", "engine", "isa",
+          "gen smp/s", "gen MB/s", "ns/smp", "write smp/s", "write MB/s", "ns/smp");
+
+  for(w=0; w<BENCH_WAVES; w++)
+  {
+    for(t=0; t<2; t++)
+    {
+      for(c=0; c<n_signals; c++)
+      {
+        for(r=0; r<n_rates; r++)
+        {
+          for(d=0; d<n_durations; d++)
+          {
+            bcase.wave = w;
+            bcase.filetype = t;
+            bcase.chns = signals[c];
+            bcase.rate = rates[r];
+            bcase.duration = durations[d];
+            bcase.sf = (bcase.rate * bcase.duration) + 0.5;
+            bcase.recsize = bcase.chns * bcase.sf * ((t == FILETYPE_BDF) ? 3 : 2);
+
+            per_rec = (long long)bcase.chns * bcase.sf;
+
+            bcase.datrecs = (samples + per_rec - 1) / per_rec;
+
+            /* the write stage doesn't depend on the kernels, it's measured once per case */
+            if(bench_write(&bcase, repeat, path, &wr))
+            {
+              return EXIT_FAILURE;
+            }
+
+            fprintf(json, "%s\n    {\n"
+                          "      \"wave\": \"%s\",\n"
+                          "      \"type\": \"%s\",\n"
+                          "      \"signals\": %i,\n"
+                          "      \"rate\": %i,\n"
+                          "      \"datrec_duration\": %f,\n"
+                          "      \"datarecords\": %i,\n",
+                    first ? "" : ",", waveforms_str[w], (t == FILETYPE_BDF) ? "bdf" : "edf",
+                    bcase.chns, bcase.rate, bcase.duration, bcase.datrecs);
+
+            first = 0;
+
+            print_stage(json, "write", &wr);
+
+            fprintf(json, ",\n      \"generate\": [");
+
+            for(e=0; e<BENCH_ENGINES; e++)
+            {
+              if(bench_generate(&bcase, e, &gen))
+              {
+                return EXIT_FAILURE;
+              }
+
+              for(i=1; i<repeat; i++)
+              {
+                if(bench_generate(&bcase, e, &tmp))
+                {
+                  return EXIT_FAILURE;
+                }
+
+                if(tmp.seconds < gen.seconds)
+                {
+                  gen = tmp;
+                }
+              }
+
+              fprintf(json, "%s\n        { \"engine\": \"%s\", \"isa\": \"%s\", ",
+                      e ? "," : "", engines_str[e], engine_isa(e, w));
+
+              print_stage(json, NULL, &gen);
+
+              fprintf(json, " }");
+
+              fprintf(stderr, "%-11s %-4s %7i %7i %8.3f %-8s %-8s %12.4g %10.1f %9.2f  %12.4g %10.1f %9.2f\n",
+                      waveforms_str[w], (t == FILETYPE_BDF) ? "bdf" : "edf", bcase.chns, bcase.rate, bcase.duration,
+                      engines_str[e], engine_isa(e, w),
+                      gen.samples / gen.seconds, gen.bytes / gen.seconds / 1e6, gen.seconds * 1e9 / gen.samples,
+                      wr.samples / wr.seconds, wr.bytes / wr.seconds / 1e6, wr.seconds * 1e9 / wr.samples);
+            }
+
+            fprintf(json, "\n      ]\n    }");
+          }
+        }
+      }
+    }
+  }
+
+  fprintf(json, "\n  ]\n}\n");
+
+  if(json != stdout)
+  {
+    fclose(json);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+/* parses a comma separated list of numbers into list, returns the number of values or -1 on error */
+static int parse_list(const char *str, double *list, int integer)
+{
+  int n=0;
+
+  char *end;
+
+  while(1)
+  {
+    if(n == BENCH_MAX_SWEEP)
+    {
+      return -1;
+    }
+
+    list[n] = strtod(str, &end);
+    if((end == str) || (list[n] <= 0))
+    {
+      return -1;
+    }
+
+    if(integer && (list[n] != floor(list[n])))
+    {
+      return -1;
+    }
+
+    n++;
+
+    if(*end == 0)
+    {
+      return n;
+    }
+
+    if(*end != ',')
+    {
+      return -1;
+    }
+
+    str = end + 1;
+  }
+}
+
+
+static void select_engine(int engine)
+{
+  if(engine <= ENGINE_SCALAR)
+  {
+    wavegen_init(WAVEGEN_PRECISION_SCALAR);
+
+    pinknoise_init_scalar();
+  }
+  else if(engine == ENGINE_EXACT)
+    {
+      wavegen_init(WAVEGEN_PRECISION_EXACT);
+
+      pinknoise_init();
+    }
+    else
+    {
+      wavegen_init(WAVEGEN_PRECISION_FAST);
+
+      pinknoise_init();
+    }
+}
+
+
+/* returns the instruction set of the kernels that generate the waveform with the engine */
+static const char * engine_isa(int engine, int wave)
+{
+  if(engine == ENGINE_LEGACY)
+  {
+    return "scalar";
+  }
+
+  select_engine(engine);
+
+  if(wave == WAVE_PINK_NOISE)
+  {
+    return pinknoise_get_isa();
+  }
+
+  if(wave == WAVE_WHITE_NOISE)
+  {
+    return "scalar";
+  }
+
+  return wavegen_get_isa();
+}
+
+
+/* sets up the signals of the case the way edfgenerator does, returns 0 on success */
+static int bench_sig_alloc(struct bench_sig_struct *sig, const struct bench_case_struct *bcase)
+{
+  int i, smp_bytes;
+
+  size_t sz;
+
+  struct sig_par_struct *sp=&sig->sp;
+
+  memset(sig, 0, sizeof(struct bench_sig_struct));
+
+  smp_bytes = (bcase->filetype == FILETYPE_BDF) ? 3 : 2;
+
+  sz = sig_par_layout(sp, NULL, bcase->chns);
+
+  if(posix_memalign((void **)&sp->mem, SIG_PAR_ALIGN, sz))
+  {
+    sp->mem = NULL;
+    return -1;
+  }
+
+  memset(sp->mem, 0, sz);
+
+  sig_par_layout(sp, sp->mem, bcase->chns);
+
+  /* the noise generators need a buffer per signal, the periodic waveforms are packed in chunks */
+  if(bcase->wave >= WAVE_WHITE_NOISE)
+  {
+    sz = ((sizeof(double[bcase->sf]) + SIG_PAR_ALIGN - 1) / SIG_PAR_ALIGN) * SIG_PAR_ALIGN;
+
+    if(posix_memalign((void **)&sp->buf_mem, SIG_PAR_ALIGN, sz * bcase->chns))
+    {
+      sp->buf_mem = NULL;
+      return -1;
+    }
+
+    memset(sp->buf_mem, 0, sz * bcase->chns);
+
+    sz = 0;
+
+    for(i=0; i<bcase->chns; i++)
+    {
+      sp->buf[i] = sig_par_carve(sp->buf_mem, &sz, sizeof(double[bcase->sf]));
+    }
+  }
+
+  if(posix_memalign((void **)&sig->scratch, SIG_PAR_ALIGN, sizeof(double[bcase->sf])))
+  {
+    sig->scratch = NULL;
+    return -1;
+  }
+
+  for(i=0; i<bcase->chns; i++)
+  {
+    sp->sf[i] = bcase->sf;
+    sp->waveform[i] = bcase->wave;
+
+    /* 10 Hz and up, a different frequency for every signal, expressed in cycles per datarecord */
+    sp->signalfreq[i] = (10.0 + (i * 0.37)) * bcase->duration;
+
+    if(sp->signalfreq[i] > (bcase->sf / 4.0))
+    {
+      sp->signalfreq[i] = bcase->sf / 4.0;
+    }
+
+    sp->physmax[i] = 1200;
+    sp->physmin[i] = -1200;
+    sp->peakamp[i] = 1000;
+    sp->dutycycle[i] = 50;
+    sp->dc_offset[i] = 0;
+    sp->phase[i] = 0;
+
+    strlcpy(sp->physdim[i], "uV", 32);
+
+    if(bcase->filetype == FILETYPE_BDF)
+    {
+      sp->digmax[i] = 8388607;
+      sp->digmin[i] = -8388608;
+    }
+    else
+    {
+      sp->digmax[i] = 32767;
+      sp->digmin[i] = -32768;
+    }
+
+    wavegen_quant_init(&sp->quant[i], sp->physmax[i], sp->physmin[i], sp->digmax[i], sp->digmin[i]);
+
+    sp->datrec_offset[i] = i * bcase->sf * smp_bytes;
+  }
+
+  sig->job.chns = bcase->chns;
+  sig->job.filetype = bcase->filetype;
+  sig->job.merge_set = 0;
+  sig->job.sp = sp;
+  sig->job.pool = NULL;
+
+  return 0;
+}
+
+
+static void bench_sig_free(struct bench_sig_struct *sig, const struct bench_case_struct *bcase)
+{
+  (void)bcase;
+
+  free(sig->sp.mem);
+  free(sig->sp.buf_mem);
+  free(sig->scratch);
+}
+
+
+/* every run starts with the same noise and an empty pink noise filter */
+static void bench_sig_reset(struct bench_sig_struct *sig, const struct bench_case_struct *bcase)
+{
+  int i;
+
+  for(i=0; i<bcase->chns; i++)
+  {
+    prng_init(&sig->sp.prng[i], 1, i);
+  }
+
+  sig_par_pink_setup(&sig->sp, bcase->chns);
+}
+
+
+/* times the generation of all datarecords of the case into the datarecord buffer */
+static int bench_generate(const struct bench_case_struct *bcase, int engine, struct bench_stage_struct *stage)
+{
+  int j;
+
+  long long t0;
+
+  unsigned char *buf;
+
+  struct bench_sig_struct sig;
+
+  if(engine == ENGINE_LEGACY)
+  {
+    return bench_generate_legacy(bcase, 1, stage);
+  }
+
+  if(bench_sig_alloc(&sig, bcase) || posix_memalign((void **)&buf, BENCH_ALIGN, bcase->recsize))
+  {
+    fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
+    bench_sig_free(&sig, bcase);
+    return -1;
+  }
+
+  select_engine(engine);
+
+  bench_sig_reset(&sig, bcase);
+
+  t0 = bench_time_ns();
+
+  /* the single thread path of edfgenerator, the same calls as in parallel write mode */
+  for(j=0; j<bcase->datrecs; j++)
+  {
+    if(generate_datarecord_local(&sig.job, j, buf, sig.scratch, NULL))
+    {
+      fprintf(stderr, "error: generate_datarecord_local() line %i file %s\n", __LINE__, __FILE__);
+      bench_sig_free(&sig, bcase);
+      free(buf);
+      return -1;
+    }
+  }
+
+  stage->seconds = (bench_time_ns() - t0) / 1e9;
+  stage->samples = (long long)bcase->datrecs * bcase->chns * bcase->sf;
+  stage->bytes = (long long)bcase->datrecs * bcase->recsize;
+  stage->calls = 0;
+
+  bench_sig_free(&sig, bcase);
+
+  free(buf);
+
+  return 0;
+}
+
+
+/* times the generation of all datarecords of the case with the generation loop of edfgenerator 1.10 */
+/* and, if convert is set, the conversion of edfwrite_physical_samples() of that version, this is the baseline of the other engines */
+static int bench_generate_legacy(const struct bench_case_struct *bcase, int convert, struct bench_stage_struct *stage)
+{
+  int i, j, k, chan, err,
+      fd=-1,
+      smp_bytes,
+      value;
+
+  long long t0;
+
+  double ftmp,
+         white_noise,
+         bitvalue,
+         phys_offset;
+
+  unsigned char *datrec_buf,
+                *dest;
+
+  struct legacy_par_struct sig_par;
+
+  if(legacy_par_alloc(&sig_par, bcase))
+  {
+    fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
+    legacy_par_free(&sig_par, bcase);
+    return -1;
+  }
+
+  datrec_buf = (unsigned char *)malloc(bcase->recsize);
+  if(datrec_buf == NULL)
+  {
+    fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
+    legacy_par_free(&sig_par, bcase);
+    return -1;
+  }
+
+  if(bcase->wave >= WAVE_WHITE_NOISE)
+  {
+    fd = open("/dev/urandom", O_RDONLY | O_NONBLOCK);
+    if(fd < 0)
+    {
+      fprintf(stderr, "error: cannot open /dev/urandom    line %i file %s\n", __LINE__, __FILE__);
+      legacy_par_free(&sig_par, bcase);
+      free(datrec_buf);
+      return -1;
+    }
+  }
+
+  smp_bytes = (bcase->filetype == FILETYPE_BDF) ? 3 : 2;
+
+  bitvalue = (sig_par.physmax[0] - sig_par.physmin[0]) / (sig_par.digmax[0] - sig_par.digmin[0]);
+
+  phys_offset = (sig_par.physmax[0] / bitvalue) - sig_par.digmax[0];
+
+  t0 = bench_time_ns();
+
+  for(j=0; j<bcase->datrecs; j++)
+  {
+    for(chan=0; chan<bcase->chns; chan++)
+    {
+      /* the loop of edfgenerator 1.10 */
+      if(sig_par.waveform[chan] == WAVE_SINE)
+      {
+        for(i=0; i<sig_par.sf[chan]; i++)
+        {
+          sig_par.buf[chan][i] = (sin(sig_par.sine_1[chan]) * sig_par.peakamp[chan]) + sig_par.dc_offset[chan];
+
+          sig_par.sine_1[chan] += sig_par.w[chan];
+        }
+      }
+      else if(sig_par.waveform[chan] == WAVE_SQUARE)
+        {
+          for(i=0; i<sig_par.sf[chan]; i++)
+          {
+            ftmp = fmod(sig_par.square_1[chan], 1.0 / sig_par.signalfreq[chan]);
+
+            if((ftmp * sig_par.signalfreq[chan]) < (sig_par.dutycycle[chan] / 100.0))
+            {
+              sig_par.buf[chan][i] = sig_par.peakamp[chan];
+            }
+            else
+            {
+              sig_par.buf[chan][i] = -sig_par.peakamp[chan];
+            }
+            sig_par.buf[chan][i] += sig_par.dc_offset[chan];
+
+            sig_par.square_1[chan] += sig_par.q[chan];
+          }
+        }
+        else if(sig_par.waveform[chan] == WAVE_RAMP)
+          {
+            for(i=0; i<sig_par.sf[chan]; i++)
+            {
+              ftmp = fmod(sig_par.triangle_1[chan], 1.0 / sig_par.signalfreq[chan]);
+
+              if((ftmp * sig_par.signalfreq[chan]) < (sig_par.dutycycle[chan] / 100.0))
+              {
+                sig_par.buf[chan][i] = sig_par.peakamp[chan] * (200.0 / sig_par.dutycycle[chan]) * ftmp * sig_par.signalfreq[chan] - sig_par.peakamp[chan];
+              }
+              else
+              {
+                sig_par.buf[chan][i] = -sig_par.peakamp[chan];
+              }
+              sig_par.buf[chan][i] += sig_par.dc_offset[chan];
+
+              sig_par.triangle_1[chan] += sig_par.q[chan];
+            }
+          }
+          else if(sig_par.waveform[chan] == WAVE_TRIANGLE)
+            {
+              for(i=0; i<sig_par.sf[chan]; i++)
+              {
+                ftmp = fmod(sig_par.triangle_1[chan], 1.0 / sig_par.signalfreq[chan]);
+
+                if((ftmp * sig_par.signalfreq[chan]) < (sig_par.dutycycle[chan] / 200.0))
+                {
+                  sig_par.buf[chan][i] = sig_par.peakamp[chan] * (400.0 / sig_par.dutycycle[chan]) * ftmp * sig_par.signalfreq[chan] - sig_par.peakamp[chan];
+                  sig_par.buf[chan][i] += sig_par.dc_offset[chan];
+                }
+                else if((ftmp * sig_par.signalfreq[chan]) < (sig_par.dutycycle[chan] / 100.0))
+                  {
+                    sig_par.buf[chan][i] = sig_par.peakamp[chan] * (400.0 / sig_par.dutycycle[chan]) * ((sig_par.dutycycle[chan] / 100.0) - (ftmp * sig_par.signalfreq[chan])) - sig_par.peakamp[chan];
+                  }
+                  else
+                  {
+                    sig_par.buf[chan][i] = -sig_par.peakamp[chan];
+                  }
+                  sig_par.buf[chan][i] += sig_par.dc_offset[chan];
+
+                  sig_par.triangle_1[chan] += sig_par.q[chan];
+              }
+            }
+            else if((sig_par.waveform[chan] == WAVE_WHITE_NOISE) || (sig_par.waveform[chan] == WAVE_PINK_NOISE))
+              {
+                err = read(fd, sig_par.randbuf[chan], sizeof(int[sig_par.sf[chan]]));
+                if(err != (sig_par.sf[chan] * 4))
+                {
+                  perror(NULL);
+                  fprintf(stderr, "error: read() returned %i   line %i\n", err, __LINE__);
+
+                  close(fd);
+                  legacy_par_free(&sig_par, bcase);
+                  free(datrec_buf);
+                  return -1;
+                }
+
+                if(sig_par.waveform[chan] == WAVE_WHITE_NOISE)
+                {
+                  for(i=0; i<sig_par.sf[chan]; i++)
+                  {
+                    sig_par.buf[chan][i] = (sig_par.randbuf[chan][i] % ((int)(sig_par.peakamp[chan] * 100.0))) / 100.0;
+                    sig_par.buf[chan][i] += sig_par.dc_offset[chan];
+                  }
+                }
+                else if(sig_par.waveform[chan] == WAVE_PINK_NOISE)
+                  {
+                    for(i=0; i<sig_par.sf[chan]; i++)
+                    {
+                      white_noise = (sig_par.randbuf[chan][i] % ((int)(sig_par.peakamp[chan] * 100.0))) / 600.0;
+                      sig_par.b0[chan] = 0.99886 * sig_par.b0[chan] + white_noise * 0.0555179;
+                      sig_par.b1[chan] = 0.99332 * sig_par.b1[chan] + white_noise * 0.0750759;
+                      sig_par.b2[chan] = 0.96900 * sig_par.b2[chan] + white_noise * 0.1538520;
+                      sig_par.b3[chan] = 0.86650 * sig_par.b3[chan] + white_noise * 0.3104856;
+                      sig_par.b4[chan] = 0.55000 * sig_par.b4[chan] + white_noise * 0.5329522;
+                      sig_par.b5[chan] = -0.7616 * sig_par.b5[chan] - white_noise * 0.0168980;
+                      sig_par.buf[chan][i] = sig_par.b0[chan] + sig_par.b1[chan] + sig_par.b2[chan] + sig_par.b3[chan] + sig_par.b4[chan] + sig_par.b5[chan] + sig_par.b6[chan] + white_noise * 0.5362;
+                      sig_par.buf[chan][i] += sig_par.dc_offset[chan];
+                      sig_par.b6[chan] = white_noise * 0.115926;
+                    }
+                  }
+              }
+
+      if(!convert)
+      {
+        continue;
+      }
+
+      /* the conversion of edfwrite_physical_samples() of edflib 1.10 */
+      dest = datrec_buf + ((size_t)chan * bcase->sf * smp_bytes);
+
+      for(i=0; i<sig_par.sf[chan]; i++)
+      {
+        value = (sig_par.buf[chan][i] / bitvalue) - phys_offset;
+
+        if(value>sig_par.digmax[chan])
+        {
+          value = sig_par.digmax[chan];
+        }
+
+        if(value<sig_par.digmin[chan])
+        {
+          value = sig_par.digmin[chan];
+        }
+
+        for(k=0; k<smp_bytes; k++)
+        {
+          dest[(i * smp_bytes) + k] = (value >> (k * 8)) & 0xff;
+        }
+      }
+    }
+  }
+
+  stage->seconds = (bench_time_ns() - t0) / 1e9;
+  stage->samples = (long long)bcase->datrecs * bcase->chns * bcase->sf;
+  stage->bytes = (long long)bcase->datrecs * bcase->recsize;
+  stage->calls = 0;
+
+  if(fd >= 0)
+  {
+    close(fd);
+  }
+
+  legacy_par_free(&sig_par, bcase);
+
+  free(datrec_buf);
+
+  return 0;
+}
+
+
+/* allocates the arrays of the 1.10 signal parameters and sets them up like bench_sig_alloc() does */
+static int legacy_par_alloc(struct legacy_par_struct *sig_par, const struct bench_case_struct *bcase)
+{
+  int i;
+
+  memset(sig_par, 0, sizeof(struct legacy_par_struct));
+
+  sig_par->mem = (double *)calloc((size_t)bcase->chns * LEGACY_PAR_ARRAYS, sizeof(double));
+  sig_par->buf = (double **)calloc(bcase->chns, sizeof(double *));
+  sig_par->randbuf = (int **)calloc(bcase->chns, sizeof(int *));
+  sig_par->sf = (int *)calloc(bcase->chns, sizeof(int));
+  sig_par->digmax = (int *)calloc(bcase->chns, sizeof(int));
+  sig_par->digmin = (int *)calloc(bcase->chns, sizeof(int));
+  sig_par->waveform = (int *)calloc(bcase->chns, sizeof(int));
+  if((sig_par->mem == NULL) || (sig_par->buf == NULL) || (sig_par->randbuf == NULL) || (sig_par->sf == NULL) ||
+     (sig_par->digmax == NULL) || (sig_par->digmin == NULL) || (sig_par->waveform == NULL))
+  {
+    return -1;
+  }
+
+  sig_par->w = sig_par->mem;
+  sig_par->q = sig_par->w + bcase->chns;
+  sig_par->sine_1 = sig_par->q + bcase->chns;
+  sig_par->square_1 = sig_par->sine_1 + bcase->chns;
+  sig_par->triangle_1 = sig_par->square_1 + bcase->chns;
+  sig_par->signalfreq = sig_par->triangle_1 + bcase->chns;
+  sig_par->physmax = sig_par->signalfreq + bcase->chns;
+  sig_par->physmin = sig_par->physmax + bcase->chns;
+  sig_par->peakamp = sig_par->physmin + bcase->chns;
+  sig_par->dutycycle = sig_par->peakamp + bcase->chns;
+  sig_par->dc_offset = sig_par->dutycycle + bcase->chns;
+  sig_par->b0 = sig_par->dc_offset + bcase->chns;
+  sig_par->b1 = sig_par->b0 + bcase->chns;
+  sig_par->b2 = sig_par->b1 + bcase->chns;
+  sig_par->b3 = sig_par->b2 + bcase->chns;
+  sig_par->b4 = sig_par->b3 + bcase->chns;
+  sig_par->b5 = sig_par->b4 + bcase->chns;
+  sig_par->b6 = sig_par->b5 + bcase->chns;
+
+  for(i=0; i<bcase->chns; i++)
+  {
+    sig_par->buf[i] = (double *)malloc(sizeof(double[bcase->sf]));
+    sig_par->randbuf[i] = (int *)malloc(sizeof(int[bcase->sf]));
+    if((sig_par->buf[i] == NULL) || (sig_par->randbuf[i] == NULL))
+    {
+      return -1;
+    }
+
+    sig_par->sf[i] = bcase->sf;
+    sig_par->waveform[i] = bcase->wave;
+
+    /* the same frequencies as bench_sig_alloc(), 1.10 stores them in cycles per datarecord as well */
+    sig_par->signalfreq[i] = (10.0 + (i * 0.37)) * bcase->duration;
+
+    if(sig_par->signalfreq[i] > (bcase->sf / 4.0))
+    {
+      sig_par->signalfreq[i] = bcase->sf / 4.0;
+    }
+
+    sig_par->physmax[i] = 1200;
+    sig_par->physmin[i] = -1200;
+    sig_par->peakamp[i] = 1000;
+    sig_par->dutycycle[i] = 50;
+    sig_par->dc_offset[i] = 0;
+
+    if(bcase->filetype == FILETYPE_BDF)
+    {
+      sig_par->digmax[i] = 8388607;
+      sig_par->digmin[i] = -8388608;
+    }
+    else
+    {
+      sig_par->digmax[i] = 32767;
+      sig_par->digmin[i] = -32768;
+    }
+
+    /* the initialization of 1.10 with a phase of 0 degrees */
+    sig_par->w[i] = M_PI * 2.0;
+
+    sig_par->q[i] = 1.0 / sig_par->sf[i];
+
+    sig_par->w[i] /= (sig_par->sf[i] / sig_par->signalfreq[i]);
+  }
+
+  return 0;
+}
+
+
+static void legacy_par_free(struct legacy_par_struct *sig_par, const struct bench_case_struct *bcase)
+{
+  int i;
+
+  for(i=0; i<bcase->chns; i++)
+  {
+    if(sig_par->buf != NULL)
+    {
+      free(sig_par->buf[i]);
+    }
+
+    if(sig_par->randbuf != NULL)
+    {
+      free(sig_par->randbuf[i]);
+    }
+  }
+
+  free(sig_par->mem);
+  free(sig_par->buf);
+  free(sig_par->randbuf);
+  free(sig_par->sf);
+  free(sig_par->digmax);
+  free(sig_par->digmin);
+  free(sig_par->waveform);
+}
+
+
+/* Measures the waveform kernels only, one signal per case, the samples are generated in pieces of WAVEGEN_CHUNK
+ * into a buffer of doubles the way edfgenerator does before it converts them to digital samples.
+ * The legacy engine runs the waveform part of the generation loop of edfgenerator 1.10.
+ */
+static int bench_kernels(const double *rates, int n_rates, const double *durations, int n_durations,
+                         long long samples, int repeat, FILE *json)
+{
+  int i, w, r, d, e,
+      first=1;
+
+  double ns[BENCH_ENGINES];
+
+  struct bench_case_struct bcase;
+
+  struct bench_stage_struct stage,
+                            tmp;
+
+  memset(&bcase, 0, sizeof(struct bench_case_struct));
+
+  fprintf(json, "{\n"
+                "  \"program\": \"" PROGRAM_NAME "\",\n"
+                "  \"version\": \"" PROGRAM_VERSION "\",\n"
+                "  \"mode\": \"kernels\",\n"
+                "  \"samples_per_case\": %lli,\n"
+                "  \"repeat\": %i,\n"
+                "  \"cases\": [",
+          samples, repeat);
+
+  fprintf(stderr, "%-11s %7s %8s %-8s %-8s %12s %9s %9s %9s\n",
+          "wave", "rate", "duration", "engine", "isa", "smp/s", "ns/smp", "x legacy", "x scalar");
+
+  for(w=WAVE_SINE; w<=WAVE_TRIANGLE; w++)
+  {
+    for(r=0; r<n_rates; r++)
+    {
+      for(d=0; d<n_durations; d++)
+      {
+        bcase.wave = w;
+        bcase.filetype = FILETYPE_EDF;
+        bcase.chns = 1;
+        bcase.rate = rates[r];
+        bcase.duration = durations[d];
+        bcase.sf = (bcase.rate * bcase.duration) + 0.5;
+        bcase.recsize = bcase.sf * 2;
+        bcase.datrecs = (samples + bcase.sf - 1) / bcase.sf;
+
+        fprintf(json, "%s\n    {\n"
+                      "      \"wave\": \"%s\",\n"
+                      "      \"rate\": %i,\n"
+                      "      \"datrec_duration\": %f,\n"
+                      "      \"datarecords\": %i,\n"
+                      "      \"kernels\": [",
+                first ? "" : ",", waveforms_str[w], bcase.rate, bcase.duration, bcase.datrecs);
+
+        first = 0;
+
+        for(e=0; e<BENCH_ENGINES; e++)
+        {
+          for(i=0; i<repeat; i++)
+          {
+            if(e == ENGINE_LEGACY)
+            {
+              if(bench_generate_legacy(&bcase, 0, &tmp))
+              {
+                return EXIT_FAILURE;
+              }
+            }
+            else if(bench_kernel(&bcase, e, &tmp))
+              {
+                return EXIT_FAILURE;
+              }
+
+            if((!i) || (tmp.seconds < stage.seconds))
+            {
+              stage = tmp;
+            }
+          }
+
+          /* the kernels produce doubles, there is no datarecord */
+          stage.bytes = stage.samples * (long long)sizeof(double);
+
+          ns[e] = stage.seconds * 1e9 / stage.samples;
+
+          fprintf(json, "%s\n        { \"engine\": \"%s\", \"isa\": \"%s\", ",
+                  e ? "," : "", engines_str[e], engine_isa(e, w));
+
+          print_stage(json, NULL, &stage);
+
+          fprintf(json, ", \"speedup_legacy\": %.3f, \"speedup_scalar\": %.3f }",
+                  ns[ENGINE_LEGACY] / ns[e], (e >= ENGINE_SCALAR) ? (ns[ENGINE_SCALAR] / ns[e]) : 0.0);
+
+          fprintf(stderr, "%-11s %7i %8.3f %-8s %-8s %12.4g %9.3f %9.2f",
+                  waveforms_str[w], bcase.rate, bcase.duration, engines_str[e], engine_isa(e, w),
+                  stage.samples / stage.seconds, ns[e], ns[ENGINE_LEGACY] / ns[e]);
+
+          if(e >= ENGINE_SCALAR)
+          {
+            fprintf(stderr, " %9.2f\n", ns[ENGINE_SCALAR] / ns[e]);
+          }
+          else
+          {
+            fprintf(stderr, " %9s\n", "-");
+          }
+        }
+
+        fprintf(json, "\n      ]\n    }");
+      }
+    }
+  }
+
+  fprintf(json, "\n  ]\n}\n");
+
+  return EXIT_SUCCESS;
+}
+
+
+/* times the waveform kernels of the engine for all datarecords of the case, without the conversion to digital samples */
+static int bench_kernel(const struct bench_case_struct *bcase, int engine, struct bench_stage_struct *stage)
+{
+  int i, j, n;
+
+  long long t0;
+
+  double *buf,
+         signalfreq;
+
+  struct wavegen_par_struct wave_par;
+
+  if(posix_memalign((void **)&buf, BENCH_ALIGN, sizeof(double[WAVEGEN_CHUNK])))
+  {
+    fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
+    return -1;
+  }
+
+  select_engine(engine);
+
+  /* the frequency of the first signal of bench_sig_alloc() */
+  signalfreq = 10.0 * bcase->duration;
+
+  if(signalfreq > (bcase->sf / 4.0))
+  {
+    signalfreq = bcase->sf / 4.0;
+  }
+
+  wave_par.step = signalfreq / bcase->sf;
+  wave_par.amp = 1000;
+  wave_par.dutycycle = 0.5;
+  wave_par.dc_offset = 0;
+
+  t0 = bench_time_ns();
+
+  for(j=0; j<bcase->datrecs; j++)
+  {
+    /* the phase at the start of the datarecord, like generate_channel() */
+    wave_par.phase = fmod(signalfreq * j, 1.0);
+
+    for(i=0; i<bcase->sf; i+=WAVEGEN_CHUNK)
+    {
+      n = bcase->sf - i;
+
+      if(n > WAVEGEN_CHUNK)
+      {
+        n = WAVEGEN_CHUNK;
+      }
+
+      if(bcase->wave == WAVE_SINE)
+      {
+        wavegen_sine(buf, i, n, &wave_par);
+      }
+      else if(bcase->wave == WAVE_SQUARE)
+        {
+          wavegen_square(buf, i, n, &wave_par);
+        }
+        else if(bcase->wave == WAVE_RAMP)
+          {
+            wavegen_ramp(buf, i, n, &wave_par);
+          }
+          else
+          {
+            wavegen_triangle(buf, i, n, &wave_par);
+          }
+    }
+  }
+
+  stage->seconds = (bench_time_ns() - t0) / 1e9;
+  stage->samples = (long long)bcase->datrecs * bcase->sf;
+  stage->bytes = stage->samples * (long long)sizeof(double);
+  stage->calls = 0;
+
+  free(buf);
+
+  return 0;
+}
+
+
+/* creates the file of the case and sets the signal parameters, returns the handle or -1 on error */
+static int bench_open(const struct bench_case_struct *bcase, const char *path)
+{
+  int i, hdl, err;
+
+  if(bcase->filetype == FILETYPE_BDF)
+  {
+    hdl = edfopen_file_writeonly(path, EDFLIB_FILETYPE_BDFPLUS, bcase->chns);
+  }
+  else
+  {
+    hdl = edfopen_file_writeonly(path, EDFLIB_FILETYPE_EDFPLUS, bcase->chns);
+  }
+
+  if(hdl < 0)
+  {
+    fprintf(stderr, "error: edfopen_file_writeonly() can not create file %s line %i file %s\n", path, __LINE__, __FILE__);
+    return -1;
+  }
+
+  err = edf_set_datarecord_duration(hdl, (int)((bcase->duration * 100000) + 0.5));
+
+  for(i=0; i<bcase->chns; i++)
+  {
+    err |= edf_set_samplefrequency(hdl, i, bcase->sf);
+
+    if(bcase->filetype == FILETYPE_BDF)
+    {
+      err |= edf_set_digital_maximum(hdl, i, 8388607);
+      err |= edf_set_digital_minimum(hdl, i, -8388608);
+    }
+    else
+    {
+      err |= edf_set_digital_maximum(hdl, i, 32767);
+      err |= edf_set_digital_minimum(hdl, i, -32768);
+    }
+
+    err |= edf_set_physical_maximum(hdl, i, 1200);
+    err |= edf_set_physical_minimum(hdl, i, -1200);
+    err |= edf_set_physical_dimension(hdl, i, "uV");
+  }
+
+  if(err)
+  {
+    fprintf(stderr, "error: can not set the signal parameters of file %s line %i file %s\n", path, __LINE__, __FILE__);
+    edfclose_file(hdl);
+    return -1;
+  }
+
+  return hdl;
+}
+
+
+/* Times writing the datarecords of the case with edflib, including closing the file.
+ * The datarecords are generated beforehand and written with the same calls as edfgenerator uses,
+ * when they don't fit in BENCH_WRITE_BYTES the buffer is written again and again.
+ */
+static int bench_write(const struct bench_case_struct *bcase, int repeat, const char *path, struct bench_stage_struct *stage)
+{
+  int j, r, n, hdl, err;
+
+  long long t0;
+
+  double seconds;
+
+  unsigned char *buf;
+
+  struct bench_sig_struct sig;
+
+  n = BENCH_WRITE_BYTES / bcase->recsize;
+
+  if(n > bcase->datrecs)
+  {
+    n = bcase->datrecs;
+  }
+
+  if(n < 1)
+  {
+    n = 1;
+  }
+
+  if(bench_sig_alloc(&sig, bcase) || posix_memalign((void **)&buf, BENCH_ALIGN, (size_t)bcase->recsize * n))
+  {
+    fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
+    bench_sig_free(&sig, bcase);
+    return -1;
+  }
+
+  select_engine(ENGINE_FAST);
+
+  bench_sig_reset(&sig, bcase);
+
+  for(j=0; j<n; j++)
+  {
+    if(generate_datarecord_local(&sig.job, j, buf + ((size_t)bcase->recsize * j), sig.scratch, NULL))
+    {
+      fprintf(stderr, "error: generate_datarecord_local() line %i file %s\n", __LINE__, __FILE__);
+      bench_sig_free(&sig, bcase);
+      free(buf);
+      return -1;
+    }
+  }
+
+  bench_sig_free(&sig, bcase);
+
+  stage->seconds = 0;
+  stage->samples = (long long)bcase->datrecs * bcase->chns * bcase->sf;
+  stage->bytes = (long long)bcase->datrecs * bcase->recsize;
+  stage->calls = 0;
+
+  for(r=0; r<repeat; r++)
+  {
+    hdl = bench_open(bcase, path);
+    if(hdl < 0)
+    {
+      unlink(path);
+      free(buf);
+      return -1;
+    }
+
+    t0 = bench_time_ns();
+
+    for(j=0; j<bcase->datrecs; j++)
+    {
+      if(write_datarecord(hdl, bcase->filetype, 0, buf + ((size_t)bcase->recsize * (j % n))))
+      {
+        edfclose_file(hdl);
+        unlink(path);
+        free(buf);
+        return -1;
+      }
+    }
+
+    err = edfclose_file(hdl);
+
+    seconds = (bench_time_ns() - t0) / 1e9;
+
+    unlink(path);
+
+    if(err)
+    {
+      fprintf(stderr, "error: edfclose_file() line %i file %s\n", __LINE__, __FILE__);
+      free(buf);
+      return -1;
+    }
+
+    if((!r) || (seconds < stage->seconds))
+    {
+      stage->seconds = seconds;
+    }
+  }
+
+  free(buf);
+
+  return 0;
+}
+
+
+/* Measures the sample writing functions of edflib, every function writes the same datarecords
+ * into a file in dir (e.g. on a tmpfs) and into /dev/null, for every filetype the function supports.
+ */
+static int bench_api(const double *signals, int n_signals, const double *rates, int n_rates,
+                     const double *durations, int n_durations, long long samples, int repeat, const char *dir, FILE *json)
+{
+  int c, r, d, t, a, tgt,
+      first=1;
+
+  long long per_rec;
+
+  char path[2048]="",
+       target_str[2][16]={"file", "null"};
+
+  struct bench_case_struct bcase;
+
+  struct bench_stage_struct stage;
+
+  snprintf(path, 2048, "%s/" PROGRAM_NAME "_tmp", dir);
+
+  memset(&bcase, 0, sizeof(struct bench_case_struct));
+
+  fprintf(json, "{\n"
+                "  \"program\": \"" PROGRAM_NAME "\",\n"
+                "  \"version\": \"" PROGRAM_VERSION "\",\n"
+                "  \"mode\": \"api\",\n"
+                "  \"dir\": \"%s\",\n"
+                "  \"samples_per_case\": %lli,\n"
+                "  \"repeat\": %i,\n"
+                "  \"cases\": [",
+          dir, samples, repeat);
+
+  fprintf(stderr, "%-6s %-4s %7s %7s %8s  %-38s %10s %10s %12s %10s\n",
+          "target", "type", "signals", "rate", "duration", "function", "calls", "ns/call", "smp/s", "MB/s");
+
+  for(tgt=0; tgt<2; tgt++)
+  {
+    for(t=0; t<2; t++)
+    {
+      for(c=0; c<n_signals; c++)
+      {
+        for(r=0; r<n_rates; r++)
+        {
+          for(d=0; d<n_durations; d++)
+          {
+            bcase.filetype = t;
+            bcase.chns = signals[c];
+            bcase.rate = rates[r];
+            bcase.duration = durations[d];
+            bcase.sf = (bcase.rate * bcase.duration) + 0.5;
+            bcase.recsize = bcase.chns * bcase.sf * ((t == FILETYPE_BDF) ? 3 : 2);
+
+            per_rec = (long long)bcase.chns * bcase.sf;
+
+            bcase.datrecs = (samples + per_rec - 1) / per_rec;
+
+            for(a=0; a<BENCH_APIS; a++)
+            {
+              if(!api_supported(a, t))
+              {
+                continue;
+              }
+
+              if(bench_api_case(&bcase, a, tgt ? "/dev/null" : path, repeat, &stage))
+              {
+                return EXIT_FAILURE;
+              }
+
+              fprintf(json, "%s\n    { \"target\": \"%s\", \"type\": \"%s\", \"signals\": %i, \"rate\": %i, \"datrec_duration\": %f, \"datarecords\": %i, \"function\": \"%s\",\n      ",
+                      first ? "" : ",", target_str[tgt], (t == FILETYPE_BDF) ? "bdf" : "edf",
+                      bcase.chns, bcase.rate, bcase.duration, bcase.datrecs, api_str[a]);
+
+              first = 0;
+
+              print_stage(json, NULL, &stage);
+
+              fprintf(json, " }");
+
+              fprintf(stderr, "%-6s %-4s %7i %7i %8.3f  %-38s %10lli %10.1f %12.4g %10.1f\n",
+                      target_str[tgt], (t == FILETYPE_BDF) ? "bdf" : "edf", bcase.chns, bcase.rate, bcase.duration, api_str[a],
+                      stage.calls, stage.seconds * 1e9 / stage.calls,
+                      stage.samples / stage.seconds, stage.bytes / stage.seconds / 1e6);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  fprintf(json, "\n  ]\n}\n");
+
+  return EXIT_SUCCESS;
+}
+
+
+/* returns 1 if the function can write files of filetype */
+static int api_supported(int api, int filetype)
+{
+  if((api == API_WRITE_DIGITAL_SHORT) || (api == API_BLOCK_DIGITAL_SHORT) || (api == API_BLOCK_DIGITAL_2BYTE))
+  {
+    return filetype == FILETYPE_EDF;
+  }
+
+  if(api == API_BLOCK_DIGITAL_3BYTE)
+  {
+    return filetype == FILETYPE_BDF;
+  }
+
+  return 1;
+}
+
+
+/* Times the calls of one write function for all datarecords of the case, the fastest of repeat runs is stored in stage.
+ * Closing the file is not included, the per signal functions are called once for every signal of a datarecord.
+ */
+static int bench_api_case(const struct bench_case_struct *bcase, int api, const char *path, int repeat, struct bench_stage_struct *stage)
+{
+  int i, j, k, r, hdl, err=0,
+      smp_bytes,
+      *ibuf=NULL;
+
+  long long t0;
+
+  double seconds,
+         *dbuf=NULL;
+
+  short *sbuf=NULL;
+
+  unsigned char *bbuf=NULL;
+
+  smp_bytes = (bcase->filetype == FILETYPE_BDF) ? 3 : 2;
+
+  /* the per signal functions use the first sf samples of the buffers */
+  dbuf = (double *)malloc(sizeof(double[bcase->chns * bcase->sf]));
+  ibuf = (int *)malloc(sizeof(int[bcase->chns * bcase->sf]));
+  sbuf = (short *)malloc(sizeof(short[bcase->chns * bcase->sf]));
+  bbuf = (unsigned char *)malloc((size_t)bcase->chns * bcase->sf * smp_bytes);
+  if((dbuf == NULL) || (ibuf == NULL) || (sbuf == NULL) || (bbuf == NULL))
+  {
+    fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
+    free(dbuf);
+    free(ibuf);
+    free(sbuf);
+    free(bbuf);
+    return -1;
+  }
+
+  for(i=0; i<(bcase->chns * bcase->sf); i++)
+  {
+    dbuf[i] = ((i % 2000) - 1000) * 0.5;
+
+    ibuf[i] = (i % 2000) - 1000;
+
+    sbuf[i] = ibuf[i];
+
+    for(k=0; k<smp_bytes; k++)
+    {
+      bbuf[(i * smp_bytes) + k] = (ibuf[i] >> (k * 8)) & 0xff;
+    }
+  }
+
+  stage->seconds = 0;
+  stage->samples = (long long)bcase->datrecs * bcase->chns * bcase->sf;
+  stage->bytes = (long long)bcase->datrecs * bcase->recsize;
+
+  if((api == API_WRITE_PHYSICAL) || (api == API_WRITE_DIGITAL_SHORT) || (api == API_WRITE_DIGITAL))
+  {
+    stage->calls = (long long)bcase->datrecs * bcase->chns;
+  }
+  else
+  {
+    stage->calls = bcase->datrecs;
+  }
+
+  for(r=0; r<repeat; r++)
+  {
+    hdl = bench_open(bcase, path);
+    if(hdl < 0)
+    {
+      err = -1;
+      break;
+    }
+
+    t0 = bench_time_ns();
+
+    for(j=0; (j<bcase->datrecs) && !err; j++)
+    {
+      if(api == API_WRITE_PHYSICAL)
+      {
+        for(k=0; (k<bcase->chns) && !err; k++)
+        {
+          err = edfwrite_physical_samples(hdl, dbuf);
+        }
+      }
+      else if(api == API_BLOCK_PHYSICAL)
+        {
+          err = edf_blockwrite_physical_samples(hdl, dbuf);
+        }
+        else if(api == API_WRITE_DIGITAL_SHORT)
+          {
+            for(k=0; (k<bcase->chns) && !err; k++)
+            {
+              err = edfwrite_digital_short_samples(hdl, sbuf);
+            }
+          }
+          else if(api == API_WRITE_DIGITAL)
+            {
+              for(k=0; (k<bcase->chns) && !err; k++)
+              {
+                err = edfwrite_digital_samples(hdl, ibuf);
+              }
+            }
+            else if(api == API_BLOCK_DIGITAL)
+              {
+                err = edf_blockwrite_digital_samples(hdl, ibuf);
+              }
+              else if(api == API_BLOCK_DIGITAL_SHORT)
+                {
+                  err = edf_blockwrite_digital_short_samples(hdl, sbuf);
+                }
+                else if(api == API_BLOCK_DIGITAL_3BYTE)
+                  {
+                    err = edf_blockwrite_digital_3byte_samples(hdl, bbuf);
+                  }
+                  else
+                  {
+                    err = edf_blockwrite_digital_2byte_samples(hdl, bbuf);
+                  }
+    }
+
+    seconds = (bench_time_ns() - t0) / 1e9;
+
+    if(err)
+    {
+      fprintf(stderr, "error: %s() returned %i line %i file %s\n", api_str[api], err, __LINE__, __FILE__);
+    }
+
+    if(edfclose_file(hdl))
+    {
+      fprintf(stderr, "error: edfclose_file() line %i file %s\n", __LINE__, __FILE__);
+      err = -1;
+    }
+
+    if(strcmp(path, "/dev/null"))
+    {
+      unlink(path);
+    }
+
+    if(err)
+    {
+      break;
+    }
+
+    if((!r) || (seconds < stage->seconds))
+    {
+      stage->seconds = seconds;
+    }
+  }
+
+  free(dbuf);
+  free(ibuf);
+  free(sbuf);
+  free(bbuf);
+
+  return err ? -1 : 0;
+}
+
+
+/* prints the results of a stage as JSON members */
+static void print_stage(FILE *f, const char *name, const struct bench_stage_struct *stage)
+{
+  if(name != NULL)
+  {
+    fprintf(f, "      \"%s\": { ", name);
+  }
+
+  fprintf(f, "\"seconds\": %.6f, \"samples\": %lli, \"bytes\": %lli, "
+             "\"samples_per_sec\": %.1f, \"mb_per_sec\": %.3f, \"ns_per_sample\": %.4f",
+          stage->seconds, stage->samples, stage->bytes,
+          stage->samples / stage->seconds, stage->bytes / stage->seconds / 1e6, stage->seconds * 1e9 / stage->samples);
+
+  if(stage->calls)
+  {
+    fprintf(f, ", \"calls\": %lli, \"ns_per_call\": %.1f", stage->calls, stage->seconds * 1e9 / stage->calls);
+  }
+
+  if(name != NULL)
+  {
+    fprintf(f, " }");
+  }
+}
+
+
+static long long bench_time_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
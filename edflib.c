@@ -35,6 +35,24 @@
 
 #include "edflib.h"
 
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <time.h>
+#endif
+
+/* The conversion of physical samples to digital samples uses AVX2 when the cpu supports it (checked at runtime).
+ * Only on x86-64, where the scalar code uses SSE2 as well, this way the output is bit-identical.
+ */
+#if defined(__x86_64__) && defined(__GNUC__)
+#define EDFLIB_X86_SIMD
+#include <immintrin.h>
+#endif
+
 #define EDFLIB_VERSION  (121)
 #define EDFLIB_MAXFILES  (64)
 
@@ -78,6 +96,23 @@
 
 #define EDFLIB_ANNOT_MEMBLOCKSZ  (1000)
 
+/* sample formats of edflib_blockwrite_records() */
+#define EDFLIB_RECORDS_PHYSICAL  (0)
+#define EDFLIB_RECORDS_INT       (1)
+#define EDFLIB_RECORDS_SHORT     (2)
+#define EDFLIB_RECORDS_2BYTE     (3)
+#define EDFLIB_RECORDS_3BYTE     (4)
+
+/* number of buffers per writev() call of edf_writev_records() */
+#if defined(IOV_MAX) && (IOV_MAX < 1024)
+#define EDFLIB_IOV_MAX  (IOV_MAX)
+#else
+#define EDFLIB_IOV_MAX  (1024)
+#endif
+
+/* edf_writev_records() copies less than this number of bytes to the buffer of the file instead of calling writev() */
+#define EDFLIB_WRITEV_MIN_BYTES  (65536)
+
 struct edfparamblock{
         char   label[17];
         char   transducer[81];
@@ -141,6 +176,24 @@ struct edfhdrblock{
         int       annotlist_sz;
         int       total_annot_bytes;
         int       eq_sf;
+        int       header_only;
+        char      *map;
+        long long map_sz;
+        int       handle;
+        int       stream;
+        long long stream_datarecords;
+        int       annots_streamed;
+        struct edf_write_stats_struct *stats;
+        char      *iobuf;
+        int       flush_datarecords;
+        int       flush_ms;
+        long long flushed_datarecords;
+        long long flush_ns;
+        int       tal_len;
+        long long tal_datarecord;
+        int       tal_step_len;
+        char      tal_step[48];
+        char      tal[EDFLIB_ANNOTATION_BYTES * (EDFLIB_MAX_ANNOTATION_CHANNELS + 1)];
         char      *wrbuf;
         int       wrbufsize;
         struct edfparamblock *edfparam;
@@ -184,6 +237,26 @@ static int edflib_snprint_ll_number_nonlocalized(char *, long long, int, int, in
 static int edflib_fprint_int_number_nonlocalized(FILE *, int, int, int);
 static int edflib_fprint_ll_number_nonlocalized(FILE *, long long, int, int);
 static int edflib_write_tal(struct edfhdrblock *, FILE *);
+static int edflib_write_edf_header_fields(struct edfhdrblock *);
+static void edflib_stats_start(struct edfhdrblock *, long long *);
+static void edflib_stats_stop(struct edfhdrblock *, long long *, int, long long);
+static size_t edflib_fwrite(struct edfhdrblock *, const void *, size_t, FILE *);
+static int edflib_blockwrite_records(int, const void *, int, int);
+#ifndef _WIN32
+static int edflib_writev(struct edfhdrblock *, struct iovec *, int);
+#endif
+static void edflib_quantize_2byte(const double *, int, const struct edfparamblock *, char *);
+static void edflib_quantize_3byte(const double *, int, const struct edfparamblock *, char *);
+#ifdef EDFLIB_X86_SIMD
+static int edflib_quantize_2byte_avx2(const double *, int, const struct edfparamblock *, char *);
+static int edflib_quantize_3byte_avx2(const double *, int, const struct edfparamblock *, char *);
+#endif
+static void edflib_fflush(struct edfhdrblock *, FILE *);
+static int edflib_render_tal(struct edfhdrblock *, long long, char *);
+static int edflib_format_tal(struct edfhdrblock *, long long, char *);
+static const char * edflib_next_tal(struct edfhdrblock *, long long);
+static int edflib_snprint_annotation(struct edfhdrblock *, struct edf_write_annotationblock *, char *, int);
+static void edflib_stream_annotations(struct edfhdrblock *, char *);
 static int edflib_strlcpy(char *, const char *, int);
 static int edflib_strlcat(char *, const char *, int);
 
@@ -451,7 +524,7 @@ int edfclose_file(int handle)
 {
   struct edf_write_annotationblock *annot2;
 
-  int i, j, k, n, p, err,
+  int i, j, k, n, p, err=0,
       datrecsize,
       nmemb;
 
@@ -480,6 +553,15 @@ int edfclose_file(int handle)
 
   hdr = hdrlist[handle];
 
+#ifndef _WIN32
+  if(hdr->map != NULL)
+  {
+    munmap(hdr->map, hdr->map_sz);
+
+    hdr->map = NULL;
+  }
+#endif
+
   if(hdr->writemode)
   {
     if(hdr->datarecords == 0LL)
@@ -487,7 +569,12 @@ int edfclose_file(int handle)
       err = edflib_write_edf_header(hdr);
       if(err)
       {
-        fclose(hdr->file_hdl);
+        if(hdr->file_hdl != stdout)
+        {
+          fclose(hdr->file_hdl);
+        }
+
+        free(hdr->iobuf);
 
         free(hdr->edfparam);
 
@@ -530,7 +617,7 @@ int edfclose_file(int handle)
       }
     }
 
-    if(hdr->datarecords<100000000LL)
+    if((hdr->datarecords<100000000LL) && (!hdr->stream))
     {
       fseeko(hdr->file_hdl, 236LL, SEEK_SET);
       p = edflib_fprint_int_number_nonlocalized(hdr->file_hdl, (int)(hdr->datarecords), 0, 0);
@@ -564,12 +651,12 @@ int edfclose_file(int handle)
 
     j = 0;
 
-    for(k=0; k<hdr->annots_in_file; k++)
+    /* in header only mode the datarecords are stored elsewhere, there's no place for the annotations */
+    /* in stream mode the annotations have been written with the datarecords */
+    for(k=0; (k<hdr->annots_in_file) && (!hdr->header_only) && (!hdr->stream); k++)
     {
       annot2 = write_annotationslist[handle] + k;
 
-      annot2->onset += hdr->starttime_offset / 1000LL;
-
       p = 0;
 
       if(j==0)  // first annotation signal
@@ -592,37 +679,7 @@ int edfclose_file(int handle)
         str[p++] =  0;
       }
 
-      n = edflib_snprint_ll_number_nonlocalized(str + p, annot2->onset / 10000LL, 0, 1, (EDFLIB_ANNOTATION_BYTES * 2) - p);
-      p += n;
-      if(annot2->onset % 10000LL)
-      {
-        str[p++] = '.';
-        n = edflib_snprint_ll_number_nonlocalized(str + p, annot2->onset % 10000LL, 4, 0, (EDFLIB_ANNOTATION_BYTES * 2) - p);
-        p += n;
-      }
-      if(annot2->duration>=0LL)
-      {
-        str[p++] = 21;
-        n = edflib_snprint_ll_number_nonlocalized(str + p, annot2->duration / 10000LL, 0, 0, (EDFLIB_ANNOTATION_BYTES * 2) - p);
-        p += n;
-        if(annot2->duration % 10000LL)
-        {
-          str[p++] = '.';
-          n = edflib_snprint_ll_number_nonlocalized(str + p, annot2->duration % 10000LL, 4, 0, (EDFLIB_ANNOTATION_BYTES * 2) - p);
-          p += n;
-        }
-      }
-      str[p++] = 20;
-      for(i=0; i<EDFLIB_WRITE_MAX_ANNOTATION_LEN; i++)
-      {
-        if(annot2->annotation[i]==0)
-        {
-          break;
-        }
-
-        str[p++] = annot2->annotation[i];
-      }
-      str[p++] = 20;
+      p += edflib_snprint_annotation(hdr, annot2, str + p, (EDFLIB_ANNOTATION_BYTES * 2) - p);
 
       for(; p<EDFLIB_ANNOTATION_BYTES; p++)
       {
@@ -654,13 +711,35 @@ int edfclose_file(int handle)
     }
 
     free(write_annotationslist[handle]);
+
+    /* the header of a stream contains the number of datarecords that was announced */
+    if(hdr->stream && ((hdr->datarecords != hdr->stream_datarecords) || (hdr->annots_streamed < hdr->annots_in_file)))
+    {
+      err = -1;
+    }
   }
   else
   {
     free(annotationslist[handle]);
   }
 
-  fclose(hdr->file_hdl);
+  /* the datarecords can be buffered, a failing write shows up here */
+  if(hdr->file_hdl == stdout)
+  {
+    if(fflush(stdout) && hdr->writemode)
+    {
+      err = -1;
+    }
+  }
+  else
+  {
+    if(fclose(hdr->file_hdl) && hdr->writemode)
+    {
+      err = -1;
+    }
+  }
+
+  free(hdr->iobuf);
 
   free(hdr->edfparam);
 
@@ -672,7 +751,7 @@ int edfclose_file(int handle)
 
   edf_files_open--;
 
-  return 0;
+  return err;
 }
 
 
@@ -3643,7 +3722,15 @@ int edfopen_file_writeonly(const char *path, int filetype, int number_of_signals
 
   hdr->annots_in_file = 0;
 
-  file = fopeno(path, "wb");
+  if(!strcmp(path, "-"))
+  {
+    file = stdout;
+  }
+  else
+  {
+    /* read access is needed for a shared mapping of the file, see edf_map_datarecords() */
+    file = fopeno(path, "w+b");
+  }
   if(file==NULL)
   {
     free(hdr->edfparam);
@@ -3657,6 +3744,8 @@ int edfopen_file_writeonly(const char *path, int filetype, int number_of_signals
 
   hdr->file_hdl = file;
 
+  hdr->handle = handle;
+
   edflib_strlcpy(hdr->path, path, 1024);
 
   edf_files_open++;
@@ -3988,7 +4077,7 @@ int edfwrite_digital_short_samples(int handle, short *buf)
       }
     }
 
-    if(fwrite(buf, sf * 2, 1, file) != 1)
+    if(edflib_fwrite(hdr, buf, sf * 2, file) != 1)
     {
       return -1;
     }
@@ -4032,7 +4121,7 @@ int edfwrite_digital_short_samples(int handle, short *buf)
       hdr->wrbuf[i * 3 + 2] = (value >> 16) & 0xff;
     }
 
-    if(fwrite(hdr->wrbuf, sf * 3, 1, file) != 1)
+    if(edflib_fwrite(hdr, hdr->wrbuf, sf * 3, file) != 1)
     {
       return -1;
     }
@@ -4051,7 +4140,7 @@ int edfwrite_digital_short_samples(int handle, short *buf)
 
     hdr->datarecords++;
 
-    fflush(file);
+    edflib_fflush(hdr, file);
   }
 
   return 0;
@@ -4160,7 +4249,7 @@ int edfwrite_digital_samples(int handle, int *buf)
       hdr->wrbuf[i * 2 + 1] = (value >> 8) & 0xff;
     }
 
-    if(fwrite(hdr->wrbuf, sf * 2, 1, file) != 1)
+    if(edflib_fwrite(hdr, hdr->wrbuf, sf * 2, file) != 1)
     {
       return -1;
     }
@@ -4204,7 +4293,7 @@ int edfwrite_digital_samples(int handle, int *buf)
       hdr->wrbuf[i * 3 + 2] = (value >> 16) & 0xff;
     }
 
-    if(fwrite(hdr->wrbuf, sf * 3, 1, file) != 1)
+    if(edflib_fwrite(hdr, hdr->wrbuf, sf * 3, file) != 1)
     {
       return -1;
     }
@@ -4223,7 +4312,7 @@ int edfwrite_digital_samples(int handle, int *buf)
 
     hdr->datarecords++;
 
-    fflush(file);
+    edflib_fflush(hdr, file);
   }
 
   return 0;
@@ -4339,7 +4428,7 @@ int edf_blockwrite_digital_samples(int handle, int *buf)
         hdr->wrbuf[i * 2 + 1] = (value >> 8) & 0xff;
       }
 
-      if(fwrite(hdr->wrbuf, sf * 2, 1, file) != 1)
+      if(edflib_fwrite(hdr, hdr->wrbuf, sf * 2, file) != 1)
       {
         return -1;
       }
@@ -4383,7 +4472,7 @@ int edf_blockwrite_digital_samples(int handle, int *buf)
         hdr->wrbuf[i * 3 + 2] = (value >> 16) & 0xff;
       }
 
-      if(fwrite(hdr->wrbuf, sf * 3, 1, file) != 1)
+      if(edflib_fwrite(hdr, hdr->wrbuf, sf * 3, file) != 1)
       {
         return -1;
       }
@@ -4399,7 +4488,7 @@ int edf_blockwrite_digital_samples(int handle, int *buf)
 
   hdr->datarecords++;
 
-  fflush(file);
+  edflib_fflush(hdr, file);
 
   return 0;
 }
@@ -4500,7 +4589,7 @@ int edf_blockwrite_digital_short_samples(int handle, short *buf)
         }
       }
 
-      if(fwrite(buf + buf_offset, sf * 2, 1, file) != 1)
+      if(edflib_fwrite(hdr, buf + buf_offset, sf * 2, file) != 1)
       {
         return -1;
       }
@@ -4544,7 +4633,7 @@ int edf_blockwrite_digital_short_samples(int handle, short *buf)
         hdr->wrbuf[i * 3 + 2] = (value >> 16) & 0xff;
       }
 
-      if(fwrite(hdr->wrbuf, sf * 3, 1, file) != 1)
+      if(edflib_fwrite(hdr, hdr->wrbuf, sf * 3, file) != 1)
       {
         return -1;
       }
@@ -4560,7 +4649,7 @@ int edf_blockwrite_digital_short_samples(int handle, short *buf)
 
   hdr->datarecords++;
 
-  fflush(file);
+  edflib_fflush(hdr, file);
 
   return 0;
 }
@@ -4634,7 +4723,7 @@ int edf_blockwrite_digital_3byte_samples(int handle, void *buf)
     total_samples += hdr->edfparam[j].smp_per_record;
   }
 
-  if(fwrite(buf, total_samples * 3, 1, file) != 1)
+  if(edflib_fwrite(hdr, buf, total_samples * 3, file) != 1)
   {
     return -1;
   }
@@ -4646,24 +4735,105 @@ int edf_blockwrite_digital_3byte_samples(int handle, void *buf)
 
   hdr->datarecords++;
 
-  fflush(file);
+  edflib_fflush(hdr, file);
 
   return 0;
 }
 
 
-int edfwrite_physical_samples(int handle, double *buf)
+int edf_blockwrite_digital_2byte_samples(int handle, void *buf)
 {
-  int  i,
+  int  j,
        error,
+       edfsignals,
+       total_samples=0;
+
+  FILE *file;
+
+  struct edfhdrblock *hdr;
+
+
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->signal_write_sequence_pos)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->edfsignals == 0)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->edf != 1)
+  {
+    return -1;
+  }
+
+  hdr = hdrlist[handle];
+
+  file = hdr->file_hdl;
+
+  edfsignals = hdr->edfsignals;
+
+  if(!hdr->datarecords)
+  {
+    error = edflib_write_edf_header(hdr);
+
+    if(error)
+    {
+      return error;
+    }
+  }
+
+  for(j=0; j<edfsignals; j++)
+  {
+    total_samples += hdr->edfparam[j].smp_per_record;
+  }
+
+  if(edflib_fwrite(hdr, buf, total_samples * 2, file) != 1)
+  {
+    return -1;
+  }
+
+  if(edflib_write_tal(hdr, file))
+  {
+    return -1;
+  }
+
+  hdr->datarecords++;
+
+  edflib_fflush(hdr, file);
+
+  return 0;
+}
+
+
+int edfwrite_physical_samples(int handle, double *buf)
+{
+  int  error,
        sf,
-       digmax,
-       digmin,
-       value,
        edfsignal;
 
-  double bitvalue,
-         phys_offset;
+  long long t[2];
 
   FILE *file;
 
@@ -4716,14 +4886,6 @@ int edfwrite_physical_samples(int handle, double *buf)
 
   sf = hdr->edfparam[edfsignal].smp_per_record;
 
-  digmax = hdr->edfparam[edfsignal].dig_max;
-
-  digmin = hdr->edfparam[edfsignal].dig_min;
-
-  bitvalue = hdr->edfparam[edfsignal].bitvalue;
-
-  phys_offset = hdr->edfparam[edfsignal].offset;
-
   if(hdr->edf)
   {
     if(hdr->wrbufsize < (sf * 2))
@@ -4742,26 +4904,13 @@ int edfwrite_physical_samples(int handle, double *buf)
       hdr->wrbufsize = sf * 2;
     }
 
-    for(i=0; i<sf; i++)
-    {
-      value = (buf[i] / bitvalue) - phys_offset;
-
-      if(value>digmax)
-      {
-        value = digmax;
-      }
-
-      if(value<digmin)
-      {
-        value = digmin;
-      }
+    edflib_stats_start(hdr, t);
 
-      hdr->wrbuf[i * 2] = value & 0xff;
+    edflib_quantize_2byte(buf, sf, hdr->edfparam + edfsignal, hdr->wrbuf);
 
-      hdr->wrbuf[i * 2 + 1] = (value >> 8) & 0xff;
-    }
+    edflib_stats_stop(hdr, t, EDFLIB_STATS_CONVERT, hdr->datarecords);
 
-    if(fwrite(hdr->wrbuf, sf * 2, 1, file) != 1)
+    if(edflib_fwrite(hdr, hdr->wrbuf, sf * 2, file) != 1)
     {
       return -1;
     }
@@ -4784,28 +4933,13 @@ int edfwrite_physical_samples(int handle, double *buf)
       hdr->wrbufsize = sf * 3;
     }
 
-    for(i=0; i<sf; i++)
-    {
-      value = (buf[i] / bitvalue) - phys_offset;
-
-      if(value>digmax)
-      {
-        value = digmax;
-      }
-
-      if(value<digmin)
-      {
-        value = digmin;
-      }
-
-      hdr->wrbuf[i * 3] = value & 0xff;
+    edflib_stats_start(hdr, t);
 
-      hdr->wrbuf[i * 3 + 1] = (value >> 8) & 0xff;
+    edflib_quantize_3byte(buf, sf, hdr->edfparam + edfsignal, hdr->wrbuf);
 
-      hdr->wrbuf[i * 3 + 2] = (value >> 16) & 0xff;
-    }
+    edflib_stats_stop(hdr, t, EDFLIB_STATS_CONVERT, hdr->datarecords);
 
-    if(fwrite(hdr->wrbuf, sf * 3, 1, file) != 1)
+    if(edflib_fwrite(hdr, hdr->wrbuf, sf * 3, file) != 1)
     {
       return -1;
     }
@@ -4824,7 +4958,7 @@ int edfwrite_physical_samples(int handle, double *buf)
 
     hdr->datarecords++;
 
-    fflush(file);
+    edflib_fflush(hdr, file);
   }
 
   return 0;
@@ -4833,17 +4967,13 @@ int edfwrite_physical_samples(int handle, double *buf)
 
 int edf_blockwrite_physical_samples(int handle, double *buf)
 {
-  int  i, j,
+  int  j,
        error,
        sf,
-       digmax,
-       digmin,
        edfsignals,
-       buf_offset,
-       value;
+       buf_offset;
 
-  double bitvalue,
-         phys_offset;
+  long long t[2];
 
   FILE *file;
 
@@ -4902,14 +5032,6 @@ int edf_blockwrite_physical_samples(int handle, double *buf)
   {
     sf = hdr->edfparam[j].smp_per_record;
 
-    digmax = hdr->edfparam[j].dig_max;
-
-    digmin = hdr->edfparam[j].dig_min;
-
-    bitvalue = hdr->edfparam[j].bitvalue;
-
-    phys_offset = hdr->edfparam[j].offset;
-
     if(hdr->edf)
     {
       if(hdr->wrbufsize < (sf * 2))
@@ -4928,26 +5050,13 @@ int edf_blockwrite_physical_samples(int handle, double *buf)
         hdr->wrbufsize = sf * 2;
       }
 
-      for(i=0; i<sf; i++)
-      {
-        value = (buf[i + buf_offset] / bitvalue) - phys_offset;
-
-        if(value>digmax)
-        {
-          value = digmax;
-        }
-
-        if(value<digmin)
-        {
-          value = digmin;
-        }
+      edflib_stats_start(hdr, t);
 
-        hdr->wrbuf[i * 2] = value & 0xff;
+      edflib_quantize_2byte(buf + buf_offset, sf, hdr->edfparam + j, hdr->wrbuf);
 
-        hdr->wrbuf[i * 2 + 1] = (value >> 8) & 0xff;
-      }
+      edflib_stats_stop(hdr, t, EDFLIB_STATS_CONVERT, hdr->datarecords);
 
-      if(fwrite(hdr->wrbuf, sf * 2, 1, file) != 1)
+      if(edflib_fwrite(hdr, hdr->wrbuf, sf * 2, file) != 1)
       {
         return -1;
       }
@@ -4970,28 +5079,13 @@ int edf_blockwrite_physical_samples(int handle, double *buf)
         hdr->wrbufsize = sf * 3;
       }
 
-      for(i=0; i<sf; i++)
-      {
-        value = (buf[i + buf_offset] / bitvalue) - phys_offset;
-
-        if(value>digmax)
-        {
-          value = digmax;
-        }
-
-        if(value<digmin)
-        {
-          value = digmin;
-        }
-
-        hdr->wrbuf[i * 3] = value & 0xff;
+      edflib_stats_start(hdr, t);
 
-        hdr->wrbuf[i * 3 + 1] = (value >> 8) & 0xff;
+      edflib_quantize_3byte(buf + buf_offset, sf, hdr->edfparam + j, hdr->wrbuf);
 
-        hdr->wrbuf[i * 3 + 2] = (value >> 16) & 0xff;
-      }
+      edflib_stats_stop(hdr, t, EDFLIB_STATS_CONVERT, hdr->datarecords);
 
-      if(fwrite(hdr->wrbuf, sf * 3, 1, file) != 1)
+      if(edflib_fwrite(hdr, hdr->wrbuf, sf * 3, file) != 1)
       {
         return -1;
       }
@@ -5007,1093 +5101,3022 @@ int edf_blockwrite_physical_samples(int handle, double *buf)
 
   hdr->datarecords++;
 
-  fflush(file);
+  edflib_fflush(hdr, file);
 
   return 0;
 }
 
 
-static int edflib_write_edf_header(struct edfhdrblock *hdr)
+int edf_blockwrite_records_physical_samples(int handle, double *buf, int n)
 {
-  int i, j, p, q,
-      len,
-      rest,
-      edfsignals;
+  return edflib_blockwrite_records(handle, buf, n, EDFLIB_RECORDS_PHYSICAL);
+}
 
-  char str[128];
 
-  struct tm *date_time;
+int edf_blockwrite_records_digital_samples(int handle, int *buf, int n)
+{
+  return edflib_blockwrite_records(handle, buf, n, EDFLIB_RECORDS_INT);
+}
 
-  time_t elapsed_time;
 
-  FILE *file;
+int edf_blockwrite_records_digital_short_samples(int handle, short *buf, int n)
+{
+  return edflib_blockwrite_records(handle, buf, n, EDFLIB_RECORDS_SHORT);
+}
 
 
-  file = hdr->file_hdl;
+int edf_blockwrite_records_digital_2byte_samples(int handle, void *buf, int n)
+{
+  return edflib_blockwrite_records(handle, buf, n, EDFLIB_RECORDS_2BYTE);
+}
 
-  edfsignals = hdr->edfsignals;
 
-  if(edfsignals<0)
-  {
-    return EDFLIB_NO_SIGNALS;
-  }
+int edf_blockwrite_records_digital_3byte_samples(int handle, void *buf, int n)
+{
+  return edflib_blockwrite_records(handle, buf, n, EDFLIB_RECORDS_3BYTE);
+}
 
-  if(edfsignals>EDFLIB_MAXSIGNALS)
-  {
-    return EDFLIB_TOO_MANY_SIGNALS;
-  }
 
-  hdr->eq_sf = 1;
-
-  hdr->recordsize = 0;
-
-  hdr->total_annot_bytes = EDFLIB_ANNOTATION_BYTES * hdr->nr_annot_chns;
-
-  for(i=0; i<edfsignals; i++)
-  {
-    if(hdr->edfparam[i].smp_per_record<1)
-    {
-      return EDFLIB_NO_SAMPLES_IN_RECORD;
-    }
-
-    if(hdr->edfparam[i].dig_max==hdr->edfparam[i].dig_min)
-    {
-      return EDFLIB_DIGMIN_IS_DIGMAX;
-    }
-
-    if(hdr->edfparam[i].dig_max<hdr->edfparam[i].dig_min)
-    {
-      return EDFLIB_DIGMAX_LOWER_THAN_DIGMIN;
-    }
+/* assembles n complete datarecords (samples and time-keeping annotations) in wrbuf and writes them at once */
+static int edflib_blockwrite_records(int handle, const void *buf, int n, int format)
+{
+  int  i, j, r,
+       error,
+       sf,
+       digmax,
+       digmin,
+       edfsignals,
+       smp_bytes,
+       buf_offset,
+       value;
 
-    if(hdr->edfparam[i].phys_max==hdr->edfparam[i].phys_min)
-    {
-      return EDFLIB_PHYSMIN_IS_PHYSMAX;
-    }
+  long long t[2],
+            total;
 
-    hdr->recordsize += hdr->edfparam[i].smp_per_record;
+  char *dest;
 
-    if(i > 0)
-    {
-      if(hdr->edfparam[i].smp_per_record != hdr->edfparam[i-1].smp_per_record)
-      {
-        hdr->eq_sf = 0;
-      }
-    }
-  }
+  FILE *file;
 
-  if(hdr->edf)
-  {
-    hdr->recordsize *= 2;
+  struct edfhdrblock *hdr;
 
-    hdr->recordsize += hdr->total_annot_bytes;
 
-    if(hdr->recordsize > (10 * 1024 * 1024))  /* datarecord size should not exceed 10MB for EDF */
-    {
-      return EDFLIB_DATARECORD_SIZE_TOO_BIG;
-    }  /* if your application gets hit by this limitation, lower the value for the datarecord duration */
-       /* using the function edf_set_datarecord_duration() */
-  }
-  else
+  if(handle<0)
   {
-    hdr->recordsize *= 3;
-
-    hdr->recordsize += hdr->total_annot_bytes;
-
-    if(hdr->recordsize > (15 * 1024 * 1024))  /* datarecord size should not exceed 15MB for BDF */
-    {
-      return EDFLIB_DATARECORD_SIZE_TOO_BIG;
-    }  /* if your application gets hit by this limitation, lower the value for the datarecord duration */
-       /* using the function edf_set_datarecord_duration() */
+    return -1;
   }
 
-  for(i=0; i<edfsignals; i++)
+  if(handle>=EDFLIB_MAXFILES)
   {
-    hdr->edfparam[i].bitvalue = (hdr->edfparam[i].phys_max - hdr->edfparam[i].phys_min) / (hdr->edfparam[i].dig_max - hdr->edfparam[i].dig_min);
-    hdr->edfparam[i].offset = hdr->edfparam[i].phys_max / hdr->edfparam[i].bitvalue - hdr->edfparam[i].dig_max;
+    return -1;
   }
 
-  rewind(file);
-
-  if(hdr->edf)
+  if(hdrlist[handle]==NULL)
   {
-    fprintf(file, "0       ");
+    return -1;
   }
-  else
+
+  if(!(hdrlist[handle]->writemode))
   {
-    fputc(255, file);
-    fprintf(file, "BIOSEMI");
+    return -1;
   }
 
-  p = 0;
-
-  if(hdr->plus_birthdate[0]==0)
+  if(hdrlist[handle]->signal_write_sequence_pos)
   {
-    rest = 72;
+    return -1;
   }
-  else
+
+  if(hdrlist[handle]->edfsignals == 0)
   {
-    rest = 62;
+    return -1;
   }
 
-  len = strlen(hdr->plus_patientcode);
-  if(len && rest)
+  if(n<1)
   {
-    if(len>rest)
-    {
-      len = rest;
-      rest = 0;
-    }
-    else
-    {
-      rest -= len;
-    }
-    edflib_strlcpy(str, hdr->plus_patientcode, 128);
-    edflib_latin1_to_ascii(str, len);
-    str[len] = 0;
-    for(i=0; i<len; i++)
-    {
-      if(str[i]==' ')
-      {
-        str[i] = '_';
-      }
-    }
-    p += fprintf(file, "%s ", str);
+    return -1;
   }
-  else
+
+  if(((format == EDFLIB_RECORDS_SHORT) || (format == EDFLIB_RECORDS_2BYTE)) && (hdrlist[handle]->bdf == 1))
   {
-    p += fprintf(file, "X ");
+    return -1;
   }
 
-  if(hdr->plus_gender[0]=='M')
+  if((format == EDFLIB_RECORDS_3BYTE) && (hdrlist[handle]->bdf != 1))
   {
-    fputc('M', file);
+    return -1;
   }
-  else
+
+  hdr = hdrlist[handle];
+
+  file = hdr->file_hdl;
+
+  edfsignals = hdr->edfsignals;
+
+  if(!hdr->datarecords)
   {
-    if(hdr->plus_gender[0]=='F')
-    {
-      fputc('F', file);
-    }
-    else
+    error = edflib_write_edf_header(hdr);
+
+    if(error)
     {
-      fputc('X', file);
+      return error;
     }
   }
-  fputc(' ', file);
-  p +=2;
 
-  if(hdr->plus_birthdate[0]==0)
-  {
-    fputc('X', file);
-    fputc(' ', file);
+  /* the size of a datarecord is known when the header has been written */
+  total = (long long)hdr->recordsize * n;
 
-    p +=2;
+  if(total > 2147483647LL)
+  {
+    return -1;
   }
-  else
+
+  if(hdr->wrbufsize < total)
   {
-    fputc(hdr->plus_birthdate[0], file);
-    fputc(hdr->plus_birthdate[1], file);
-    fputc('-', file);
-    q = edflib_atof_nonlocalized(&(hdr->plus_birthdate[3]));
-    switch(q)
+    free(hdr->wrbuf);
+
+    hdr->wrbufsize = 0;
+
+    hdr->wrbuf = (char *)malloc(total);
+
+    if(hdr->wrbuf == NULL)
     {
-      case  1: fprintf(file, "JAN");  break;
-      case  2: fprintf(file, "FEB");  break;
-      case  3: fprintf(file, "MAR");  break;
-      case  4: fprintf(file, "APR");  break;
-      case  5: fprintf(file, "MAY");  break;
-      case  6: fprintf(file, "JUN");  break;
-      case  7: fprintf(file, "JUL");  break;
-      case  8: fprintf(file, "AUG");  break;
-      case  9: fprintf(file, "SEP");  break;
-      case 10: fprintf(file, "OCT");  break;
-      case 11: fprintf(file, "NOV");  break;
-      case 12: fprintf(file, "DEC");  break;
+      return -1;
     }
-    fputc('-', file);
-    fputc(hdr->plus_birthdate[6], file);
-    fputc(hdr->plus_birthdate[7], file);
-    fputc(hdr->plus_birthdate[8], file);
-    fputc(hdr->plus_birthdate[9], file);
-    fputc(' ', file);
 
-    p += 12;
+    hdr->wrbufsize = total;
   }
 
-  len = strlen(hdr->plus_patient_name);
-  if(len && rest)
+  if(hdr->edf)
   {
-    if(len>rest)
-    {
-      len = rest;
-      rest = 0;
-    }
-    else
-    {
-      rest -= len;
-    }
-    edflib_strlcpy(str, hdr->plus_patient_name, 128);
-    edflib_latin1_to_ascii(str, len);
-    str[len] = 0;
-    for(i=0; i<len; i++)
-    {
-      if(str[i]==' ')
-      {
-        str[i] = '_';
-      }
-    }
-    p += fprintf(file, "%s", str);
+    smp_bytes = 2;
   }
   else
   {
-    fputc('X', file);
-
-    p++;
+    smp_bytes = 3;
   }
 
-  if(rest)
-  {
-    fputc(' ', file);
-
-    p++;
+  dest = hdr->wrbuf;
 
-    rest--;
-  }
+  buf_offset = 0;
 
-  len = strlen(hdr->plus_patient_additional);
-  if(len && rest)
+  for(r=0; r<n; r++)
   {
-    if(len>rest)
+    for(j=0; j<edfsignals; j++)
     {
-      len = rest;
-    }
-    edflib_strlcpy(str, hdr->plus_patient_additional, 128);
-    edflib_latin1_to_ascii(str, len);
-    str[len] = 0;
-    p += fprintf(file, "%s", str);
-  }
+      sf = hdr->edfparam[j].smp_per_record;
 
-  for(; p<80; p++)
-  {
-    fputc(' ', file);
-  }
+      digmax = hdr->edfparam[j].dig_max;
 
-  if(!hdr->startdate_year)
-  {
-    elapsed_time = time(NULL);
-    date_time = localtime(&elapsed_time);
+      digmin = hdr->edfparam[j].dig_min;
 
-    hdr->startdate_year = date_time->tm_year + 1900;
-    hdr->startdate_month = date_time->tm_mon + 1;
-    hdr->startdate_day = date_time->tm_mday;
-    hdr->starttime_hour = date_time->tm_hour;
-    hdr->starttime_minute = date_time->tm_min;
-    hdr->starttime_second = date_time->tm_sec % 60;
-  }
+      if(format == EDFLIB_RECORDS_PHYSICAL)
+      {
+        edflib_stats_start(hdr, t);
 
-  p = 0;
+        if(smp_bytes == 2)
+        {
+          edflib_quantize_2byte((const double *)buf + buf_offset, sf, hdr->edfparam + j, dest);
+        }
+        else
+        {
+          edflib_quantize_3byte((const double *)buf + buf_offset, sf, hdr->edfparam + j, dest);
+        }
 
-  p += fprintf(file, "Startdate %02u-", hdr->startdate_day);
-  switch(hdr->startdate_month)
-  {
-    case  1 : fprintf(file, "JAN");  break;
-    case  2 : fprintf(file, "FEB");  break;
-    case  3 : fprintf(file, "MAR");  break;
-    case  4 : fprintf(file, "APR");  break;
-    case  5 : fprintf(file, "MAY");  break;
-    case  6 : fprintf(file, "JUN");  break;
-    case  7 : fprintf(file, "JUL");  break;
-    case  8 : fprintf(file, "AUG");  break;
-    case  9 : fprintf(file, "SEP");  break;
-    case 10 : fprintf(file, "OCT");  break;
-    case 11 : fprintf(file, "NOV");  break;
-    case 12 : fprintf(file, "DEC");  break;
-  }
-  p += 3;
-  fputc('-', file);
-  p++;
-  p += edflib_fprint_int_number_nonlocalized(file, hdr->startdate_year, 4, 0);
-  fputc(' ', file);
-  p++;
+        edflib_stats_stop(hdr, t, EDFLIB_STATS_CONVERT, hdr->datarecords + r);
+      }
+      else if((format == EDFLIB_RECORDS_INT) || (format == EDFLIB_RECORDS_SHORT))
+        {
+          for(i=0; i<sf; i++)
+          {
+            if(format == EDFLIB_RECORDS_INT)
+            {
+              value = ((const int *)buf)[buf_offset + i];
+            }
+            else
+            {
+              value = ((const short *)buf)[buf_offset + i];
+            }
 
-  rest = 42;
+            if(value>digmax)
+            {
+              value = digmax;
+            }
 
-  len = strlen(hdr->plus_admincode);
-  if(len && rest)
-  {
-    if(len>rest)
-    {
-      len = rest;
-      rest = 0;
-    }
-    else
-    {
-      rest -= len;
+            if(value<digmin)
+            {
+              value = digmin;
+            }
+
+            dest[i * smp_bytes] = value & 0xff;
+
+            dest[i * smp_bytes + 1] = (value >> 8) & 0xff;
+
+            if(smp_bytes == 3)
+            {
+              dest[i * 3 + 2] = (value >> 16) & 0xff;
+            }
+          }
+        }
+        else  /* 2byte and 3byte, the samples are copied as they are */
+        {
+          memcpy(dest, (const char *)buf + ((size_t)buf_offset * smp_bytes), (size_t)sf * smp_bytes);
+        }
+
+      dest += sf * smp_bytes;
+
+      buf_offset += sf;
     }
-    edflib_strlcpy(str, hdr->plus_admincode, 128);
-    edflib_latin1_to_ascii(str, len);
-    str[len] = 0;
-    for(i=0; i<len; i++)
+
+    edflib_stats_start(hdr, t);
+
+    memcpy(dest, edflib_next_tal(hdr, hdr->datarecords + r), hdr->total_annot_bytes);
+
+    /* in stream mode, every datarecord takes the next annotations */
+    if(hdr->stream)
     {
-      if(str[i]==' ')
-      {
-        str[i] = '_';
-      }
+      edflib_stream_annotations(hdr, dest);
     }
-    p += fprintf(file, "%s", str);
+
+    dest += hdr->total_annot_bytes;
+
+    edflib_stats_stop(hdr, t, EDFLIB_STATS_TAL, hdr->datarecords + r);
   }
-  else
+
+  if(edflib_fwrite(hdr, hdr->wrbuf, total, file) != 1)
   {
-    p += fprintf(file, "X");
+    return -1;
   }
 
-  if(rest)
-  {
-    fputc(' ', file);
+  hdr->datarecords += n;
 
-    p++;
+  edflib_fflush(hdr, file);
 
-    rest--;
-  }
+  return 0;
+}
 
-  len = strlen(hdr->plus_technician);
-  if(len && rest)
+
+int edf_writev_records(int handle, void **chnbuf, int n)
+{
+#ifdef _WIN32
+  (void)handle;
+  (void)chnbuf;
+  (void)n;
+
+  return -1;
+#else
+  int  j, r, cnt=0,
+       error,
+       smp_bytes,
+       edfsignals;
+
+  long long t[2],
+            total,
+            offset;
+
+  char *tal;
+
+  FILE *file;
+
+  struct edfhdrblock *hdr;
+
+  struct iovec iov[EDFLIB_IOV_MAX];
+
+
+  if(handle<0)
   {
-    if(len>rest)
-    {
-      len = rest;
-      rest = 0;
-    }
-    else
-    {
-      rest -= len;
-    }
-    edflib_strlcpy(str, hdr->plus_technician, 128);
-    edflib_latin1_to_ascii(str, len);
-    str[len] = 0;
-    for(i=0; i<len; i++)
-    {
-      if(str[i]==' ')
-      {
-        str[i] = '_';
-      }
-    }
-    p += fprintf(file, "%s", str);
+    return -1;
   }
-  else
+
+  if(handle>=EDFLIB_MAXFILES)
   {
-    p += fprintf(file, "X");
+    return -1;
   }
 
-  if(rest)
+  if(hdrlist[handle]==NULL)
   {
-    fputc(' ', file);
-
-    p++;
+    return -1;
+  }
 
-    rest--;
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
   }
 
-  len = strlen(hdr->plus_equipment);
-  if(len && rest)
+  if(hdrlist[handle]->signal_write_sequence_pos)
   {
-    if(len>rest)
-    {
-      len = rest;
-      rest = 0;
-    }
-    else
-    {
-      rest -= len;
-    }
-    edflib_strlcpy(str, hdr->plus_equipment, 128);
-    edflib_latin1_to_ascii(str, len);
-    str[len] = 0;
-    for(i=0; i<len; i++)
-    {
-      if(str[i]==' ')
-      {
-        str[i] = '_';
-      }
-    }
-    p += fprintf(file, "%s", str);
+    return -1;
   }
-  else
+
+  if(hdrlist[handle]->edfsignals == 0)
   {
-    p += fprintf(file, "X");
+    return -1;
   }
 
-  if(rest)
+  if((n<1) || (chnbuf == NULL))
   {
-    fputc(' ', file);
+    return -1;
+  }
 
-    p++;
+  hdr = hdrlist[handle];
 
-    rest--;
-  }
+  file = hdr->file_hdl;
 
-  len = strlen(hdr->plus_recording_additional);
-  if(len && rest)
+  edfsignals = hdr->edfsignals;
+
+  for(j=0; j<edfsignals; j++)
   {
-    if(len>rest)
+    if(chnbuf[j] == NULL)
     {
-      len = rest;
+      return -1;
     }
-    edflib_strlcpy(str, hdr->plus_recording_additional, 128);
-    edflib_latin1_to_ascii(str, len);
-    str[len] = 0;
-    p += fprintf(file, "%s", str);
-  }
-
-  for(; p<80; p++)
-  {
-    fputc(' ', file);
   }
 
-  fprintf(file, "%02u.%02u.%02u", hdr->startdate_day, hdr->startdate_month, (hdr->startdate_year % 100));
-  fprintf(file, "%02u.%02u.%02u", hdr->starttime_hour, hdr->starttime_minute, hdr->starttime_second);
-  p = edflib_fprint_int_number_nonlocalized(file, (edfsignals + hdr->nr_annot_chns + 1) * 256, 0, 0);
-  for(; p<8; p++)
-  {
-    fputc(' ', file);
-  }
   if(hdr->edf)
   {
-    fprintf(file, "EDF+C");
+    smp_bytes = 2;
   }
   else
   {
-    fprintf(file, "BDF+C");
-  }
-  for(i=0; i<39; i++)
-  {
-    fputc(' ', file);
-  }
-  fprintf(file, "-1      ");
-  if(hdr->long_data_record_duration == EDFLIB_TIME_DIMENSION)
-  {
-    fprintf(file, "1       ");
+    smp_bytes = 3;
   }
-  else
+
+  if(!hdr->datarecords)
   {
-    edflib_snprint_number_nonlocalized(str, hdr->data_record_duration, 128);
-    edflib_strlcat(str, "        ", 128);
-    str[8] = 0;
-    fprintf(file, "%s", str);
+    error = edflib_write_edf_header(hdr);
+
+    if(error)
+    {
+      return error;
+    }
   }
-  p = edflib_fprint_int_number_nonlocalized(file, edfsignals + hdr->nr_annot_chns, 0, 0);
-  for(; p<4; p++)
+
+  /* only the time-keeping annotations are stored in wrbuf, the samples are written from chnbuf */
+  total = (long long)hdr->total_annot_bytes * n;
+
+  if(total > 2147483647LL)
   {
-    fputc(' ', file);
+    return -1;
   }
 
-  for(i=0; i<edfsignals; i++)
+  if(hdr->wrbufsize < total)
   {
-    len = strlen(hdr->edfparam[i].label);
-    edflib_latin1_to_ascii(hdr->edfparam[i].label, len);
-    for(j=0; j<len; j++)
-    {
-      fputc(hdr->edfparam[i].label[j], file);
-    }
-    for(; j<16; j++)
+    free(hdr->wrbuf);
+
+    hdr->wrbufsize = 0;
+
+    hdr->wrbuf = (char *)malloc(total);
+
+    if(hdr->wrbuf == NULL)
     {
-      fputc(' ', file);
+      return -1;
     }
+
+    hdr->wrbufsize = total;
   }
-  for(j=0; j<hdr->nr_annot_chns; j++)
+
+  for(r=0; r<n; r++)
   {
-    if(hdr->edf)
-    {
-      fprintf(file, "EDF Annotations ");
-    }
-    else
+    edflib_stats_start(hdr, t);
+
+    tal = hdr->wrbuf + ((size_t)hdr->total_annot_bytes * r);
+
+    memcpy(tal, edflib_next_tal(hdr, hdr->datarecords + r), hdr->total_annot_bytes);
+
+    /* in stream mode, every datarecord takes the next annotations */
+    if(hdr->stream)
     {
-      fprintf(file, "BDF Annotations ");
+      edflib_stream_annotations(hdr, tal);
     }
+
+    edflib_stats_stop(hdr, t, EDFLIB_STATS_TAL, hdr->datarecords + r);
   }
-  for(i=0; i<edfsignals; i++)
+
+  /* the datarecords are written in the order: the samples of every signal, the annotation signals */
+  /* a small number of datarecords is cheaper to copy to the buffer of the file than a system call */
+  if(((long long)hdr->recordsize * n) < EDFLIB_WRITEV_MIN_BYTES)
   {
-    len = strlen(hdr->edfparam[i].transducer);
-    edflib_latin1_to_ascii(hdr->edfparam[i].transducer, len);
-    for(j=0; j<len; j++)
+    for(r=0; r<n; r++)
     {
-      fputc(hdr->edfparam[i].transducer[j], file);
-    }
-    for(; j<80; j++)
-    {
-      fputc(' ', file);
+      for(j=0; j<edfsignals; j++)
+      {
+        if(edflib_fwrite(hdr, (char *)chnbuf[j] + ((size_t)hdr->edfparam[j].smp_per_record * smp_bytes * r), (size_t)hdr->edfparam[j].smp_per_record * smp_bytes, file) != 1)
+        {
+          return -1;
+        }
+      }
+
+      if(edflib_fwrite(hdr, hdr->wrbuf + ((size_t)hdr->total_annot_bytes * r), hdr->total_annot_bytes, file) != 1)
+      {
+        return -1;
+      }
     }
+
+    hdr->datarecords += n;
+
+    edflib_fflush(hdr, file);
+
+    return 0;
   }
-  for(j=0; j<hdr->nr_annot_chns; j++)
+
+  /* the data that is still in the buffer of the file must be written first */
+  if(fflush(file))
   {
-    for(i=0; i<80; i++)
-    {
-      fputc(' ', file);
-    }
+    return -1;
   }
-  for(i=0; i<edfsignals; i++)
+
+  for(r=0; r<n; r++)
   {
-    len = strlen(hdr->edfparam[i].physdimension);
-    edflib_latin1_to_ascii(hdr->edfparam[i].physdimension, len);
-    for(j=0; j<len; j++)
+    for(j=0; j<=edfsignals; j++)
     {
-      fputc(hdr->edfparam[i].physdimension[j], file);
+      if(j < edfsignals)
+      {
+        iov[cnt].iov_base = (char *)chnbuf[j] + ((size_t)hdr->edfparam[j].smp_per_record * smp_bytes * r);
+
+        iov[cnt].iov_len = (size_t)hdr->edfparam[j].smp_per_record * smp_bytes;
+      }
+      else
+      {
+        iov[cnt].iov_base = hdr->wrbuf + ((size_t)hdr->total_annot_bytes * r);
+
+        iov[cnt].iov_len = hdr->total_annot_bytes;
+      }
+
+      cnt++;
+
+      if(cnt == EDFLIB_IOV_MAX)
+      {
+        if(edflib_writev(hdr, iov, cnt))
+        {
+          return -1;
+        }
+
+        cnt = 0;
+      }
     }
-    for(; j<8; j++)
+  }
+
+  if(cnt)
+  {
+    if(edflib_writev(hdr, iov, cnt))
     {
-      fputc(' ', file);
+      return -1;
     }
   }
-  for(j=0; j<hdr->nr_annot_chns; j++)
+
+  hdr->datarecords += n;
+
+  hdr->flushed_datarecords = hdr->datarecords;
+
+  /* the file position of the stream must follow the file descriptor, a stream never seeks */
+  if(!hdr->stream)
   {
-    fprintf(file, "        ");
+    offset = ((long long)(hdr->edfsignals + hdr->nr_annot_chns + 1) * 256LL) + (hdr->datarecords * hdr->recordsize);
+
+    if(fseeko(file, offset, SEEK_SET))
+    {
+      return -1;
+    }
   }
-  for(i=0; i<edfsignals; i++)
+
+  return 0;
+#endif
+}
+
+
+#ifndef _WIN32
+/* writes the buffers of iov to the file descriptor of the file, continues after a partial write */
+static int edflib_writev(struct edfhdrblock *hdr, struct iovec *iov, int cnt)
+{
+  ssize_t written;
+
+  long long t[2];
+
+  edflib_stats_start(hdr, t);
+
+  while(cnt > 0)
   {
-    p = edflib_snprint_number_nonlocalized(str, hdr->edfparam[i].phys_min, 128);
-    for(; p<8; p++)
+    written = writev(fileno(hdr->file_hdl), iov, cnt);
+
+    if(written < 0)
     {
-      str[p] = ' ';
+      if(errno == EINTR)
+      {
+        continue;
+      }
+
+      edflib_stats_stop(hdr, t, EDFLIB_STATS_WRITE, hdr->datarecords);
+
+      return -1;
+    }
+
+    if(hdr->stats != NULL)
+    {
+      __atomic_add_fetch(&hdr->stats->bytes, (long long)written, __ATOMIC_RELAXED);
+    }
+
+    while((cnt > 0) && ((size_t)written >= iov->iov_len))
+    {
+      written -= iov->iov_len;
+
+      iov++;
+
+      cnt--;
+    }
+
+    if(cnt > 0)
+    {
+      iov->iov_base = (char *)iov->iov_base + written;
+
+      iov->iov_len -= written;
     }
-    str[8] = 0;
-    fprintf(file, "%s", str);
   }
-  for(j=0; j<hdr->nr_annot_chns; j++)
+
+  edflib_stats_stop(hdr, t, EDFLIB_STATS_WRITE, hdr->datarecords);
+
+  return 0;
+}
+#endif
+
+
+static int edflib_write_edf_header(struct edfhdrblock *hdr)
+{
+  int err;
+
+  long long t[2];
+
+  edflib_stats_start(hdr, t);
+
+  err = edflib_write_edf_header_fields(hdr);
+
+  edflib_stats_stop(hdr, t, EDFLIB_STATS_HEADER, -1LL);
+
+  return err;
+}
+
+
+static int edflib_write_edf_header_fields(struct edfhdrblock *hdr)
+{
+  int i, j, p, q,
+      len,
+      rest,
+      edfsignals;
+
+  char str[128];
+
+  struct tm *date_time;
+
+  time_t elapsed_time;
+
+  FILE *file;
+
+
+  file = hdr->file_hdl;
+
+  /* stdout can not seek, the number of datarecords in the header must be known beforehand */
+  if((file == stdout) && (!hdr->stream))
   {
-    fprintf(file, "-1      ");
+    return EDFLIB_STREAM_MODE_REQUIRED;
   }
-  for(i=0; i<edfsignals; i++)
+
+  edfsignals = hdr->edfsignals;
+
+  if(edfsignals<0)
   {
-    p = edflib_snprint_number_nonlocalized(str, hdr->edfparam[i].phys_max, 128);
-    for(; p<8; p++)
-    {
-      str[p] = ' ';
-    }
-    str[8] = 0;
-    fprintf(file, "%s", str);
+    return EDFLIB_NO_SIGNALS;
   }
-  for(j=0; j<hdr->nr_annot_chns; j++)
+
+  if(edfsignals>EDFLIB_MAXSIGNALS)
   {
-    fprintf(file, "1       ");
+    return EDFLIB_TOO_MANY_SIGNALS;
   }
+
+  hdr->eq_sf = 1;
+
+  hdr->recordsize = 0;
+
+  hdr->total_annot_bytes = EDFLIB_ANNOTATION_BYTES * hdr->nr_annot_chns;
+
   for(i=0; i<edfsignals; i++)
   {
-    p = edflib_fprint_int_number_nonlocalized(file, hdr->edfparam[i].dig_min, 0, 0);
-    for(; p<8; p++)
+    if(hdr->edfparam[i].smp_per_record<1)
     {
-      fputc(' ', file);
+      return EDFLIB_NO_SAMPLES_IN_RECORD;
     }
-  }
-  for(j=0; j<hdr->nr_annot_chns; j++)
-  {
-    if(hdr->edf)
+
+    if(hdr->edfparam[i].dig_max==hdr->edfparam[i].dig_min)
     {
-      fprintf(file, "-32768  ");
+      return EDFLIB_DIGMIN_IS_DIGMAX;
     }
-    else
+
+    if(hdr->edfparam[i].dig_max<hdr->edfparam[i].dig_min)
     {
-      fprintf(file, "-8388608");
+      return EDFLIB_DIGMAX_LOWER_THAN_DIGMIN;
+    }
+
+    if(hdr->edfparam[i].phys_max==hdr->edfparam[i].phys_min)
+    {
+      return EDFLIB_PHYSMIN_IS_PHYSMAX;
+    }
+
+    hdr->recordsize += hdr->edfparam[i].smp_per_record;
+
+    if(i > 0)
+    {
+      if(hdr->edfparam[i].smp_per_record != hdr->edfparam[i-1].smp_per_record)
+      {
+        hdr->eq_sf = 0;
+      }
     }
   }
-  for(i=0; i<edfsignals; i++)
+
+  if(hdr->edf)
   {
-    p = edflib_fprint_int_number_nonlocalized(file, hdr->edfparam[i].dig_max, 0, 0);
-    for(; p<8; p++)
+    hdr->recordsize *= 2;
+
+    hdr->recordsize += hdr->total_annot_bytes;
+
+    if(hdr->recordsize > (10 * 1024 * 1024))  /* datarecord size should not exceed 10MB for EDF */
     {
-      fputc(' ', file);
-    }
+      return EDFLIB_DATARECORD_SIZE_TOO_BIG;
+    }  /* if your application gets hit by this limitation, lower the value for the datarecord duration */
+       /* using the function edf_set_datarecord_duration() */
   }
-  for(j=0; j<hdr->nr_annot_chns; j++)
+  else
   {
-    if(hdr->edf)
+    hdr->recordsize *= 3;
+
+    hdr->recordsize += hdr->total_annot_bytes;
+
+    if(hdr->recordsize > (15 * 1024 * 1024))  /* datarecord size should not exceed 15MB for BDF */
     {
-      fprintf(file, "32767   ");
+      return EDFLIB_DATARECORD_SIZE_TOO_BIG;
+    }  /* if your application gets hit by this limitation, lower the value for the datarecord duration */
+       /* using the function edf_set_datarecord_duration() */
+  }
+
+  for(i=0; i<edfsignals; i++)
+  {
+    hdr->edfparam[i].bitvalue = (hdr->edfparam[i].phys_max - hdr->edfparam[i].phys_min) / (hdr->edfparam[i].dig_max - hdr->edfparam[i].dig_min);
+    hdr->edfparam[i].offset = hdr->edfparam[i].phys_max / hdr->edfparam[i].bitvalue - hdr->edfparam[i].dig_max;
+  }
+
+  if(!hdr->stream)
+  {
+    rewind(file);
+  }
+
+  if(hdr->edf)
+  {
+    fprintf(file, "0       ");
+  }
+  else
+  {
+    fputc(255, file);
+    fprintf(file, "BIOSEMI");
+  }
+
+  p = 0;
+
+  if(hdr->plus_birthdate[0]==0)
+  {
+    rest = 72;
+  }
+  else
+  {
+    rest = 62;
+  }
+
+  len = strlen(hdr->plus_patientcode);
+  if(len && rest)
+  {
+    if(len>rest)
+    {
+      len = rest;
+      rest = 0;
     }
     else
     {
-      fprintf(file, "8388607 ");
+      rest -= len;
+    }
+    edflib_strlcpy(str, hdr->plus_patientcode, 128);
+    edflib_latin1_to_ascii(str, len);
+    str[len] = 0;
+    for(i=0; i<len; i++)
+    {
+      if(str[i]==' ')
+      {
+        str[i] = '_';
+      }
+    }
+    p += fprintf(file, "%s ", str);
+  }
+  else
+  {
+    p += fprintf(file, "X ");
+  }
+
+  if(hdr->plus_gender[0]=='M')
+  {
+    fputc('M', file);
+  }
+  else
+  {
+    if(hdr->plus_gender[0]=='F')
+    {
+      fputc('F', file);
+    }
+    else
+    {
+      fputc('X', file);
+    }
+  }
+  fputc(' ', file);
+  p +=2;
+
+  if(hdr->plus_birthdate[0]==0)
+  {
+    fputc('X', file);
+    fputc(' ', file);
+
+    p +=2;
+  }
+  else
+  {
+    fputc(hdr->plus_birthdate[0], file);
+    fputc(hdr->plus_birthdate[1], file);
+    fputc('-', file);
+    q = edflib_atof_nonlocalized(&(hdr->plus_birthdate[3]));
+    switch(q)
+    {
+      case  1: fprintf(file, "JAN");  break;
+      case  2: fprintf(file, "FEB");  break;
+      case  3: fprintf(file, "MAR");  break;
+      case  4: fprintf(file, "APR");  break;
+      case  5: fprintf(file, "MAY");  break;
+      case  6: fprintf(file, "JUN");  break;
+      case  7: fprintf(file, "JUL");  break;
+      case  8: fprintf(file, "AUG");  break;
+      case  9: fprintf(file, "SEP");  break;
+      case 10: fprintf(file, "OCT");  break;
+      case 11: fprintf(file, "NOV");  break;
+      case 12: fprintf(file, "DEC");  break;
+    }
+    fputc('-', file);
+    fputc(hdr->plus_birthdate[6], file);
+    fputc(hdr->plus_birthdate[7], file);
+    fputc(hdr->plus_birthdate[8], file);
+    fputc(hdr->plus_birthdate[9], file);
+    fputc(' ', file);
+
+    p += 12;
+  }
+
+  len = strlen(hdr->plus_patient_name);
+  if(len && rest)
+  {
+    if(len>rest)
+    {
+      len = rest;
+      rest = 0;
+    }
+    else
+    {
+      rest -= len;
+    }
+    edflib_strlcpy(str, hdr->plus_patient_name, 128);
+    edflib_latin1_to_ascii(str, len);
+    str[len] = 0;
+    for(i=0; i<len; i++)
+    {
+      if(str[i]==' ')
+      {
+        str[i] = '_';
+      }
+    }
+    p += fprintf(file, "%s", str);
+  }
+  else
+  {
+    fputc('X', file);
+
+    p++;
+  }
+
+  if(rest)
+  {
+    fputc(' ', file);
+
+    p++;
+
+    rest--;
+  }
+
+  len = strlen(hdr->plus_patient_additional);
+  if(len && rest)
+  {
+    if(len>rest)
+    {
+      len = rest;
+    }
+    edflib_strlcpy(str, hdr->plus_patient_additional, 128);
+    edflib_latin1_to_ascii(str, len);
+    str[len] = 0;
+    p += fprintf(file, "%s", str);
+  }
+
+  for(; p<80; p++)
+  {
+    fputc(' ', file);
+  }
+
+  if(!hdr->startdate_year)
+  {
+    elapsed_time = time(NULL);
+    date_time = localtime(&elapsed_time);
+
+    hdr->startdate_year = date_time->tm_year + 1900;
+    hdr->startdate_month = date_time->tm_mon + 1;
+    hdr->startdate_day = date_time->tm_mday;
+    hdr->starttime_hour = date_time->tm_hour;
+    hdr->starttime_minute = date_time->tm_min;
+    hdr->starttime_second = date_time->tm_sec % 60;
+  }
+
+  p = 0;
+
+  p += fprintf(file, "Startdate %02u-", hdr->startdate_day);
+  switch(hdr->startdate_month)
+  {
+    case  1 : fprintf(file, "JAN");  break;
+    case  2 : fprintf(file, "FEB");  break;
+    case  3 : fprintf(file, "MAR");  break;
+    case  4 : fprintf(file, "APR");  break;
+    case  5 : fprintf(file, "MAY");  break;
+    case  6 : fprintf(file, "JUN");  break;
+    case  7 : fprintf(file, "JUL");  break;
+    case  8 : fprintf(file, "AUG");  break;
+    case  9 : fprintf(file, "SEP");  break;
+    case 10 : fprintf(file, "OCT");  break;
+    case 11 : fprintf(file, "NOV");  break;
+    case 12 : fprintf(file, "DEC");  break;
+  }
+  p += 3;
+  fputc('-', file);
+  p++;
+  p += edflib_fprint_int_number_nonlocalized(file, hdr->startdate_year, 4, 0);
+  fputc(' ', file);
+  p++;
+
+  rest = 42;
+
+  len = strlen(hdr->plus_admincode);
+  if(len && rest)
+  {
+    if(len>rest)
+    {
+      len = rest;
+      rest = 0;
+    }
+    else
+    {
+      rest -= len;
+    }
+    edflib_strlcpy(str, hdr->plus_admincode, 128);
+    edflib_latin1_to_ascii(str, len);
+    str[len] = 0;
+    for(i=0; i<len; i++)
+    {
+      if(str[i]==' ')
+      {
+        str[i] = '_';
+      }
+    }
+    p += fprintf(file, "%s", str);
+  }
+  else
+  {
+    p += fprintf(file, "X");
+  }
+
+  if(rest)
+  {
+    fputc(' ', file);
+
+    p++;
+
+    rest--;
+  }
+
+  len = strlen(hdr->plus_technician);
+  if(len && rest)
+  {
+    if(len>rest)
+    {
+      len = rest;
+      rest = 0;
+    }
+    else
+    {
+      rest -= len;
+    }
+    edflib_strlcpy(str, hdr->plus_technician, 128);
+    edflib_latin1_to_ascii(str, len);
+    str[len] = 0;
+    for(i=0; i<len; i++)
+    {
+      if(str[i]==' ')
+      {
+        str[i] = '_';
+      }
+    }
+    p += fprintf(file, "%s", str);
+  }
+  else
+  {
+    p += fprintf(file, "X");
+  }
+
+  if(rest)
+  {
+    fputc(' ', file);
+
+    p++;
+
+    rest--;
+  }
+
+  len = strlen(hdr->plus_equipment);
+  if(len && rest)
+  {
+    if(len>rest)
+    {
+      len = rest;
+      rest = 0;
+    }
+    else
+    {
+      rest -= len;
+    }
+    edflib_strlcpy(str, hdr->plus_equipment, 128);
+    edflib_latin1_to_ascii(str, len);
+    str[len] = 0;
+    for(i=0; i<len; i++)
+    {
+      if(str[i]==' ')
+      {
+        str[i] = '_';
+      }
+    }
+    p += fprintf(file, "%s", str);
+  }
+  else
+  {
+    p += fprintf(file, "X");
+  }
+
+  if(rest)
+  {
+    fputc(' ', file);
+
+    p++;
+
+    rest--;
+  }
+
+  len = strlen(hdr->plus_recording_additional);
+  if(len && rest)
+  {
+    if(len>rest)
+    {
+      len = rest;
+    }
+    edflib_strlcpy(str, hdr->plus_recording_additional, 128);
+    edflib_latin1_to_ascii(str, len);
+    str[len] = 0;
+    p += fprintf(file, "%s", str);
+  }
+
+  for(; p<80; p++)
+  {
+    fputc(' ', file);
+  }
+
+  fprintf(file, "%02u.%02u.%02u", hdr->startdate_day, hdr->startdate_month, (hdr->startdate_year % 100));
+  fprintf(file, "%02u.%02u.%02u", hdr->starttime_hour, hdr->starttime_minute, hdr->starttime_second);
+  p = edflib_fprint_int_number_nonlocalized(file, (edfsignals + hdr->nr_annot_chns + 1) * 256, 0, 0);
+  for(; p<8; p++)
+  {
+    fputc(' ', file);
+  }
+  if(hdr->edf)
+  {
+    fprintf(file, "EDF+C");
+  }
+  else
+  {
+    fprintf(file, "BDF+C");
+  }
+  for(i=0; i<39; i++)
+  {
+    fputc(' ', file);
+  }
+  if(hdr->stream && (hdr->stream_datarecords<100000000LL))
+  {
+    p = edflib_fprint_ll_number_nonlocalized(file, hdr->stream_datarecords, 0, 0);
+    for(; p<8; p++)
+    {
+      fputc(' ', file);
+    }
+  }
+  else
+  {
+    fprintf(file, "-1      ");
+  }
+  if(hdr->long_data_record_duration == EDFLIB_TIME_DIMENSION)
+  {
+    fprintf(file, "1       ");
+  }
+  else
+  {
+    edflib_snprint_number_nonlocalized(str, hdr->data_record_duration, 128);
+    edflib_strlcat(str, "        ", 128);
+    str[8] = 0;
+    fprintf(file, "%s", str);
+  }
+  p = edflib_fprint_int_number_nonlocalized(file, edfsignals + hdr->nr_annot_chns, 0, 0);
+  for(; p<4; p++)
+  {
+    fputc(' ', file);
+  }
+
+  for(i=0; i<edfsignals; i++)
+  {
+    len = strlen(hdr->edfparam[i].label);
+    edflib_latin1_to_ascii(hdr->edfparam[i].label, len);
+    for(j=0; j<len; j++)
+    {
+      fputc(hdr->edfparam[i].label[j], file);
+    }
+    for(; j<16; j++)
+    {
+      fputc(' ', file);
+    }
+  }
+  for(j=0; j<hdr->nr_annot_chns; j++)
+  {
+    if(hdr->edf)
+    {
+      fprintf(file, "EDF Annotations ");
+    }
+    else
+    {
+      fprintf(file, "BDF Annotations ");
+    }
+  }
+  for(i=0; i<edfsignals; i++)
+  {
+    len = strlen(hdr->edfparam[i].transducer);
+    edflib_latin1_to_ascii(hdr->edfparam[i].transducer, len);
+    for(j=0; j<len; j++)
+    {
+      fputc(hdr->edfparam[i].transducer[j], file);
+    }
+    for(; j<80; j++)
+    {
+      fputc(' ', file);
+    }
+  }
+  for(j=0; j<hdr->nr_annot_chns; j++)
+  {
+    for(i=0; i<80; i++)
+    {
+      fputc(' ', file);
+    }
+  }
+  for(i=0; i<edfsignals; i++)
+  {
+    len = strlen(hdr->edfparam[i].physdimension);
+    edflib_latin1_to_ascii(hdr->edfparam[i].physdimension, len);
+    for(j=0; j<len; j++)
+    {
+      fputc(hdr->edfparam[i].physdimension[j], file);
+    }
+    for(; j<8; j++)
+    {
+      fputc(' ', file);
+    }
+  }
+  for(j=0; j<hdr->nr_annot_chns; j++)
+  {
+    fprintf(file, "        ");
+  }
+  for(i=0; i<edfsignals; i++)
+  {
+    p = edflib_snprint_number_nonlocalized(str, hdr->edfparam[i].phys_min, 128);
+    for(; p<8; p++)
+    {
+      str[p] = ' ';
+    }
+    str[8] = 0;
+    fprintf(file, "%s", str);
+  }
+  for(j=0; j<hdr->nr_annot_chns; j++)
+  {
+    fprintf(file, "-1      ");
+  }
+  for(i=0; i<edfsignals; i++)
+  {
+    p = edflib_snprint_number_nonlocalized(str, hdr->edfparam[i].phys_max, 128);
+    for(; p<8; p++)
+    {
+      str[p] = ' ';
+    }
+    str[8] = 0;
+    fprintf(file, "%s", str);
+  }
+  for(j=0; j<hdr->nr_annot_chns; j++)
+  {
+    fprintf(file, "1       ");
+  }
+  for(i=0; i<edfsignals; i++)
+  {
+    p = edflib_fprint_int_number_nonlocalized(file, hdr->edfparam[i].dig_min, 0, 0);
+    for(; p<8; p++)
+    {
+      fputc(' ', file);
+    }
+  }
+  for(j=0; j<hdr->nr_annot_chns; j++)
+  {
+    if(hdr->edf)
+    {
+      fprintf(file, "-32768  ");
+    }
+    else
+    {
+      fprintf(file, "-8388608");
+    }
+  }
+  for(i=0; i<edfsignals; i++)
+  {
+    p = edflib_fprint_int_number_nonlocalized(file, hdr->edfparam[i].dig_max, 0, 0);
+    for(; p<8; p++)
+    {
+      fputc(' ', file);
+    }
+  }
+  for(j=0; j<hdr->nr_annot_chns; j++)
+  {
+    if(hdr->edf)
+    {
+      fprintf(file, "32767   ");
+    }
+    else
+    {
+      fprintf(file, "8388607 ");
+    }
+  }
+  for(i=0; i<edfsignals; i++)
+  {
+    len = strlen(hdr->edfparam[i].prefilter);
+    edflib_latin1_to_ascii(hdr->edfparam[i].prefilter, len);
+    for(j=0; j<len; j++)
+    {
+      fputc(hdr->edfparam[i].prefilter[j], file);
+    }
+    for(; j<80; j++)
+    {
+      fputc(' ', file);
+    }
+  }
+  for(i=0; i<hdr->nr_annot_chns; i++)
+  {
+    for(j=0; j<80; j++)
+    {
+      fputc(' ', file);
+    }
+  }
+  for(i=0; i<edfsignals; i++)
+  {
+    p = edflib_fprint_int_number_nonlocalized(file, hdr->edfparam[i].smp_per_record, 0, 0);
+    for(; p<8; p++)
+    {
+      fputc(' ', file);
+    }
+  }
+  for(j=0; j<hdr->nr_annot_chns; j++)
+  {
+    if(hdr->edf)
+    {
+      p = edflib_fprint_int_number_nonlocalized(file, EDFLIB_ANNOTATION_BYTES / 2, 0, 0);
+      for(; p<8; p++)
+      {
+        fputc(' ', file);
+      }
+    }
+    else
+    {
+      p = edflib_fprint_int_number_nonlocalized(file, EDFLIB_ANNOTATION_BYTES / 3, 0, 0);
+      for(; p<8; p++)
+      {
+        fputc(' ', file);
+      }
+    }
+  }
+  for(i=0; i<(edfsignals * 32); i++)
+  {
+    fputc(' ', file);
+  }
+  for(i=0; i<(hdr->nr_annot_chns * 32); i++)
+  {
+    fputc(' ', file);
+  }
+
+  return 0;
+}
+
+
+int edf_set_label(int handle, int edfsignal, const char *label)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(edfsignal<0)
+  {
+    return -1;
+  }
+
+  if(edfsignal>=hdrlist[handle]->edfsignals)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  strncpy(hdrlist[handle]->edfparam[edfsignal].label, label, 16);
+
+  hdrlist[handle]->edfparam[edfsignal].label[16] = 0;
+
+  edflib_remove_padding_trailing_spaces(hdrlist[handle]->edfparam[edfsignal].label);
+
+  return 0;
+}
+
+
+int edf_set_physical_dimension(int handle, int edfsignal, const char *phys_dim)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(edfsignal<0)
+  {
+    return -1;
+  }
+
+  if(edfsignal>=hdrlist[handle]->edfsignals)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  strncpy(hdrlist[handle]->edfparam[edfsignal].physdimension, phys_dim, 8);
+
+  hdrlist[handle]->edfparam[edfsignal].physdimension[8] = 0;
+
+  edflib_remove_padding_trailing_spaces(hdrlist[handle]->edfparam[edfsignal].physdimension);
+
+  return 0;
+}
+
+
+int edf_set_physical_maximum(int handle, int edfsignal, double phys_max)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(edfsignal<0)
+  {
+    return -1;
+  }
+
+  if(edfsignal>=hdrlist[handle]->edfsignals)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  hdrlist[handle]->edfparam[edfsignal].phys_max = phys_max;
+
+  return 0;
+}
+
+
+int edf_set_physical_minimum(int handle, int edfsignal, double phys_min)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(edfsignal<0)
+  {
+    return -1;
+  }
+
+  if(edfsignal>=hdrlist[handle]->edfsignals)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  hdrlist[handle]->edfparam[edfsignal].phys_min = phys_min;
+
+  return 0;
+}
+
+
+int edf_set_digital_maximum(int handle, int edfsignal, int dig_max)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(edfsignal<0)
+  {
+    return -1;
+  }
+
+  if(edfsignal>=hdrlist[handle]->edfsignals)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->edf)
+  {
+    if(dig_max > 32767)
+    {
+      return -1;
+    }
+  }
+  else
+  {
+    if(dig_max > 8388607)
+    {
+      return -1;
+    }
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  hdrlist[handle]->edfparam[edfsignal].dig_max = dig_max;
+
+  return 0;
+}
+
+
+int edf_set_digital_minimum(int handle, int edfsignal, int dig_min)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(edfsignal<0)
+  {
+    return -1;
+  }
+
+  if(edfsignal>=hdrlist[handle]->edfsignals)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->edf)
+  {
+    if(dig_min < (-32768))
+    {
+      return -1;
+    }
+  }
+  else
+  {
+    if(dig_min < (-8388608))
+    {
+      return -1;
+    }
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  hdrlist[handle]->edfparam[edfsignal].dig_min = dig_min;
+
+  return 0;
+}
+
+
+int edf_set_patientname(int handle, const char *patientname)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  strncpy(hdrlist[handle]->plus_patient_name, patientname, 80);
+
+  hdrlist[handle]->plus_patient_name[80] = 0;
+
+  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_patient_name);
+
+  return 0;
+}
+
+
+int edf_set_patientcode(int handle, const char *patientcode)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  strncpy(hdrlist[handle]->plus_patientcode, patientcode, 80);
+
+  hdrlist[handle]->plus_patientcode[80] = 0;
+
+  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_patientcode);
+
+  return 0;
+}
+
+
+int edf_set_gender(int handle, int gender)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  if((gender<0)||(gender>1))
+  {
+    return -1;
+  }
+
+  if(gender)
+  {
+    hdrlist[handle]->plus_gender[0] = 'M';
+  }
+  else
+  {
+    hdrlist[handle]->plus_gender[0] = 'F';
+  }
+
+  hdrlist[handle]->plus_gender[1] = 0;
+
+  return 0;
+}
+
+
+int edf_set_birthdate(int handle, int birthdate_year, int birthdate_month, int birthdate_day)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  if((birthdate_year<1800) || (birthdate_year>3000) ||
+     (birthdate_month<1)   || (birthdate_month>12)  ||
+     (birthdate_day<1)     || (birthdate_day>31))
+  {
+    return -1;
+  }
+
+  sprintf(hdrlist[handle]->plus_birthdate, "%02i.%02i.%02i%02i", birthdate_day, birthdate_month, birthdate_year / 100, birthdate_year % 100);
+
+  hdrlist[handle]->plus_birthdate[10] = 0;
+
+  return 0;
+}
+
+
+int edf_set_patient_additional(int handle, const char *patient_additional)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  strncpy(hdrlist[handle]->plus_patient_additional, patient_additional, 80);
+
+  hdrlist[handle]->plus_patient_additional[80] = 0;
+
+  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_patient_additional);
+
+  return 0;
+}
+
+
+int edf_set_admincode(int handle, const char *admincode)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  strncpy(hdrlist[handle]->plus_admincode, admincode, 80);
+
+  hdrlist[handle]->plus_admincode[80] = 0;
+
+  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_admincode);
+
+  return 0;
+}
+
+
+int edf_set_technician(int handle, const char *technician)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  strncpy(hdrlist[handle]->plus_technician, technician, 80);
+
+  hdrlist[handle]->plus_technician[80] = 0;
+
+  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_technician);
+
+  return 0;
+}
+
+
+int edf_set_equipment(int handle, const char *equipment)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  strncpy(hdrlist[handle]->plus_equipment, equipment, 80);
+
+  hdrlist[handle]->plus_equipment[80] = 0;
+
+  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_equipment);
+
+  return 0;
+}
+
+
+int edf_set_recording_additional(int handle, const char *recording_additional)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  strncpy(hdrlist[handle]->plus_recording_additional, recording_additional, 80);
+
+  hdrlist[handle]->plus_recording_additional[80] = 0;
+
+  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_recording_additional);
+
+  return 0;
+}
+
+
+int edf_set_startdatetime(int handle, int startdate_year, int startdate_month, int startdate_day,
+                                      int starttime_hour, int starttime_minute, int starttime_second)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  if((startdate_year<1985) || (startdate_year>2084) ||
+     (startdate_month<1)   || (startdate_month>12)  ||
+     (startdate_day<1)     || (startdate_day>31)    ||
+     (starttime_hour<0)    || (starttime_hour>23)   ||
+     (starttime_minute<0)  || (starttime_minute>59) ||
+     (starttime_second<0)  || (starttime_second>59))
+  {
+    return -1;
+  }
+
+  hdrlist[handle]->startdate_year = startdate_year;
+  hdrlist[handle]->startdate_month = startdate_month;
+  hdrlist[handle]->startdate_day = startdate_day;
+  hdrlist[handle]->starttime_hour = starttime_hour;
+  hdrlist[handle]->starttime_minute = starttime_minute;
+  hdrlist[handle]->starttime_second = starttime_second;
+
+  return 0;
+}
+
+
+int edfwrite_annotation_utf8(int handle, long long onset, long long duration, const char *description)
+{
+  int i;
+
+  struct edf_write_annotationblock *list_annot, *malloc_list;
+
+
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(onset<0LL)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->annots_in_file >= hdrlist[handle]->annotlist_sz)
+  {
+    malloc_list = (struct edf_write_annotationblock *)realloc(write_annotationslist[handle],
+                                                              sizeof(struct edf_write_annotationblock) * (hdrlist[handle]->annotlist_sz + EDFLIB_ANNOT_MEMBLOCKSZ));
+    if(malloc_list==NULL)
+    {
+      return -1;
+    }
+
+    write_annotationslist[handle] = malloc_list;
+
+    hdrlist[handle]->annotlist_sz += EDFLIB_ANNOT_MEMBLOCKSZ;
+  }
+
+  list_annot = write_annotationslist[handle] + hdrlist[handle]->annots_in_file;
+
+  list_annot->onset = onset;
+  list_annot->duration = duration;
+  strncpy(list_annot->annotation, description, EDFLIB_WRITE_MAX_ANNOTATION_LEN);
+  list_annot->annotation[EDFLIB_WRITE_MAX_ANNOTATION_LEN] = 0;
+
+  for(i=0; ; i++)
+  {
+    if(list_annot->annotation[i] == 0)
+    {
+      break;
+    }
+
+    if(((unsigned char *)(list_annot->annotation))[i] < 32)
+    {
+      list_annot->annotation[i] = '.';
+    }
+  }
+
+  hdrlist[handle]->annots_in_file++;
+
+  return 0;
+}
+
+
+int edfwrite_annotation_latin1(int handle, long long onset, long long duration, const char *description)
+{
+  struct edf_write_annotationblock *list_annot, *malloc_list;
+
+  char str[EDFLIB_WRITE_MAX_ANNOTATION_LEN + 1];
+
+
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(onset<0LL)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->annots_in_file >= hdrlist[handle]->annotlist_sz)
+  {
+    malloc_list = (struct edf_write_annotationblock *)realloc(write_annotationslist[handle],
+                                                              sizeof(struct edf_write_annotationblock) * (hdrlist[handle]->annotlist_sz + EDFLIB_ANNOT_MEMBLOCKSZ));
+    if(malloc_list==NULL)
+    {
+      return -1;
+    }
+
+    write_annotationslist[handle] = malloc_list;
+
+    hdrlist[handle]->annotlist_sz += EDFLIB_ANNOT_MEMBLOCKSZ;
+  }
+
+  list_annot = write_annotationslist[handle] + hdrlist[handle]->annots_in_file;
+
+  list_annot->onset = onset;
+  list_annot->duration = duration;
+  strncpy(str, description, EDFLIB_WRITE_MAX_ANNOTATION_LEN);
+  str[EDFLIB_WRITE_MAX_ANNOTATION_LEN] = 0;
+  edflib_latin12utf8(str, strlen(str));
+  strncpy(list_annot->annotation, str, EDFLIB_WRITE_MAX_ANNOTATION_LEN);
+  list_annot->annotation[EDFLIB_WRITE_MAX_ANNOTATION_LEN] = 0;
+
+  hdrlist[handle]->annots_in_file++;
+
+  return 0;
+}
+
+
+static void edflib_remove_padding_trailing_spaces(char *str)
+{
+  int i;
+
+  while(str[0]==' ')
+  {
+    for(i=0; ; i++)
+    {
+      if(str[i]==0)
+      {
+        break;
+      }
+
+      str[i] = str[i+1];
+    }
+  }
+
+  for(i = strlen(str); i>0; i--)
+  {
+    if(str[i-1]==' ')
+    {
+      str[i-1] = 0;
+    }
+    else
+    {
+      break;
+    }
+  }
+}
+
+
+int edf_set_prefilter(int handle, int edfsignal, const char *prefilter)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(edfsignal<0)
+  {
+    return -1;
+  }
+
+  if(edfsignal>=hdrlist[handle]->edfsignals)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  strncpy(hdrlist[handle]->edfparam[edfsignal].prefilter, prefilter, 80);
+
+  hdrlist[handle]->edfparam[edfsignal].prefilter[80] = 0;
+
+  edflib_remove_padding_trailing_spaces(hdrlist[handle]->edfparam[edfsignal].prefilter);
+
+  return 0;
+}
+
+
+int edf_set_transducer(int handle, int edfsignal, const char *transducer)
+{
+  if(handle<0)
+  {
+    return -1;
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
+  }
+
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+  if(edfsignal<0)
+  {
+    return -1;
+  }
+
+  if(edfsignal>=hdrlist[handle]->edfsignals)
+  {
+    return -1;
+  }
+
+  if(hdrlist[handle]->datarecords)
+  {
+    return -1;
+  }
+
+  strncpy(hdrlist[handle]->edfparam[edfsignal].transducer, transducer, 80);
+
+  hdrlist[handle]->edfparam[edfsignal].transducer[80] = 0;
+
+  edflib_remove_padding_trailing_spaces(hdrlist[handle]->edfparam[edfsignal].transducer);
+
+  return 0;
+}
+
+
+/* minimum is the minimum digits that will be printed (minus sign not included), leading zero's will be added if necessary */
+/* if sign is zero, only negative numbers will have the sign '-' character */
+/* if sign is one, the sign '+' or '-' character will always be printed */
+/* returns the amount of characters printed */
+static int edflib_fprint_int_number_nonlocalized(FILE *file, int q, int minimum, int sign)
+{
+  int flag=0, z, i, j=0, base = 1000000000;
+
+  if(minimum < 0)
+  {
+    minimum = 0;
+  }
+
+  if(minimum > 9)
+  {
+    flag = 1;
+  }
+
+  if(q < 0)
+  {
+    fputc('-', file);
+
+    j++;
+
+    base = -base;
+  }
+  else
+  {
+    if(sign)
+    {
+      fputc('+', file);
+
+      j++;
+    }
+  }
+
+  for(i=10; i; i--)
+  {
+    if(minimum == i)
+    {
+      flag = 1;
+    }
+
+    z = q / base;
+
+    q %= base;
+
+    if(z || flag)
+    {
+      fputc('0' + z, file);
+
+      j++;
+
+      flag = 1;
+    }
+
+    base /= 10;
+  }
+
+  if(!flag)
+  {
+    fputc('0', file);
+
+    j++;
+  }
+
+  return j;
+}
+
+
+/* minimum is the minimum digits that will be printed (minus sign not included), leading zero's will be added if necessary */
+/* if sign is zero, only negative numbers will have the sign '-' character */
+/* if sign is one, the sign '+' or '-' character will always be printed */
+/* returns the amount of characters printed */
+static int edflib_fprint_ll_number_nonlocalized(FILE *file, long long q, int minimum, int sign)
+{
+  int flag=0, z, i, j=0;
+
+  long long base = 1000000000000000000LL;
+
+  if(minimum < 0)
+  {
+    minimum = 0;
+  }
+
+  if(minimum > 18)
+  {
+    flag = 1;
+  }
+
+  if(q < 0LL)
+  {
+    fputc('-', file);
+
+    j++;
+
+    base = -base;
+  }
+  else
+  {
+    if(sign)
+    {
+      fputc('+', file);
+
+      j++;
+    }
+  }
+
+  for(i=19; i; i--)
+  {
+    if(minimum == i)
+    {
+      flag = 1;
+    }
+
+    z = q / base;
+
+    q %= base;
+
+    if(z || flag)
+    {
+      fputc('0' + z, file);
+
+      j++;
+
+      flag = 1;
+    }
+
+    base /= 10LL;
+  }
+
+  if(!flag)
+  {
+    fputc('0', file);
+
+    j++;
+  }
+
+  return j;
+}
+
+
+/* minimum is the minimum digits that will be printed (minus sign not included), leading zero's will be added if necessary */
+/* if sign is zero, only negative numbers will have the sign '-' character */
+/* if sign is one, the sign '+' or '-' character will always be printed */
+/* returns the amount of characters printed */
+/*
+static int edflib_sprint_int_number_nonlocalized(char *str, int q, int minimum, int sign)
+{
+  int flag=0, z, i, j=0, base = 1000000000;
+
+  if(minimum < 0)
+  {
+    minimum = 0;
+  }
+
+  if(minimum > 9)
+  {
+    flag = 1;
+  }
+
+  if(q < 0)
+  {
+    str[j++] = '-';
+
+    q = -q;
+  }
+  else
+  {
+    if(sign)
+    {
+      str[j++] = '+';
     }
   }
-  for(i=0; i<edfsignals; i++)
+
+  for(i=10; i; i--)
   {
-    len = strlen(hdr->edfparam[i].prefilter);
-    edflib_latin1_to_ascii(hdr->edfparam[i].prefilter, len);
-    for(j=0; j<len; j++)
+    if(minimum == i)
     {
-      fputc(hdr->edfparam[i].prefilter[j], file);
+      flag = 1;
     }
-    for(; j<80; j++)
+
+    z = q / base;
+
+    q %= base;
+
+    if(z || flag)
     {
-      fputc(' ', file);
+      str[j++] = '0' + z;
+
+      flag = 1;
     }
+
+    base /= 10;
   }
-  for(i=0; i<hdr->nr_annot_chns; i++)
+
+  if(!flag)
   {
-    for(j=0; j<80; j++)
-    {
-      fputc(' ', file);
-    }
+    str[j++] = '0';
   }
-  for(i=0; i<edfsignals; i++)
+
+  str[j] = 0;
+
+  return j;
+}
+*/
+
+/* minimum is the minimum digits that will be printed (minus sign not included), leading zero's will be added if necessary */
+/* if sign is zero, only negative numbers will have the sign '-' character */
+/* if sign is one, the sign '+' or '-' character will always be printed */
+/* returns the amount of characters printed */
+static int edflib_snprint_ll_number_nonlocalized(char *dest, long long q, int minimum, int sign, int sz)
+{
+  int flag=0, z, i, j=0;
+
+  long long base = 1000000000000000000LL;
+
+  if(sz < 1)
   {
-    p = edflib_fprint_int_number_nonlocalized(file, hdr->edfparam[i].smp_per_record, 0, 0);
-    for(; p<8; p++)
+    return 0;
+  }
+
+  if(minimum < 0)
+  {
+    minimum = 0;
+  }
+
+  if(minimum > 18)
+  {
+    flag = 1;
+  }
+
+  if(q < 0LL)
+  {
+    dest[j++] = '-';
+
+    base = -base;
+  }
+  else
+  {
+    if(sign)
     {
-      fputc(' ', file);
+      dest[j++] = '+';
     }
   }
-  for(j=0; j<hdr->nr_annot_chns; j++)
+
+  if(j == sz)
   {
-    if(hdr->edf)
+    dest[--j] = 0;
+
+    return j;
+  }
+
+  for(i=19; i; i--)
+  {
+    if(minimum == i)
     {
-      p = edflib_fprint_int_number_nonlocalized(file, EDFLIB_ANNOTATION_BYTES / 2, 0, 0);
-      for(; p<8; p++)
-      {
-        fputc(' ', file);
-      }
+      flag = 1;
     }
-    else
+
+    z = q / base;
+
+    q %= base;
+
+    if(z || flag)
     {
-      p = edflib_fprint_int_number_nonlocalized(file, EDFLIB_ANNOTATION_BYTES / 3, 0, 0);
-      for(; p<8; p++)
+      dest[j++] = '0' + z;
+
+      if(j == sz)
       {
-        fputc(' ', file);
+        dest[--j] = 0;
+
+        return j;
       }
+
+      flag = 1;
     }
+
+    base /= 10LL;
   }
-  for(i=0; i<(edfsignals * 32); i++)
+
+  if(!flag)
   {
-    fputc(' ', file);
+    dest[j++] = '0';
   }
-  for(i=0; i<(hdr->nr_annot_chns * 32); i++)
+
+  if(j == sz)
   {
-    fputc(' ', file);
+    dest[--j] = 0;
+
+    return j;
   }
 
-  return 0;
+  dest[j] = 0;
+
+  return j;
 }
 
 
-int edf_set_label(int handle, int edfsignal, const char *label)
+static int edflib_snprint_number_nonlocalized(char *dest, double val, int sz)
 {
-  if(handle<0)
-  {
-    return -1;
-  }
+  int flag=0, z, i, j=0, q, base = 1000000000;
 
-  if(handle>=EDFLIB_MAXFILES)
-  {
-    return -1;
-  }
+  double var;
 
-  if(hdrlist[handle]==NULL)
-  {
-    return -1;
-  }
+  if(sz < 1)  return 0;
 
-  if(!(hdrlist[handle]->writemode))
-  {
-    return -1;
-  }
+  q = (int)val;
 
-  if(edfsignal<0)
+  var = val - q;
+
+  if(val < 0.0)
   {
-    return -1;
+    dest[j++] = '-';
+
+    if(q < 0)
+    {
+      base = -base;
+    }
   }
 
-  if(edfsignal>=hdrlist[handle]->edfsignals)
+  if(j == sz)
   {
-    return -1;
+    dest[--j] = 0;
+
+    return j;
   }
 
-  if(hdrlist[handle]->datarecords)
+  for(i=10; i; i--)
   {
-    return -1;
-  }
+    z = q / base;
 
-  strncpy(hdrlist[handle]->edfparam[edfsignal].label, label, 16);
+    q %= base;
 
-  hdrlist[handle]->edfparam[edfsignal].label[16] = 0;
+    if(z || flag)
+    {
+      dest[j++] = '0' + z;
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->edfparam[edfsignal].label);
+      if(j == sz)
+      {
+        dest[--j] = 0;
 
-  return 0;
-}
+        return j;
+      }
 
+      flag = 1;
+    }
 
-int edf_set_physical_dimension(int handle, int edfsignal, const char *phys_dim)
-{
-  if(handle<0)
-  {
-    return -1;
+    base /= 10;
   }
 
-  if(handle>=EDFLIB_MAXFILES)
+  if(!flag)
   {
-    return -1;
+    dest[j++] = '0';
   }
 
-  if(hdrlist[handle]==NULL)
+  if(j == sz)
   {
-    return -1;
+    dest[--j] = 0;
+
+    return j;
   }
 
-  if(!(hdrlist[handle]->writemode))
+  base = 100000000;
+
+  var *= (base * 10);
+
+  q = (int)var;
+
+  if(q < 0)
   {
-    return -1;
+    base = -base;
   }
 
-  if(edfsignal<0)
+  if(!q)
   {
-    return -1;
+    dest[j] = 0;
+
+    return j;
   }
 
-  if(edfsignal>=hdrlist[handle]->edfsignals)
+  dest[j++] = '.';
+
+  if(j == sz)
   {
-    return -1;
+    dest[--j] = 0;
+
+    return j;
   }
 
-  if(hdrlist[handle]->datarecords)
+  for(i=9; i; i--)
   {
-    return -1;
+    z = q / base;
+
+    q %= base;
+
+    dest[j++] = '0' + z;
+
+    if(j == sz)
+    {
+      dest[--j] = 0;
+
+      return j;
+    }
+
+    base /= 10;
   }
 
-  strncpy(hdrlist[handle]->edfparam[edfsignal].physdimension, phys_dim, 8);
+  dest[j] = 0;
 
-  hdrlist[handle]->edfparam[edfsignal].physdimension[8] = 0;
+  j--;
+
+  for(; j>0; j--)
+  {
+    if(dest[j] == '0')
+    {
+      dest[j] = 0;
+    }
+    else
+    {
+      j++;
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->edfparam[edfsignal].physdimension);
+      break;
+    }
+  }
 
-  return 0;
+  return j;
 }
 
 
-int edf_set_physical_maximum(int handle, int edfsignal, double phys_max)
+static double edflib_atof_nonlocalized(const char *str)
 {
-  if(handle<0)
-  {
-    return -1;
-  }
+  int i=0, j, dot_pos=-1, decimals=0, sign=1, exp_pos=-1, exp_sign=1, exp_val=0;
 
-  if(handle>=EDFLIB_MAXFILES)
-  {
-    return -1;
-  }
+  double value, value2=0.0;
 
-  if(hdrlist[handle]==NULL)
-  {
-    return -1;
-  }
 
-  if(!(hdrlist[handle]->writemode))
-  {
-    return -1;
-  }
+  value = edflib_atoi_nonlocalized(str);
 
-  if(edfsignal<0)
+  while(str[i] == ' ')
   {
-    return -1;
+    i++;
   }
 
-  if(edfsignal>=hdrlist[handle]->edfsignals)
+  if((str[i] == '+') || (str[i] == '-'))
   {
-    return -1;
+    if(str[i] == '-')
+    {
+      sign = -1;
+    }
+
+    i++;
   }
 
-  if(hdrlist[handle]->datarecords)
+  for(; ; i++)
   {
-    return -1;
-  }
+    if(str[i] == 0)
+    {
+      break;
+    }
 
-  hdrlist[handle]->edfparam[edfsignal].phys_max = phys_max;
+    if((str[i] == 'e') || (str[i] == 'E'))
+    {
+      exp_pos = i;
 
-  return 0;
-}
+      break;
+    }
+
+    if(((str[i] < '0') || (str[i] > '9')) && (str[i] != '.'))
+    {
+      break;
+    }
 
+    if(dot_pos >= 0)
+    {
+      if((str[i] >= '0') && (str[i] <= '9'))
+      {
+        decimals++;
+      }
+      else
+      {
+        break;
+      }
+    }
 
-int edf_set_physical_minimum(int handle, int edfsignal, double phys_min)
-{
-  if(handle<0)
-  {
-    return -1;
+    if(str[i] == '.')
+    {
+      if(dot_pos < 0)
+      {
+        dot_pos = i;
+      }
+    }
   }
 
-  if(handle>=EDFLIB_MAXFILES)
+  if(decimals)
   {
-    return -1;
-  }
+    value2 = edflib_atoi_nonlocalized(str + dot_pos + 1) * sign;
 
-  if(hdrlist[handle]==NULL)
-  {
-    return -1;
-  }
+    i = 1;
 
-  if(!(hdrlist[handle]->writemode))
-  {
-    return -1;
-  }
+    while(decimals--)
+    {
+      i *= 10;
+    }
 
-  if(edfsignal<0)
-  {
-    return -1;
-  }
+    value2 /= i;
 
-  if(edfsignal>=hdrlist[handle]->edfsignals)
-  {
-    return -1;
+    value += value2;
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(exp_pos > 0)
   {
-    return -1;
-  }
+    i = exp_pos + 1;
 
-  hdrlist[handle]->edfparam[edfsignal].phys_min = phys_min;
+    if(str[i])
+    {
+      if(str[i] == '+')
+      {
+        i++;
+      }
+      else if(str[i] == '-')
+        {
+          exp_sign = -1;
 
-  return 0;
-}
+          i++;
+        }
 
+      if(str[i])
+      {
+        exp_val = edflib_atoi_nonlocalized(str + i);
 
-int edf_set_digital_maximum(int handle, int edfsignal, int dig_max)
-{
-  if(handle<0)
-  {
-    return -1;
+        if(exp_val > 0)
+        {
+          for(j=0; j<exp_val; j++)
+          {
+            if(exp_sign > 0)
+            {
+              value *= 10;
+            }
+            else
+            {
+              value /= 10;
+            }
+          }
+        }
+      }
+    }
   }
 
-  if(handle>=EDFLIB_MAXFILES)
-  {
-    return -1;
-  }
+  return value;
+}
 
-  if(hdrlist[handle]==NULL)
-  {
-    return -1;
-  }
 
-  if(!(hdrlist[handle]->writemode))
-  {
-    return -1;
-  }
+static int edflib_atoi_nonlocalized(const char *str)
+{
+  int i=0, value=0, sign=1;
 
-  if(edfsignal<0)
+  while(str[i] == ' ')
   {
-    return -1;
+    i++;
   }
 
-  if(edfsignal>=hdrlist[handle]->edfsignals)
+  if((str[i] == '+') || (str[i] == '-'))
   {
-    return -1;
+    if(str[i] == '-')
+    {
+      sign = -1;
+    }
+
+    i++;
   }
 
-  if(hdrlist[handle]->edf)
+  for( ; ; i++)
   {
-    if(dig_max > 32767)
+    if(str[i] == 0)
     {
-      return -1;
+      break;
     }
-  }
-  else
-  {
-    if(dig_max > 8388607)
+
+    if((str[i] < '0') || (str[i] > '9'))
     {
-      return -1;
+      break;
     }
-  }
 
-  if(hdrlist[handle]->datarecords)
-  {
-    return -1;
-  }
+    value *= 10;
 
-  hdrlist[handle]->edfparam[edfsignal].dig_max = dig_max;
+    value += ((str[i] - '0') * sign);
+  }
 
-  return 0;
+  return value;
 }
 
 
-int edf_set_digital_minimum(int handle, int edfsignal, int dig_min)
+static int edflib_write_tal(struct edfhdrblock *hdr, FILE *file)
 {
-  if(handle<0)
-  {
-    return -1;
-  }
+  int err=0;
 
-  if(handle>=EDFLIB_MAXFILES)
-  {
-    return -1;
-  }
+  long long t[2];
 
-  if(hdrlist[handle]==NULL)
-  {
-    return -1;
-  }
+  const char *tal;
 
-  if(!(hdrlist[handle]->writemode))
-  {
-    return -1;
-  }
+  char str[EDFLIB_ANNOTATION_BYTES * (EDFLIB_MAX_ANNOTATION_CHANNELS + 1)];
 
-  if(edfsignal<0)
-  {
-    return -1;
-  }
+  edflib_stats_start(hdr, t);
 
-  if(edfsignal>=hdrlist[handle]->edfsignals)
-  {
-    return -1;
-  }
+  tal = edflib_next_tal(hdr, hdr->datarecords);
 
-  if(hdrlist[handle]->edf)
-  {
-    if(dig_min < (-32768))
-    {
-      return -1;
-    }
-  }
-  else
+  /* in stream mode the annotations are stored in the next datarecord that is written, */
+  /* the template must stay empty so they are added to a copy */
+  if(hdr->stream && (hdr->annots_streamed < hdr->annots_in_file))
   {
-    if(dig_min < (-8388608))
-    {
-      return -1;
-    }
+    memcpy(str, tal, hdr->total_annot_bytes);
+
+    edflib_stream_annotations(hdr, str);
+
+    tal = str;
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(fwrite(tal, hdr->total_annot_bytes, 1, file) != 1)
   {
-    return -1;
+    err = -1;
   }
 
-  hdrlist[handle]->edfparam[edfsignal].dig_min = dig_min;
+  edflib_stats_stop(hdr, t, EDFLIB_STATS_TAL, hdr->datarecords);
 
-  return 0;
+  return err;
 }
 
 
-int edf_set_patientname(int handle, const char *patientname)
+/* stores the time-keeping annotation of a datarecord in str, */
+/* str must be able to hold hdr->total_annot_bytes bytes, returns hdr->total_annot_bytes */
+static int edflib_render_tal(struct edfhdrblock *hdr, long long datarecord, char *str)
 {
-  if(handle<0)
-  {
-    return -1;
-  }
+  edflib_format_tal(hdr, datarecord, str);
 
-  if(handle>=EDFLIB_MAXFILES)
+  /* in stream mode the annotations are stored in the next datarecord that is written, */
+  /* one per annotation signal, the same layout as edfclose_file() uses */
+  if(hdr->stream && (datarecord == hdr->datarecords))
   {
-    return -1;
+    edflib_stream_annotations(hdr, str);
   }
 
-  if(hdrlist[handle]==NULL)
-  {
-    return -1;
-  }
+  return hdr->total_annot_bytes;
+}
 
-  if(!(hdrlist[handle]->writemode))
+
+/* stores the time-keeping annotation of a datarecord in str, without annotations, */
+/* returns the length of the onset */
+static int edflib_format_tal(struct edfhdrblock *hdr, long long datarecord, char *str)
+{
+  int p, len;
+
+  p = edflib_snprint_ll_number_nonlocalized(str, (datarecord * hdr->long_data_record_duration + hdr->starttime_offset) / EDFLIB_TIME_DIMENSION, 0, 1, EDFLIB_ANNOTATION_BYTES * (EDFLIB_MAX_ANNOTATION_CHANNELS + 1));
+  if((hdr->long_data_record_duration % EDFLIB_TIME_DIMENSION) || (hdr->starttime_offset))
   {
-    return -1;
+    str[p++] = '.';
+    p += edflib_snprint_ll_number_nonlocalized(str + p, (datarecord * hdr->long_data_record_duration + hdr->starttime_offset) % EDFLIB_TIME_DIMENSION, 7, 0, (EDFLIB_ANNOTATION_BYTES * (EDFLIB_MAX_ANNOTATION_CHANNELS + 1)) - p);
   }
-
-  if(hdrlist[handle]->datarecords)
+  len = p;
+  str[p++] = 20;
+  str[p++] = 20;
+  for(; p<hdr->total_annot_bytes; p++)
   {
-    return -1;
+    str[p] = 0;
   }
 
-  strncpy(hdrlist[handle]->plus_patient_name, patientname, 80);
-
-  hdrlist[handle]->plus_patient_name[80] = 0;
-
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_patient_name);
-
-  return 0;
+  return len;
 }
 
 
-int edf_set_patientcode(int handle, const char *patientcode)
+/* Returns the time-keeping annotation of a datarecord, hdr->total_annot_bytes long, without annotations.
+ * The annotation is kept in hdr->tal, for the next datarecord the duration of a datarecord
+ * is added to the digits of the onset, the rest of the bytes stay as they are.
+ * Only when the onset needs an extra digit, it's formatted again.
+ * Not thread-safe, only for the sequential write functions.
+ */
+static const char * edflib_next_tal(struct edfhdrblock *hdr, long long datarecord)
 {
-  if(handle<0)
-  {
-    return -1;
-  }
+  int i, j, digit, carry=0;
 
-  if(handle>=EDFLIB_MAXFILES)
+  if(hdr->tal_len && (datarecord == hdr->tal_datarecord))
   {
-    return -1;
+    return hdr->tal;
   }
 
-  if(hdrlist[handle]==NULL)
+  if((!hdr->tal_len) || (datarecord != (hdr->tal_datarecord + 1LL)))
   {
-    return -1;
-  }
+    if(!hdr->tal_len)
+    {
+      /* the duration of a datarecord in the same format as the onset, without the sign */
+      hdr->tal_step_len = edflib_snprint_ll_number_nonlocalized(hdr->tal_step, hdr->long_data_record_duration / EDFLIB_TIME_DIMENSION, 0, 0, 48);
+      if((hdr->long_data_record_duration % EDFLIB_TIME_DIMENSION) || (hdr->starttime_offset))
+      {
+        hdr->tal_step[hdr->tal_step_len++] = '.';
+        hdr->tal_step_len += edflib_snprint_ll_number_nonlocalized(hdr->tal_step + hdr->tal_step_len, hdr->long_data_record_duration % EDFLIB_TIME_DIMENSION, 7, 0, 48 - hdr->tal_step_len);
+      }
+    }
 
-  if(!(hdrlist[handle]->writemode))
-  {
-    return -1;
+    hdr->tal_len = edflib_format_tal(hdr, datarecord, hdr->tal);
+
+    hdr->tal_datarecord = datarecord;
+
+    return hdr->tal;
   }
 
-  if(hdrlist[handle]->datarecords)
+  /* decimal addition, right aligned, the '.' of the onset and the step are at the same position */
+  for(i=hdr->tal_len-1, j=hdr->tal_step_len-1; (j>=0) || carry; i--, j--)
   {
-    return -1;
-  }
+    if(i < 1)  /* the onset needs an extra digit */
+    {
+      hdr->tal_len = edflib_format_tal(hdr, datarecord, hdr->tal);
 
-  strncpy(hdrlist[handle]->plus_patientcode, patientcode, 80);
+      hdr->tal_datarecord = datarecord;
 
-  hdrlist[handle]->plus_patientcode[80] = 0;
+      return hdr->tal;
+    }
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_patientcode);
+    if(hdr->tal[i] == '.')
+    {
+      continue;
+    }
 
-  return 0;
+    digit = hdr->tal[i] - '0' + carry;
+
+    if(j >= 0)
+    {
+      digit += hdr->tal_step[j] - '0';
+    }
+
+    carry = 0;
+
+    if(digit > 9)
+    {
+      digit -= 10;
+
+      carry = 1;
+    }
+
+    hdr->tal[i] = '0' + digit;
+  }
+
+  hdr->tal_datarecord = datarecord;
+
+  return hdr->tal;
 }
 
 
-int edf_set_gender(int handle, int gender)
+/* stores the annotations that have not been written yet in the annotation signals of a datarecord */
+static void edflib_stream_annotations(struct edfhdrblock *hdr, char *str)
 {
-  if(handle<0)
-  {
-    return -1;
-  }
+  int i, j, n, p;
 
-  if(handle>=EDFLIB_MAXFILES)
-  {
-    return -1;
-  }
+  char tmp[EDFLIB_ANNOTATION_BYTES * 2];
 
-  if(hdrlist[handle]==NULL)
+  for(j=0; (j<hdr->nr_annot_chns) && (hdr->annots_streamed<hdr->annots_in_file); j++)
   {
-    return -1;
-  }
+    p = 0;
 
-  if(!(hdrlist[handle]->writemode))
-  {
-    return -1;
-  }
+    if(j==0)  /* after the time-keeping annotation */
+    {
+      while(str[p])
+      {
+        p++;
+      }
 
-  if(hdrlist[handle]->datarecords)
-  {
-    return -1;
-  }
+      p++;
+    }
 
-  if((gender<0)||(gender>1))
-  {
-    return -1;
+    n = edflib_snprint_annotation(hdr, write_annotationslist[hdr->handle] + hdr->annots_streamed, tmp, EDFLIB_ANNOTATION_BYTES * 2);
+
+    for(i=0; (i<n) && (p<EDFLIB_ANNOTATION_BYTES); i++)
+    {
+      str[(j * EDFLIB_ANNOTATION_BYTES) + p++] = tmp[i];
+    }
+
+    hdr->annots_streamed++;
   }
+}
 
-  if(gender)
+
+/* prints an annotation (onset, duration and description) as a TAL in str, returns the number of bytes */
+static int edflib_snprint_annotation(struct edfhdrblock *hdr, struct edf_write_annotationblock *annot, char *str, int sz)
+{
+  int i, p;
+
+  long long onset;
+
+  onset = annot->onset + (hdr->starttime_offset / 1000LL);
+
+  p = edflib_snprint_ll_number_nonlocalized(str, onset / 10000LL, 0, 1, sz);
+  if(onset % 10000LL)
   {
-    hdrlist[handle]->plus_gender[0] = 'M';
+    str[p++] = '.';
+    p += edflib_snprint_ll_number_nonlocalized(str + p, onset % 10000LL, 4, 0, sz - p);
   }
-  else
+  if(annot->duration>=0LL)
   {
-    hdrlist[handle]->plus_gender[0] = 'F';
+    str[p++] = 21;
+    p += edflib_snprint_ll_number_nonlocalized(str + p, annot->duration / 10000LL, 0, 0, sz - p);
+    if(annot->duration % 10000LL)
+    {
+      str[p++] = '.';
+      p += edflib_snprint_ll_number_nonlocalized(str + p, annot->duration % 10000LL, 4, 0, sz - p);
+    }
   }
+  str[p++] = 20;
+  for(i=0; i<EDFLIB_WRITE_MAX_ANNOTATION_LEN; i++)
+  {
+    if(annot->annotation[i]==0)
+    {
+      break;
+    }
 
-  hdrlist[handle]->plus_gender[1] = 0;
+    str[p++] = annot->annotation[i];
+  }
+  str[p++] = 20;
 
-  return 0;
+  return p;
 }
 
 
-int edf_set_birthdate(int handle, int birthdate_year, int birthdate_month, int birthdate_day)
+int edf_write_header_for_datarecords(int handle, long long datarecords)
 {
+  int error;
+
+  long long filesize;
+
+  struct edfhdrblock *hdr;
+
+
   if(handle<0)
   {
     return -1;
@@ -6119,134 +8142,158 @@ int edf_set_birthdate(int handle, int birthdate_year, int birthdate_month, int b
     return -1;
   }
 
-  if((birthdate_year<1800) || (birthdate_year>3000) ||
-     (birthdate_month<1)   || (birthdate_month>12)  ||
-     (birthdate_day<1)     || (birthdate_day>31))
+  if(hdrlist[handle]->signal_write_sequence_pos)
   {
     return -1;
   }
 
-  sprintf(hdrlist[handle]->plus_birthdate, "%02i.%02i.%02i%02i", birthdate_day, birthdate_month, birthdate_year / 100, birthdate_year % 100);
-
-  hdrlist[handle]->plus_birthdate[10] = 0;
-
-  return 0;
-}
-
-
-int edf_set_patient_additional(int handle, const char *patient_additional)
-{
-  if(handle<0)
+  if(datarecords<1LL)
   {
     return -1;
   }
 
-  if(handle>=EDFLIB_MAXFILES)
+  hdr = hdrlist[handle];
+
+  error = edflib_write_edf_header(hdr);
+
+  if(error)
   {
-    return -1;
+    return error;
   }
 
-  if(hdrlist[handle]==NULL)
+  if(fflush(hdr->file_hdl))
   {
     return -1;
   }
 
-  if(!(hdrlist[handle]->writemode))
+  filesize = ((long long)(hdr->edfsignals + hdr->nr_annot_chns + 1) * 256LL) + (datarecords * hdr->recordsize);
+
+#ifdef _WIN32
+  (void)filesize;
+
+  return -1;
+#else
+  if(ftruncate(fileno(hdr->file_hdl), filesize))
   {
     return -1;
   }
+#endif
 
-  if(hdrlist[handle]->datarecords)
+  /* the next sample write action appends a datarecord after the reserved ones */
+  if(fseeko(hdr->file_hdl, filesize, SEEK_SET))
   {
     return -1;
   }
 
-  strncpy(hdrlist[handle]->plus_patient_additional, patient_additional, 80);
-
-  hdrlist[handle]->plus_patient_additional[80] = 0;
-
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_patient_additional);
+  hdr->datarecords = datarecords;
 
   return 0;
 }
 
 
-int edf_set_admincode(int handle, const char *admincode)
+int edf_map_datarecords(int handle, long long datarecords)
 {
-  if(handle<0)
-  {
-    return -1;
-  }
+  int error;
 
-  if(handle>=EDFLIB_MAXFILES)
+  long long filesize;
+
+  struct edfhdrblock *hdr;
+
+
+  error = edf_write_header_for_datarecords(handle, datarecords);
+
+  if(error)
   {
-    return -1;
+    return error;
   }
 
-  if(hdrlist[handle]==NULL)
+  hdr = hdrlist[handle];
+
+  filesize = ((long long)(hdr->edfsignals + hdr->nr_annot_chns + 1) * 256LL) + (datarecords * hdr->recordsize);
+
+#ifdef _WIN32
+  (void)filesize;
+
+  return -1;
+#else
+  if((unsigned long long)filesize > (unsigned long long)((size_t)-1))
   {
     return -1;
   }
 
-  if(!(hdrlist[handle]->writemode))
+  /* Allocate the blocks now, a full disk while writing into the mapping would be a SIGBUS. */
+  /* Filesystems that can't preallocate keep the sparse file of edf_write_header_for_datarecords(). */
+  error = posix_fallocate(fileno(hdr->file_hdl), 0, filesize);
+
+  if(error && (error != EINVAL) && (error != EOPNOTSUPP))
   {
     return -1;
   }
 
-  if(hdrlist[handle]->datarecords)
+  hdr->map = mmap(NULL, filesize, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(hdr->file_hdl), 0);
+
+  if(hdr->map == MAP_FAILED)
   {
+    hdr->map = NULL;
+
     return -1;
   }
 
-  strncpy(hdrlist[handle]->plus_admincode, admincode, 80);
-
-  hdrlist[handle]->plus_admincode[80] = 0;
+  hdr->map_sz = filesize;
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_admincode);
+  madvise(hdr->map, filesize, MADV_SEQUENTIAL);
 
   return 0;
+#endif
 }
 
 
-int edf_set_technician(int handle, const char *technician)
+void * edf_get_datarecord_ptr(int handle, long long datarecord)
 {
+  struct edfhdrblock *hdr;
+
+
   if(handle<0)
   {
-    return -1;
+    return NULL;
   }
 
   if(handle>=EDFLIB_MAXFILES)
   {
-    return -1;
+    return NULL;
   }
 
   if(hdrlist[handle]==NULL)
   {
-    return -1;
+    return NULL;
   }
 
-  if(!(hdrlist[handle]->writemode))
+  hdr = hdrlist[handle];
+
+  if(hdr->map == NULL)
   {
-    return -1;
+    return NULL;
   }
 
-  if(hdrlist[handle]->datarecords)
+  if((datarecord<0LL) || (datarecord >= hdr->datarecords))
   {
-    return -1;
+    return NULL;
   }
 
-  strncpy(hdrlist[handle]->plus_technician, technician, 80);
+  return hdr->map + ((long long)(hdr->edfsignals + hdr->nr_annot_chns + 1) * 256LL) + (datarecord * hdr->recordsize);
+}
 
-  hdrlist[handle]->plus_technician[80] = 0;
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_technician);
+int edf_msync_datarecords(int handle, long long datarecord, long long n, int wait)
+{
+#ifndef _WIN32
+  long long start,
+            end,
+            pagesize;
 
-  return 0;
-}
+  struct edfhdrblock *hdr;
 
 
-int edf_set_equipment(int handle, const char *equipment)
-{
   if(handle<0)
   {
     return -1;
@@ -6262,65 +8309,84 @@ int edf_set_equipment(int handle, const char *equipment)
     return -1;
   }
 
-  if(!(hdrlist[handle]->writemode))
+  hdr = hdrlist[handle];
+
+  if(hdr->map == NULL)
   {
     return -1;
   }
 
-  if(hdrlist[handle]->datarecords)
+  if((datarecord<0LL) || (n<1LL) || ((datarecord + n) > hdr->datarecords))
   {
     return -1;
   }
 
-  strncpy(hdrlist[handle]->plus_equipment, equipment, 80);
+  pagesize = sysconf(_SC_PAGESIZE);
 
-  hdrlist[handle]->plus_equipment[80] = 0;
+  start = ((long long)(hdr->edfsignals + hdr->nr_annot_chns + 1) * 256LL) + (datarecord * hdr->recordsize);
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_equipment);
+  end = start + (n * hdr->recordsize);
+
+  /* msync() and madvise() need a page aligned address */
+  start -= start % pagesize;
+
+  if(msync(hdr->map + start, end - start, wait ? MS_SYNC : MS_ASYNC))
+  {
+    return -1;
+  }
+
+  /* the dirty pages stay in the page cache, only the mapping of the pages is released */
+  madvise(hdr->map + start, end - start, MADV_DONTNEED);
 
   return 0;
+#else
+  (void)handle;
+  (void)datarecord;
+  (void)n;
+  (void)wait;
+
+  return -1;
+#endif
 }
 
 
-int edf_set_recording_additional(int handle, const char *recording_additional)
+long long edf_get_datarecord_offset(int handle, long long datarecord)
 {
+  struct edfhdrblock *hdr;
+
+
   if(handle<0)
   {
-    return -1;
+    return -1LL;
   }
 
   if(handle>=EDFLIB_MAXFILES)
   {
-    return -1;
+    return -1LL;
   }
 
   if(hdrlist[handle]==NULL)
   {
-    return -1;
+    return -1LL;
   }
 
-  if(!(hdrlist[handle]->writemode))
+  hdr = hdrlist[handle];
+
+  if(!(hdr->writemode))
   {
-    return -1;
+    return -1LL;
   }
 
-  if(hdrlist[handle]->datarecords)
+  if((datarecord<0LL) || (datarecord >= hdr->datarecords))
   {
-    return -1;
+    return -1LL;
   }
 
-  strncpy(hdrlist[handle]->plus_recording_additional, recording_additional, 80);
-
-  hdrlist[handle]->plus_recording_additional[80] = 0;
-
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_recording_additional);
-
-  return 0;
+  return ((long long)(hdr->edfsignals + hdr->nr_annot_chns + 1) * 256LL) + (datarecord * hdr->recordsize);
 }
 
 
-int edf_set_startdatetime(int handle, int startdate_year, int startdate_month, int startdate_day,
-                                      int starttime_hour, int starttime_minute, int starttime_second)
+int edf_get_file_descriptor(int handle)
 {
   if(handle<0)
   {
@@ -6342,39 +8408,16 @@ int edf_set_startdatetime(int handle, int startdate_year, int startdate_month, i
     return -1;
   }
 
-  if(hdrlist[handle]->datarecords)
-  {
-    return -1;
-  }
-
-  if((startdate_year<1985) || (startdate_year>2084) ||
-     (startdate_month<1)   || (startdate_month>12)  ||
-     (startdate_day<1)     || (startdate_day>31)    ||
-     (starttime_hour<0)    || (starttime_hour>23)   ||
-     (starttime_minute<0)  || (starttime_minute>59) ||
-     (starttime_second<0)  || (starttime_second>59))
-  {
-    return -1;
-  }
-
-  hdrlist[handle]->startdate_year = startdate_year;
-  hdrlist[handle]->startdate_month = startdate_month;
-  hdrlist[handle]->startdate_day = startdate_day;
-  hdrlist[handle]->starttime_hour = starttime_hour;
-  hdrlist[handle]->starttime_minute = starttime_minute;
-  hdrlist[handle]->starttime_second = starttime_second;
-
-  return 0;
+#ifdef _WIN32
+  return -1;
+#else
+  return fileno(hdrlist[handle]->file_hdl);
+#endif
 }
 
 
-int edfwrite_annotation_utf8(int handle, long long onset, long long duration, const char *description)
+int edf_set_stream_mode(int handle, long long datarecords)
 {
-  int i;
-
-  struct edf_write_annotationblock *list_annot, *malloc_list;
-
-
   if(handle<0)
   {
     return -1;
@@ -6395,56 +8438,34 @@ int edfwrite_annotation_utf8(int handle, long long onset, long long duration, co
     return -1;
   }
 
-  if(onset<0LL)
+  if(hdrlist[handle]->datarecords)
   {
     return -1;
   }
 
-  if(hdrlist[handle]->annots_in_file >= hdrlist[handle]->annotlist_sz)
+  if(hdrlist[handle]->signal_write_sequence_pos)
   {
-    malloc_list = (struct edf_write_annotationblock *)realloc(write_annotationslist[handle],
-                                                              sizeof(struct edf_write_annotationblock) * (hdrlist[handle]->annotlist_sz + EDFLIB_ANNOT_MEMBLOCKSZ));
-    if(malloc_list==NULL)
-    {
-      return -1;
-    }
-
-    write_annotationslist[handle] = malloc_list;
-
-    hdrlist[handle]->annotlist_sz += EDFLIB_ANNOT_MEMBLOCKSZ;
+    return -1;
   }
 
-  list_annot = write_annotationslist[handle] + hdrlist[handle]->annots_in_file;
-
-  list_annot->onset = onset;
-  list_annot->duration = duration;
-  strncpy(list_annot->annotation, description, EDFLIB_WRITE_MAX_ANNOTATION_LEN);
-  list_annot->annotation[EDFLIB_WRITE_MAX_ANNOTATION_LEN] = 0;
-
-  for(i=0; ; i++)
+  if(datarecords<1LL)
   {
-    if(list_annot->annotation[i] == 0)
-    {
-      break;
-    }
-
-    if(((unsigned char *)(list_annot->annotation))[i] < 32)
-    {
-      list_annot->annotation[i] = '.';
-    }
+    return -1;
   }
 
-  hdrlist[handle]->annots_in_file++;
+  hdrlist[handle]->stream = 1;
+
+  hdrlist[handle]->stream_datarecords = datarecords;
 
   return 0;
 }
 
 
-int edfwrite_annotation_latin1(int handle, long long onset, long long duration, const char *description)
+int edf_write_header_only(int handle, long long datarecords)
 {
-  struct edf_write_annotationblock *list_annot, *malloc_list;
+  int error;
 
-  char str[EDFLIB_WRITE_MAX_ANNOTATION_LEN + 1];
+  struct edfhdrblock *hdr;
 
 
   if(handle<0)
@@ -6467,73 +8488,39 @@ int edfwrite_annotation_latin1(int handle, long long onset, long long duration,
     return -1;
   }
 
-  if(onset<0LL)
+  if(hdrlist[handle]->datarecords)
   {
     return -1;
   }
 
-  if(hdrlist[handle]->annots_in_file >= hdrlist[handle]->annotlist_sz)
+  if(hdrlist[handle]->signal_write_sequence_pos)
   {
-    malloc_list = (struct edf_write_annotationblock *)realloc(write_annotationslist[handle],
-                                                              sizeof(struct edf_write_annotationblock) * (hdrlist[handle]->annotlist_sz + EDFLIB_ANNOT_MEMBLOCKSZ));
-    if(malloc_list==NULL)
-    {
-      return -1;
-    }
-
-    write_annotationslist[handle] = malloc_list;
-
-    hdrlist[handle]->annotlist_sz += EDFLIB_ANNOT_MEMBLOCKSZ;
+    return -1;
   }
 
-  list_annot = write_annotationslist[handle] + hdrlist[handle]->annots_in_file;
-
-  list_annot->onset = onset;
-  list_annot->duration = duration;
-  strncpy(str, description, EDFLIB_WRITE_MAX_ANNOTATION_LEN);
-  str[EDFLIB_WRITE_MAX_ANNOTATION_LEN] = 0;
-  edflib_latin12utf8(str, strlen(str));
-  strncpy(list_annot->annotation, str, EDFLIB_WRITE_MAX_ANNOTATION_LEN);
-  list_annot->annotation[EDFLIB_WRITE_MAX_ANNOTATION_LEN] = 0;
-
-  hdrlist[handle]->annots_in_file++;
-
-  return 0;
-}
+  if(datarecords<1LL)
+  {
+    return -1;
+  }
 
+  hdr = hdrlist[handle];
 
-static void edflib_remove_padding_trailing_spaces(char *str)
-{
-  int i;
+  error = edflib_write_edf_header(hdr);
 
-  while(str[0]==' ')
+  if(error)
   {
-    for(i=0; ; i++)
-    {
-      if(str[i]==0)
-      {
-        break;
-      }
-
-      str[i] = str[i+1];
-    }
+    return error;
   }
 
-  for(i = strlen(str); i>0; i--)
-  {
-    if(str[i-1]==' ')
-    {
-      str[i-1] = 0;
-    }
-    else
-    {
-      break;
-    }
-  }
+  hdr->datarecords = datarecords;
+
+  hdr->header_only = 1;
+
+  return 0;
 }
 
 
-int edf_set_prefilter(int handle, int edfsignal, const char *prefilter)
+int edf_get_datarecord_size(int handle)
 {
   if(handle<0)
   {
@@ -6555,33 +8542,22 @@ int edf_set_prefilter(int handle, int edfsignal, const char *prefilter)
     return -1;
   }
 
-  if(edfsignal<0)
-  {
-    return -1;
-  }
-
-  if(edfsignal>=hdrlist[handle]->edfsignals)
-  {
-    return -1;
-  }
-
-  if(hdrlist[handle]->datarecords)
+  if(!(hdrlist[handle]->datarecords))
   {
     return -1;
   }
 
-  strncpy(hdrlist[handle]->edfparam[edfsignal].prefilter, prefilter, 80);
+  return hdrlist[handle]->recordsize;
+}
 
-  hdrlist[handle]->edfparam[edfsignal].prefilter[80] = 0;
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->edfparam[edfsignal].prefilter);
+int edf_fill_datarecord_annotations(int handle, long long datarecord, void *buf)
+{
+  long long t[2];
 
-  return 0;
-}
+  struct edfhdrblock *hdr;
 
 
-int edf_set_transducer(int handle, int edfsignal, const char *transducer)
-{
   if(handle<0)
   {
     return -1;
@@ -6602,651 +8578,629 @@ int edf_set_transducer(int handle, int edfsignal, const char *transducer)
     return -1;
   }
 
-  if(edfsignal<0)
+  if(!(hdrlist[handle]->datarecords))
   {
     return -1;
   }
 
-  if(edfsignal>=hdrlist[handle]->edfsignals)
+  if(datarecord<0LL)
   {
     return -1;
   }
 
-  if(hdrlist[handle]->datarecords)
-  {
-    return -1;
-  }
+  hdr = hdrlist[handle];
 
-  strncpy(hdrlist[handle]->edfparam[edfsignal].transducer, transducer, 80);
+  edflib_stats_start(hdr, t);
 
-  hdrlist[handle]->edfparam[edfsignal].transducer[80] = 0;
+  edflib_render_tal(hdr, datarecord, (char *)buf + (hdr->recordsize - hdr->total_annot_bytes));
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->edfparam[edfsignal].transducer);
+  edflib_stats_stop(hdr, t, EDFLIB_STATS_TAL, datarecord);
 
   return 0;
 }
 
 
-/* minimum is the minimum digits that will be printed (minus sign not included), leading zero's will be added if necessary */
-/* if sign is zero, only negative numbers will have the sign '-' character */
-/* if sign is one, the sign '+' or '-' character will always be printed */
-/* returns the amount of characters printed */
-static int edflib_fprint_int_number_nonlocalized(FILE *file, int q, int minimum, int sign)
+int edf_pwrite_datarecords(int handle, long long datarecord, int n, const void *buf)
 {
-  int flag=0, z, i, j=0, base = 1000000000;
-
-  if(minimum < 0)
-  {
-    minimum = 0;
-  }
+  long long offset,
+            len,
+            t[2];
 
-  if(minimum > 9)
-  {
-    flag = 1;
-  }
+  struct edfhdrblock *hdr;
 
-  if(q < 0)
-  {
-    fputc('-', file);
+#ifndef _WIN32
+  ssize_t written;
+#endif
 
-    j++;
 
-    base = -base;
-  }
-  else
+  if(handle<0)
   {
-    if(sign)
-    {
-      fputc('+', file);
-
-      j++;
-    }
+    return -1;
   }
 
-  for(i=10; i; i--)
+  if(handle>=EDFLIB_MAXFILES)
   {
-    if(minimum == i)
-    {
-      flag = 1;
-    }
-
-    z = q / base;
-
-    q %= base;
-
-    if(z || flag)
-    {
-      fputc('0' + z, file);
-
-      j++;
-
-      flag = 1;
-    }
-
-    base /= 10;
+    return -1;
   }
 
-  if(!flag)
+  if(hdrlist[handle]==NULL)
   {
-    fputc('0', file);
-
-    j++;
+    return -1;
   }
 
-  return j;
-}
-
-
-/* minimum is the minimum digits that will be printed (minus sign not included), leading zero's will be added if necessary */
-/* if sign is zero, only negative numbers will have the sign '-' character */
-/* if sign is one, the sign '+' or '-' character will always be printed */
-/* returns the amount of characters printed */
-static int edflib_fprint_ll_number_nonlocalized(FILE *file, long long q, int minimum, int sign)
-{
-  int flag=0, z, i, j=0;
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
 
-  long long base = 1000000000000000000LL;
+  hdr = hdrlist[handle];
 
-  if(minimum < 0)
+  if(hdr->header_only)
   {
-    minimum = 0;
+    return -1;
   }
 
-  if(minimum > 18)
+  if((datarecord<0LL) || (n<1) || ((datarecord + n) > hdr->datarecords))
   {
-    flag = 1;
+    return -1;
   }
 
-  if(q < 0LL)
-  {
-    fputc('-', file);
+  offset = ((long long)(hdr->edfsignals + hdr->nr_annot_chns + 1) * 256LL) + (datarecord * hdr->recordsize);
 
-    j++;
+  len = (long long)n * hdr->recordsize;
 
-    base = -base;
-  }
-  else
+#ifdef _WIN32
+  (void)offset;
+  (void)len;
+  (void)buf;
+  (void)t;
+
+  return -1;
+#else
+  edflib_stats_start(hdr, t);
+
+  while(len > 0LL)
   {
-    if(sign)
+    written = pwrite(fileno(hdr->file_hdl), buf, len, offset);
+
+    if((written < 0) && (errno == EINTR))
     {
-      fputc('+', file);
+      continue;
+    }
 
-      j++;
+    if(written < 1)
+    {
+      edflib_stats_stop(hdr, t, EDFLIB_STATS_WRITE, datarecord);
+
+      return -1;
     }
-  }
 
-  for(i=19; i; i--)
-  {
-    if(minimum == i)
+    if(hdr->stats != NULL)
     {
-      flag = 1;
+      __atomic_add_fetch(&hdr->stats->bytes, (long long)written, __ATOMIC_RELAXED);
     }
 
-    z = q / base;
+    buf = (const char *)buf + written;
 
-    q %= base;
+    offset += written;
 
-    if(z || flag)
-    {
-      fputc('0' + z, file);
+    len -= written;
+  }
 
-      j++;
+  edflib_stats_stop(hdr, t, EDFLIB_STATS_WRITE, datarecord);
 
-      flag = 1;
-    }
+  return 0;
+#endif
+}
 
-    base /= 10LL;
+
+int edf_set_write_stats(int handle, struct edf_write_stats_struct *stats)
+{
+  if(handle<0)
+  {
+    return -1;
   }
 
-  if(!flag)
+  if(handle>=EDFLIB_MAXFILES)
   {
-    fputc('0', file);
+    return -1;
+  }
 
-    j++;
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
   }
 
-  return j;
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
+  }
+
+#ifdef _WIN32
+  (void)stats;
+
+  return -1;
+#else
+  hdrlist[handle]->stats = stats;
+
+  return 0;
+#endif
 }
 
 
-/* minimum is the minimum digits that will be printed (minus sign not included), leading zero's will be added if necessary */
-/* if sign is zero, only negative numbers will have the sign '-' character */
-/* if sign is one, the sign '+' or '-' character will always be printed */
-/* returns the amount of characters printed */
-/*
-static int edflib_sprint_int_number_nonlocalized(char *str, int q, int minimum, int sign)
+int edf_set_write_buffer_size(int handle, int size)
 {
-  int flag=0, z, i, j=0, base = 1000000000;
+  char *iobuf;
 
-  if(minimum < 0)
+  struct edfhdrblock *hdr;
+
+
+  if(handle<0)
   {
-    minimum = 0;
+    return -1;
   }
 
-  if(minimum > 9)
+  if(handle>=EDFLIB_MAXFILES)
   {
-    flag = 1;
+    return -1;
   }
 
-  if(q < 0)
+  if(hdrlist[handle]==NULL)
   {
-    str[j++] = '-';
+    return -1;
+  }
 
-    q = -q;
+  if(!(hdrlist[handle]->writemode))
+  {
+    return -1;
   }
-  else
+
+  if(hdrlist[handle]->datarecords)
   {
-    if(sign)
-    {
-      str[j++] = '+';
-    }
+    return -1;
   }
 
-  for(i=10; i; i--)
+  if(hdrlist[handle]->signal_write_sequence_pos)
   {
-    if(minimum == i)
-    {
-      flag = 1;
-    }
+    return -1;
+  }
 
-    z = q / base;
+  if(hdrlist[handle]->header_only)
+  {
+    return -1;
+  }
 
-    q %= base;
+  if(size<1)
+  {
+    return -1;
+  }
 
-    if(z || flag)
-    {
-      str[j++] = '0' + z;
+  hdr = hdrlist[handle];
 
-      flag = 1;
-    }
+  /* the buffering of stdout belongs to the program */
+  if(hdr->file_hdl == stdout)
+  {
+    return -1;
+  }
 
-    base /= 10;
+  iobuf = (char *)malloc(size);
+  if(iobuf==NULL)
+  {
+    return -1;
   }
 
-  if(!flag)
+  if(setvbuf(hdr->file_hdl, iobuf, _IOFBF, size))
   {
-    str[j++] = '0';
+    free(iobuf);
+
+    return -1;
   }
 
-  str[j] = 0;
+  free(hdr->iobuf);
 
-  return j;
+  hdr->iobuf = iobuf;
+
+  return 0;
 }
-*/
 
-/* minimum is the minimum digits that will be printed (minus sign not included), leading zero's will be added if necessary */
-/* if sign is zero, only negative numbers will have the sign '-' character */
-/* if sign is one, the sign '+' or '-' character will always be printed */
-/* returns the amount of characters printed */
-static int edflib_snprint_ll_number_nonlocalized(char *dest, long long q, int minimum, int sign, int sz)
+
+int edf_set_flush_interval(int handle, int datarecords, int milliseconds)
 {
-  int flag=0, z, i, j=0;
+#ifndef _WIN32
+  struct timespec ts;
+#endif
 
-  long long base = 1000000000000000000LL;
+  if(handle<0)
+  {
+    return -1;
+  }
 
-  if(sz < 1)
+  if(handle>=EDFLIB_MAXFILES)
   {
-    return 0;
+    return -1;
   }
 
-  if(minimum < 0)
+  if(hdrlist[handle]==NULL)
   {
-    minimum = 0;
+    return -1;
   }
 
-  if(minimum > 18)
+  if(!(hdrlist[handle]->writemode))
   {
-    flag = 1;
+    return -1;
   }
 
-  if(q < 0LL)
+  if((datarecords<0) || (milliseconds<0))
   {
-    dest[j++] = '-';
+    return -1;
+  }
 
-    base = -base;
+#ifdef _WIN32
+  if(milliseconds)
+  {
+    return -1;
   }
-  else
+#else
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+
+  hdrlist[handle]->flush_ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+
+  hdrlist[handle]->flush_datarecords = datarecords;
+
+  hdrlist[handle]->flush_ms = milliseconds;
+
+  hdrlist[handle]->flushed_datarecords = hdrlist[handle]->datarecords;
+
+  return 0;
+}
+
+
+int edf_flush(int handle)
+{
+  long long t[2];
+
+  struct edfhdrblock *hdr;
+
+
+  if(handle<0)
   {
-    if(sign)
-    {
-      dest[j++] = '+';
-    }
+    return -1;
   }
 
-  if(j == sz)
+  if(handle>=EDFLIB_MAXFILES)
   {
-    dest[--j] = 0;
+    return -1;
+  }
 
-    return j;
+  if(hdrlist[handle]==NULL)
+  {
+    return -1;
   }
 
-  for(i=19; i; i--)
+  if(!(hdrlist[handle]->writemode))
   {
-    if(minimum == i)
-    {
-      flag = 1;
-    }
+    return -1;
+  }
 
-    z = q / base;
+  hdr = hdrlist[handle];
 
-    q %= base;
+  edflib_stats_start(hdr, t);
 
-    if(z || flag)
-    {
-      dest[j++] = '0' + z;
+  if(fflush(hdr->file_hdl))
+  {
+    return -1;
+  }
 
-      if(j == sz)
-      {
-        dest[--j] = 0;
+  edflib_stats_stop(hdr, t, EDFLIB_STATS_FLUSH, hdr->datarecords - 1LL);
 
-        return j;
-      }
+  hdr->flushed_datarecords = hdr->datarecords;
 
-      flag = 1;
-    }
+  return 0;
+}
 
-    base /= 10LL;
-  }
 
-  if(!flag)
+static void edflib_stats_start(struct edfhdrblock *hdr, long long *t)
+{
+#ifdef _WIN32
+  (void)hdr;
+  (void)t;
+#else
+  struct timespec ts;
+
+  if(hdr->stats == NULL)
   {
-    dest[j++] = '0';
+    return;
   }
 
-  if(j == sz)
-  {
-    dest[--j] = 0;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
 
-    return j;
-  }
+  t[0] = (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
 
-  dest[j] = 0;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
 
-  return j;
+  t[1] = (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+#endif
 }
 
 
-static int edflib_snprint_number_nonlocalized(char *dest, double val, int sz)
+static void edflib_stats_stop(struct edfhdrblock *hdr, long long *t, int stage, long long datarecord)
 {
-  int flag=0, z, i, j=0, q, base = 1000000000;
+#ifdef _WIN32
+  (void)hdr;
+  (void)t;
+  (void)stage;
+  (void)datarecord;
+#else
+  long long now;
 
-  double var;
+  struct timespec ts;
 
-  if(sz < 1)  return 0;
+  if(hdr->stats == NULL)
+  {
+    return;
+  }
 
-  q = (int)val;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
 
-  var = val - q;
+  now = (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
 
-  if(val < 0.0)
-  {
-    dest[j++] = '-';
+  __atomic_add_fetch(&hdr->stats->wall_ns[stage], now - t[0], __ATOMIC_RELAXED);
 
-    if(q < 0)
-    {
-      base = -base;
-    }
+  if(hdr->stats->trace != NULL)
+  {
+    hdr->stats->trace(stage, datarecord, t[0], now, hdr->stats->trace_arg);
   }
 
-  if(j == sz)
-  {
-    dest[--j] = 0;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
 
-    return j;
-  }
+  __atomic_add_fetch(&hdr->stats->cpu_ns[stage], (ts.tv_sec * 1000000000LL) + ts.tv_nsec - t[1], __ATOMIC_RELAXED);
 
-  for(i=10; i; i--)
-  {
-    z = q / base;
+  __atomic_add_fetch(&hdr->stats->calls[stage], 1LL, __ATOMIC_RELAXED);
+#endif
+}
 
-    q %= base;
 
-    if(z || flag)
-    {
-      dest[j++] = '0' + z;
+/* fwrite() of the samples, the time and the bytes are added to the statistics */
+static size_t edflib_fwrite(struct edfhdrblock *hdr, const void *ptr, size_t size, FILE *file)
+{
+  size_t n;
 
-      if(j == sz)
-      {
-        dest[--j] = 0;
+  long long t[2];
 
-        return j;
-      }
+  edflib_stats_start(hdr, t);
 
-      flag = 1;
-    }
+  n = fwrite(ptr, size, 1, file);
 
-    base /= 10;
-  }
+  edflib_stats_stop(hdr, t, EDFLIB_STATS_WRITE, hdr->datarecords);
 
-  if(!flag)
+  if((hdr->stats != NULL) && (n == 1))
   {
-    dest[j++] = '0';
+    __atomic_add_fetch(&hdr->stats->bytes, (long long)size, __ATOMIC_RELAXED);
   }
 
-  if(j == sz)
-  {
-    dest[--j] = 0;
+  return n;
+}
 
-    return j;
-  }
 
-  base = 100000000;
+/* called after one or more complete datarecords have been written, */
+/* flushes the file according to edf_set_flush_interval() */
+static void edflib_fflush(struct edfhdrblock *hdr, FILE *file)
+{
+  int flush=0;
 
-  var *= (base * 10);
+  long long t[2];
 
-  q = (int)var;
+#ifndef _WIN32
+  struct timespec ts;
+#endif
 
-  if(q < 0)
+  if(hdr->flush_datarecords && ((hdr->datarecords - hdr->flushed_datarecords) >= hdr->flush_datarecords))
   {
-    base = -base;
+    flush = 1;
   }
 
-  if(!q)
+#ifndef _WIN32
+  if(hdr->flush_ms)
   {
-    dest[j] = 0;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
 
-    return j;
+    if(((ts.tv_sec * 1000000000LL + ts.tv_nsec) - hdr->flush_ns) >= (hdr->flush_ms * 1000000LL))
+    {
+      flush = 1;
+    }
   }
+#endif
 
-  dest[j++] = '.';
-
-  if(j == sz)
+  if(!flush)
   {
-    dest[--j] = 0;
-
-    return j;
+    return;
   }
 
-  for(i=9; i; i--)
-  {
-    z = q / base;
+  edflib_stats_start(hdr, t);
 
-    q %= base;
+  fflush(file);
 
-    dest[j++] = '0' + z;
+  edflib_stats_stop(hdr, t, EDFLIB_STATS_FLUSH, hdr->datarecords - 1LL);
 
-    if(j == sz)
-    {
-      dest[--j] = 0;
+  hdr->flushed_datarecords = hdr->datarecords;
 
-      return j;
-    }
+#ifndef _WIN32
+  if(hdr->flush_ms)
+  {
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
 
-    base /= 10;
+    hdr->flush_ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
   }
+#endif
+}
 
-  dest[j] = 0;
 
-  j--;
+/* converts n physical samples of signal param to digital samples and stores them as 16-bit little endian in dest */
+static void edflib_quantize_2byte(const double *buf, int n, const struct edfparamblock *param, char *dest)
+{
+  int i=0, value;
 
-  for(; j>0; j--)
+#ifdef EDFLIB_X86_SIMD
+  if(__builtin_cpu_supports("avx2"))
   {
-    if(dest[j] == '0')
+    i = edflib_quantize_2byte_avx2(buf, n, param, dest);
+  }
+#endif
+
+  for(; i<n; i++)
+  {
+    value = (buf[i] / param->bitvalue) - param->offset;
+
+    if(value>param->dig_max)
     {
-      dest[j] = 0;
+      value = param->dig_max;
     }
-    else
-    {
-      j++;
 
-      break;
+    if(value<param->dig_min)
+    {
+      value = param->dig_min;
     }
-  }
 
-  return j;
+    dest[i * 2] = value & 0xff;
+
+    dest[i * 2 + 1] = (value >> 8) & 0xff;
+  }
 }
 
 
-static double edflib_atof_nonlocalized(const char *str)
+/* converts n physical samples of signal param to digital samples and stores them as 24-bit little endian in dest */
+static void edflib_quantize_3byte(const double *buf, int n, const struct edfparamblock *param, char *dest)
 {
-  int i=0, j, dot_pos=-1, decimals=0, sign=1, exp_pos=-1, exp_sign=1, exp_val=0;
-
-  double value, value2=0.0;
-
+  int i=0, value;
 
-  value = edflib_atoi_nonlocalized(str);
-
-  while(str[i] == ' ')
+#ifdef EDFLIB_X86_SIMD
+  if(__builtin_cpu_supports("avx2"))
   {
-    i++;
+    i = edflib_quantize_3byte_avx2(buf, n, param, dest);
   }
+#endif
 
-  if((str[i] == '+') || (str[i] == '-'))
+  for(; i<n; i++)
   {
-    if(str[i] == '-')
-    {
-      sign = -1;
-    }
-
-    i++;
-  }
+    value = (buf[i] / param->bitvalue) - param->offset;
 
-  for(; ; i++)
-  {
-    if(str[i] == 0)
+    if(value>param->dig_max)
     {
-      break;
+      value = param->dig_max;
     }
 
-    if((str[i] == 'e') || (str[i] == 'E'))
+    if(value<param->dig_min)
     {
-      exp_pos = i;
-
-      break;
+      value = param->dig_min;
     }
 
-    if(((str[i] < '0') || (str[i] > '9')) && (str[i] != '.'))
-    {
-      break;
-    }
+    dest[i * 3] = value & 0xff;
 
-    if(dot_pos >= 0)
-    {
-      if((str[i] >= '0') && (str[i] <= '9'))
-      {
-        decimals++;
-      }
-      else
-      {
-        break;
-      }
-    }
+    dest[i * 3 + 1] = (value >> 8) & 0xff;
 
-    if(str[i] == '.')
-    {
-      if(dot_pos < 0)
-      {
-        dot_pos = i;
-      }
-    }
+    dest[i * 3 + 2] = (value >> 16) & 0xff;
   }
+}
 
-  if(decimals)
-  {
-    value2 = edflib_atoi_nonlocalized(str + dot_pos + 1) * sign;
 
-    i = 1;
+#ifdef EDFLIB_X86_SIMD
 
-    while(decimals--)
-    {
-      i *= 10;
-    }
+/* The same operations as the scalar code, eight samples at a time: divide, subtract, truncate and clamp.
+ * There's no multiplication by the reciprocal of the bitvalue, it's not exact, the result would differ
+ * one LSB for samples that are an exact multiple of the bitvalue (e.g. digital samples converted to physical and back).
+ * A conversion that overflows the int gives INT_MIN, just like the scalar cvttsd2si.
+ * Returns the number of samples converted, the rest is left for the scalar code.
+ */
+__attribute__((target("avx2")))
+static int edflib_quantize_2byte_avx2(const double *buf, int n, const struct edfparamblock *param, char *dest)
+{
+  int i;
 
-    value2 /= i;
+  __m256d vbitvalue,
+          voffset;
 
-    value += value2;
-  }
+  __m128i vdigmax,
+          vdigmin,
+          lo,
+          hi;
 
-  if(exp_pos > 0)
+  vbitvalue = _mm256_set1_pd(param->bitvalue);
+
+  voffset = _mm256_set1_pd(param->offset);
+
+  vdigmax = _mm_set1_epi32(param->dig_max);
+
+  vdigmin = _mm_set1_epi32(param->dig_min);
+
+  for(i=0; i<=(n-8); i+=8)
   {
-    i = exp_pos + 1;
+    lo = _mm256_cvttpd_epi32(_mm256_sub_pd(_mm256_div_pd(_mm256_loadu_pd(buf + i), vbitvalue), voffset));
 
-    if(str[i])
-    {
-      if(str[i] == '+')
-      {
-        i++;
-      }
-      else if(str[i] == '-')
-        {
-          exp_sign = -1;
+    hi = _mm256_cvttpd_epi32(_mm256_sub_pd(_mm256_div_pd(_mm256_loadu_pd(buf + i + 4), vbitvalue), voffset));
 
-          i++;
-        }
+    lo = _mm_max_epi32(_mm_min_epi32(lo, vdigmax), vdigmin);
 
-      if(str[i])
-      {
-        exp_val = edflib_atoi_nonlocalized(str + i);
+    hi = _mm_max_epi32(_mm_min_epi32(hi, vdigmax), vdigmin);
 
-        if(exp_val > 0)
-        {
-          for(j=0; j<exp_val; j++)
-          {
-            if(exp_sign > 0)
-            {
-              value *= 10;
-            }
-            else
-            {
-              value /= 10;
-            }
-          }
-        }
-      }
-    }
+    /* the clamped values fit in 16 bits, the saturation of packs does nothing */
+    _mm_storeu_si128((__m128i *)(dest + (i * 2)), _mm_packs_epi32(lo, hi));
   }
 
-  return value;
+  return i;
 }
 
 
-static int edflib_atoi_nonlocalized(const char *str)
+__attribute__((target("avx2")))
+static int edflib_quantize_3byte_avx2(const double *buf, int n, const struct edfparamblock *param, char *dest)
 {
-  int i=0, value=0, sign=1;
+  int i, tail;
 
-  while(str[i] == ' ')
-  {
-    i++;
-  }
+  __m256d vbitvalue,
+          voffset;
 
-  if((str[i] == '+') || (str[i] == '-'))
-  {
-    if(str[i] == '-')
-    {
-      sign = -1;
-    }
+  __m128i vdigmax,
+          vdigmin,
+          shuf,
+          lo,
+          hi;
 
-    i++;
-  }
+  vbitvalue = _mm256_set1_pd(param->bitvalue);
 
-  for( ; ; i++)
-  {
-    if(str[i] == 0)
-    {
-      break;
-    }
+  voffset = _mm256_set1_pd(param->offset);
 
-    if((str[i] < '0') || (str[i] > '9'))
-    {
-      break;
-    }
+  vdigmax = _mm_set1_epi32(param->dig_max);
 
-    value *= 10;
+  vdigmin = _mm_set1_epi32(param->dig_min);
 
-    value += ((str[i] - '0') * sign);
-  }
+  /* drops the most significant byte of every int: four samples of 3 bytes in the lower 12 bytes */
+  shuf = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
 
-  return value;
-}
+  for(i=0; i<=(n-8); i+=8)
+  {
+    lo = _mm256_cvttpd_epi32(_mm256_sub_pd(_mm256_div_pd(_mm256_loadu_pd(buf + i), vbitvalue), voffset));
 
+    hi = _mm256_cvttpd_epi32(_mm256_sub_pd(_mm256_div_pd(_mm256_loadu_pd(buf + i + 4), vbitvalue), voffset));
 
-static int edflib_write_tal(struct edfhdrblock *hdr, FILE *file)
-{
-  int p;
+    lo = _mm_shuffle_epi8(_mm_max_epi32(_mm_min_epi32(lo, vdigmax), vdigmin), shuf);
 
-  char str[EDFLIB_ANNOTATION_BYTES * (EDFLIB_MAX_ANNOTATION_CHANNELS + 1)];
+    hi = _mm_shuffle_epi8(_mm_max_epi32(_mm_min_epi32(hi, vdigmax), vdigmin), shuf);
 
-  p = edflib_snprint_ll_number_nonlocalized(str, (hdr->datarecords * hdr->long_data_record_duration + hdr->starttime_offset) / EDFLIB_TIME_DIMENSION, 0, 1, EDFLIB_ANNOTATION_BYTES * (EDFLIB_MAX_ANNOTATION_CHANNELS + 1));
-  if((hdr->long_data_record_duration % EDFLIB_TIME_DIMENSION) || (hdr->starttime_offset))
-  {
-    str[p++] = '.';
-    p += edflib_snprint_ll_number_nonlocalized(str + p, (hdr->datarecords * hdr->long_data_record_duration + hdr->starttime_offset) % EDFLIB_TIME_DIMENSION, 7, 0, (EDFLIB_ANNOTATION_BYTES * (EDFLIB_MAX_ANNOTATION_CHANNELS + 1)) - p);
-  }
-  str[p++] = 20;
-  str[p++] = 20;
-  for(; p<hdr->total_annot_bytes; p++)
-  {
-    str[p] = 0;
-  }
+    /* 24 bytes: the last 4 bytes of the first store are overwritten by the second one */
+    _mm_storeu_si128((__m128i *)(dest + (i * 3)), lo);
 
-  if(fwrite(str, hdr->total_annot_bytes, 1, file) != 1)
-  {
-    return -1;
+    _mm_storel_epi64((__m128i *)(dest + (i * 3) + 12), hi);
+
+    tail = _mm_cvtsi128_si32(_mm_srli_si128(hi, 8));
+
+    memcpy(dest + (i * 3) + 20, &tail, 4);
   }
 
-  return 0;
+  return i;
 }
 
+#endif
+
 
 static int edflib_strlcpy(char *dst, const char *src, int sz)
 {
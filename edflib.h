@@ -146,6 +146,7 @@
 #define EDFLIB_DIGMAX_LOWER_THAN_DIGMIN    (-24)
 #define EDFLIB_PHYSMIN_IS_PHYSMAX          (-25)
 #define EDFLIB_DATARECORD_SIZE_TOO_BIG     (-26)
+#define EDFLIB_STREAM_MODE_REQUIRED        (-27)
 
 #ifdef __cplusplus
 extern "C" {
@@ -170,6 +171,25 @@ struct edf_annotation_struct{                           /* this structure is use
         char annotation[EDFLIB_MAX_ANNOTATION_LEN + 1]; /* description of the event in UTF-8, this is a null terminated string */
        };
 
+/* stages of writing a file, see edf_set_write_stats() */
+#define EDFLIB_STATS_HEADER    (0)  /* writing the header */
+#define EDFLIB_STATS_CONVERT   (1)  /* conversion of physical samples to digital samples */
+#define EDFLIB_STATS_TAL       (2)  /* rendering and writing the time-keeping annotations */
+#define EDFLIB_STATS_WRITE     (3)  /* writing the samples (fwrite() or pwrite()) */
+#define EDFLIB_STATS_FLUSH     (4)  /* fflush(), see edf_set_flush_interval() */
+#define EDFLIB_STATS_STAGES    (5)
+
+struct edf_write_stats_struct{    /* time spent in the stages of writing, in nanoSeconds, summed over all threads */
+  long long wall_ns[EDFLIB_STATS_STAGES];
+  long long cpu_ns[EDFLIB_STATS_STAGES];   /* cpu time of the calling thread */
+  long long calls[EDFLIB_STATS_STAGES];
+  long long bytes;                         /* bytes of samples written */
+  void (*trace)(int stage, long long datarecord, long long start_ns, long long end_ns, void *arg);
+                                           /* optional, called at the end of every stage, the times are read from CLOCK_MONOTONIC */
+                                           /* datarecord is the datarecord that is being written, -1 for the header */
+  void *trace_arg;
+       };
+
 struct edf_hdr_struct{            /* this structure contains all the relevant EDF header info and will be filled when calling the function edf_open_file_readonly() */
   int       handle;               /* a handle (identifier) used to distinguish the different files */
   int       filetype;             /* 0: EDF, 1: EDF+, 2: BDF, 3: BDF+, a negative number means an error */
@@ -296,6 +316,8 @@ int edflib_get_handle(int file_number);
 int edfopen_file_writeonly(const char *path, int filetype, int number_of_signals);
 /* opens an new file for writing. warning, an already existing file with the same name will be silently overwritten without advance warning!
  * path is a null-terminated string containing the path and name of the file
+ * path "-" writes to stdout, this requires edf_set_stream_mode(), without it the first sample write action
+ * (or edfclose_file() when no samples are written) fails with EDFLIB_STREAM_MODE_REQUIRED
  * filetype must be EDFLIB_FILETYPE_EDFPLUS or EDFLIB_FILETYPE_BDFPLUS
  * returns a handle on success, you need this handle for the other functions
  * in case of an error it returns a negative number corresponding to one of the following values:
@@ -552,6 +574,19 @@ int edf_blockwrite_digital_3byte_samples(int handle, void *buf);
  * Returns 0 on success, otherwise -1
  */
 
+int edf_blockwrite_digital_2byte_samples(int handle, void *buf);
+/* Writes "raw" digital samples from *buf.
+ * buf must be filled with samples from all signals, starting with n samples of signal 0, n samples of signal 1, n samples of signal 2, etc.
+ * where n is the samplefrequency of that signal.
+ * One block equals one second. One sample equals 2 bytes, order is little endian (least significant byte first)
+ * Encoding is second's complement, most significant bit of most significant byte is the sign-bit
+ * The samples will be written to the file without any conversion.
+ * Because the size of a 2-byte sample is 16-bit, this function can only be used when writing an EDF file
+ * The number of samples written is equal to the sum of the samplefrequencies of all signals.
+ * Size of buf should be equal to or bigger than: the sum of the samplefrequencies of all signals x 2 bytes
+ * Returns 0 on success, otherwise -1
+ */
+
 int edf_blockwrite_digital_short_samples(int handle, short *buf);
 /* Writes "raw" digital samples from *buf.
  * buf must be filled with samples from all signals, starting with n samples of signal 0, n samples of signal 1, n samples of signal 2, etc.
@@ -576,6 +611,33 @@ int edf_blockwrite_digital_samples(int handle, int *buf);
  * Returns 0 on success, otherwise -1
  */
 
+int edf_blockwrite_records_physical_samples(int handle, double *buf, int n);
+int edf_blockwrite_records_digital_samples(int handle, int *buf, int n);
+int edf_blockwrite_records_digital_short_samples(int handle, short *buf, int n);
+int edf_blockwrite_records_digital_2byte_samples(int handle, void *buf, int n);
+int edf_blockwrite_records_digital_3byte_samples(int handle, void *buf, int n);
+/* Same as the edf_blockwrite_..._samples() functions above, but writes n datarecords (blocks) at once.
+ * buf must be filled with the blocks one after another, every block has the same layout as the buf of
+ * the corresponding single block function.
+ * The datarecords, including the time-keeping annotations, are assembled in one buffer and written with one fwrite().
+ * This removes the per datarecord overhead when the datarecords are small (low samplefrequencies).
+ * The size of the buffer that edflib allocates is n x edf_get_datarecord_size()
+ * The short and the 2byte version can only be used when writing an EDF file, the 3byte version only when writing a BDF file
+ * Returns 0 on success, otherwise -1
+ */
+
+int edf_writev_records(int handle, void **chnbuf, int n);
+/* Writes n datarecords (blocks) at once, directly from the buffers of the caller, the samples are not copied or converted.
+ * chnbuf is an array with a pointer for every signal (edfsignal 0 first), chnbuf[edfsignal] points to the samples
+ * of that signal for n datarecords: n x samplefrequency samples, 2 bytes per sample (EDF) or 3 bytes per sample (BDF),
+ * little endian two's complement. The samples must be in the range of the digital minimum and maximum, they are not checked.
+ * The datarecords are written with writev(), only the time-keeping annotations are created by edflib.
+ * When the datarecords are smaller than 64 kilobytes in total, they are copied to the buffer of the file instead,
+ * call this function with as many datarecords as possible.
+ * It is not available on Windows.
+ * Returns 0 on success, otherwise -1
+ */
+
 int edfwrite_annotation_utf8(int handle, long long onset, long long duration, const char *description);
 /* writes an annotation/event to the file
  * onset is relative to the start of the file
@@ -652,6 +714,132 @@ int edf_set_subsecond_starttime(int handle, int subsecond);
  * in other words, leave the last 3 digits at zero
  */
 
+int edf_write_header_for_datarecords(int handle, long long datarecords);
+/* Writes the header and reserves space for "datarecords" datarecords (the file is extended to its final size).
+ * After this, the reserved datarecords can be written in any order and from any thread
+ * with edf_pwrite_datarecords(). The datarecords are assembled by the caller, the time-keeping annotations
+ * can be stored in a datarecord with edf_fill_datarecord_annotations().
+ * The other sample write functions append datarecords after the reserved ones.
+ * This function can be called only after opening a file in writemode and before the first sample write action.
+ * It is not available on Windows.
+ * Returns 0 on success, otherwise -1 or one of the EDFLIB_ error codes e.g. EDFLIB_DATARECORD_SIZE_TOO_BIG
+ */
+
+int edf_map_datarecords(int handle, long long datarecords);
+/* Same as edf_write_header_for_datarecords() but also allocates the disk space of the datarecords
+ * and maps the file into memory. The datarecords can be written directly into the mapping with
+ * edf_get_datarecord_ptr(), from any thread and in any order, without a copy or a system call per datarecord.
+ * The mapping is removed by edfclose_file().
+ * Needs an address space that can hold the complete file. It is not available on Windows.
+ * Returns 0 on success, otherwise -1 or one of the EDFLIB_ error codes e.g. EDFLIB_DATARECORD_SIZE_TOO_BIG
+ * If the header has been written but the mapping failed, the datarecords can still be written with edf_pwrite_datarecords().
+ */
+
+void * edf_get_datarecord_ptr(int handle, long long datarecord);
+/* Returns a pointer to datarecord number "datarecord" in the mapping created by edf_map_datarecords().
+ * The datarecords are consecutive in memory, a datarecord is edf_get_datarecord_size() bytes.
+ * Returns NULL on error
+ */
+
+int edf_msync_datarecords(int handle, long long datarecord, long long n, int wait);
+/* Starts writing datarecords datarecord ... datarecord + n - 1 of the mapping to disk
+ * and releases their pages from the mapping. If wait is not zero, it waits until the data is written.
+ * Call it when the datarecords are complete, to limit the amount of dirty memory of very large files.
+ * Returns 0 on success, otherwise -1
+ */
+
+long long edf_get_datarecord_offset(int handle, long long datarecord);
+/* Returns the position in the file of datarecord number "datarecord" reserved with edf_write_header_for_datarecords().
+ * Together with edf_get_file_descriptor() this allows the caller to write the reserved datarecords with its own I/O.
+ * Returns -1 on error
+ */
+
+int edf_get_file_descriptor(int handle);
+/* Returns the file descriptor of a file opened in writemode, it must not be closed by the caller.
+ * Writes through the file descriptor must be done before edfclose_file() and must not overlap the header.
+ * It is not available on Windows.
+ * Returns -1 on error
+ */
+
+int edf_set_stream_mode(int handle, long long datarecords);
+/* Writes the file strictly sequentially, without a single seek, so it can be written to a pipe (see edfopen_file_writeonly()).
+ * The header is written with "datarecords" as the number of datarecords, exactly that number of datarecords must be written.
+ * The annotations are stored in the datarecords in the order in which they were added, one per annotation signal,
+ * starting with the first datarecord that is written after the annotation was added.
+ * Add the annotations before writing the samples, annotations that are added after the last datarecord are lost.
+ * edfclose_file() returns -1 when a different number of datarecords was written or when annotations were lost.
+ * This function can be called only after opening a file in writemode and before the first sample write action.
+ * Returns 0 on success, otherwise -1
+ */
+
+int edf_write_header_only(int handle, long long datarecords);
+/* Writes only the header, with "datarecords" as the number of datarecords. The file will not contain datarecords.
+ * This is useful when the datarecords are stored in separate files that are concatenated with the header later.
+ * The datarecords can be assembled with the help of edf_get_datarecord_size() and edf_fill_datarecord_annotations().
+ * The sample write functions and edf_pwrite_datarecords() can not be used with this file,
+ * annotations written with edfwrite_annotation_utf8() or edfwrite_annotation_latin1() are not stored.
+ * This function can be called only after opening a file in writemode and before the first sample write action.
+ * Returns 0 on success, otherwise -1 or one of the EDFLIB_ error codes e.g. EDFLIB_DATARECORD_SIZE_TOO_BIG
+ */
+
+int edf_get_datarecord_size(int handle);
+/* Returns the size in bytes of a complete datarecord: the samples of all signals (2 or 3 bytes per sample)
+ * followed by the annotation signal(s).
+ * Can be called after edf_write_header_for_datarecords() or after the first sample write action
+ * Returns -1 on error
+ */
+
+int edf_fill_datarecord_annotations(int handle, long long datarecord, void *buf);
+/* Stores the time-keeping annotation of datarecord number "datarecord" (the first datarecord has number 0)
+ * in the annotation signal(s) of the datarecord in buf. buf points to the start of a complete datarecord,
+ * the samples are not touched. Can be called from any thread.
+ * Returns 0 on success, otherwise -1
+ */
+
+int edf_pwrite_datarecords(int handle, long long datarecord, int n, const void *buf);
+/* Writes n complete datarecords from buf at the position of datarecord number "datarecord".
+ * The datarecords must have been reserved with edf_write_header_for_datarecords().
+ * Can be called from any thread, calls for different datarecords can run in parallel.
+ * Size of buf must be n x edf_get_datarecord_size()
+ * Returns 0 on success, otherwise -1
+ */
+
+int edf_set_write_stats(int handle, struct edf_write_stats_struct *stats);
+/* Adds the time spent in every stage of writing the file to stats, stats must stay valid until the file is closed.
+ * The times are added atomically, one stats structure can be shared by multiple files and threads.
+ * If stats->trace is set, it's called with the start and the end of every stage, possibly from multiple threads at once.
+ * Measuring costs two clock readings per stage, NULL stops measuring.
+ * It is not available on Windows.
+ * Returns 0 on success, otherwise -1
+ */
+
+int edf_set_write_buffer_size(int handle, int size);
+/* Sets the size in bytes of the buffer of the file (setvbuf()). The datarecords are written to the disk when the buffer is full,
+ * when the file is flushed (see edf_set_flush_interval() and edf_flush()) and when the file is closed.
+ * A buffer of several datarecords avoids a write system call for every datarecord of files with short datarecords.
+ * Without this function the default buffer of the C library is used.
+ * This function can be called only after opening a file in writemode and before the first sample write action.
+ * It can not be used when writing to stdout, the program decides the buffering of stdout.
+ * Returns 0 on success, otherwise -1
+ */
+
+int edf_set_flush_interval(int handle, int datarecords, int milliseconds);
+/* The datarecords are not flushed after every datarecord. Use this function to limit the amount of data
+ * that is lost when the program crashes. The file is flushed after every "datarecords" datarecords
+ * and/or when "milliseconds" milliseconds have passed since the previous flush.
+ * The check is done after every complete datarecord. Zero disables the limit, the default is zero for both.
+ * datarecords = 1 restores the old behaviour: a flush after every datarecord.
+ * A flush hands the data to the operating system, it doesn't wait until it's on the disk.
+ * milliseconds is not supported on Windows.
+ * Returns 0 on success, otherwise -1
+ */
+
+int edf_flush(int handle);
+/* Writes the buffered data of the file to the operating system.
+ * Write errors that were not reported yet, are returned by edf_flush() or edfclose_file().
+ * Returns 0 on success, otherwise -1
+ */
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,543 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+/* Joins the header and the shards that are written by edfgenerator --part=k/N into one EDF/BDF file.
+ * The data is copied inside the kernel with copy_file_range(), or with splice() through a pipe
+ * when the filesystems don't support it, so the datarecords are never copied into userspace.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "utils.h"
+
+#define PROGRAM_NAME       "edfstitch"
+
+#define COPY_BLOCK_SZ      (1024 * 1024 * 1024)
+#define PIPE_BLOCK_SZ      (64 * 1024)
+
+/* onsets and the datarecord duration are expressed in units of 100 nanoseconds, like edflib does */
+#define TIME_DIMENSION     (10000000LL)
+
+
+static int read_header(int, long long *, long long *, long long *, long long *, long long *, int *);
+static int read_onset(int, long long, int, long long *);
+static int parse_time(const char *, int, long long *);
+static int copy_file(int, int, long long);
+static int copy_file_splice(int, int, long long);
+static int copy_file_rw(int, int, long long);
+
+
+int main(int argc, char **argv)
+{
+  int i,
+      fd_in=-1,
+      fd_part=-1,
+      fd_out=-1;
+
+  long long hdrsize=0,
+            datrecs=0,
+            recsize=0,
+            duration=0,
+            annot_offset=0,
+            onset=0,
+            base=0,
+            total=0;
+
+  int annot_len=0;
+
+  struct stat st;
+
+  setlocale(LC_ALL, "C");
+
+  if(argc < 4)
+  {
+    fprintf(stdout, "\n Usage: " PROGRAM_NAME " <output file> <header file> <part 1> [<part 2> ...]\n"
+                    "\n Joins the header and the parts written by edfgenerator --part=k/N into one EDF/BDF file.\n"
+                    " The parts must be given in order, e.g.:\n"
+                    "\n " PROGRAM_NAME " test.edf test.edf.header test.edf.part1of3 test.edf.part2of3 test.edf.part3of3\n\n");
+    return EXIT_FAILURE;
+  }
+
+  fd_in = open(argv[2], O_RDONLY);
+  if(fd_in < 0)
+  {
+    fprintf(stderr, "error: can not open file %s for reading\n", argv[2]);
+    return EXIT_FAILURE;
+  }
+
+  if(read_header(fd_in, &hdrsize, &datrecs, &recsize, &duration, &annot_offset, &annot_len))
+  {
+    fprintf(stderr, "error: file %s is not a valid EDF or BDF header\n", argv[2]);
+    return EXIT_FAILURE;
+  }
+
+  /* check the parts before the output file is created */
+  for(i=3; i<argc; i++)
+  {
+    if(stat(argv[i], &st))
+    {
+      fprintf(stderr, "error: can not open file %s\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+
+    if(st.st_size % recsize)
+    {
+      fprintf(stderr, "error: the size of file %s is not a multiple of the datarecord size (%lli bytes)\n", argv[i], recsize);
+      return EXIT_FAILURE;
+    }
+
+    /* the first TAL of a part holds the onset of its first datarecord, it tells where the part belongs */
+    if(annot_len && st.st_size)
+    {
+      fd_part = open(argv[i], O_RDONLY);
+      if(fd_part < 0)
+      {
+        fprintf(stderr, "error: can not open file %s for reading\n", argv[i]);
+        return EXIT_FAILURE;
+      }
+
+      if(read_onset(fd_part, annot_offset, annot_len, &onset))
+      {
+        fprintf(stderr, "error: can not read the onset of the first datarecord of file %s\n", argv[i]);
+        return EXIT_FAILURE;
+      }
+
+      close(fd_part);
+
+      /* the onset of the first datarecord of the file is the subsecond part of the starttime */
+      if(i == 3)
+      {
+        if((onset < 0) || (onset >= TIME_DIMENSION))
+        {
+          fprintf(stderr, "error: file %s does not start with the first datarecord, the parts must be given in order\n", argv[i]);
+          return EXIT_FAILURE;
+        }
+
+        base = onset;
+      }
+      else if(onset != (base + ((total / recsize) * duration)))
+        {
+          fprintf(stderr, "error: file %s starts with datarecord %lli, expected datarecord %lli, the parts must be given in order\n",
+                  argv[i], (onset - base) / duration, total / recsize);
+          return EXIT_FAILURE;
+        }
+    }
+
+    total += st.st_size;
+  }
+
+  if(total != (datrecs * recsize))
+  {
+    fprintf(stderr, "error: the parts contain %lli datarecords, the header expects %lli datarecords\n", total / recsize, datrecs);
+    return EXIT_FAILURE;
+  }
+
+  fd_out = open(argv[1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd_out < 0)
+  {
+    fprintf(stderr, "error: can not open file %s for writing\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  if(copy_file(fd_in, fd_out, hdrsize))
+  {
+    fprintf(stderr, "error: can not copy file %s\n", argv[2]);
+    return EXIT_FAILURE;
+  }
+
+  close(fd_in);
+
+  for(i=3; i<argc; i++)
+  {
+    fd_in = open(argv[i], O_RDONLY);
+    if(fd_in < 0)
+    {
+      fprintf(stderr, "error: can not open file %s for reading\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+
+    if(fstat(fd_in, &st))
+    {
+      fprintf(stderr, "error: can not open file %s\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+
+    if(copy_file(fd_in, fd_out, st.st_size))
+    {
+      fprintf(stderr, "error: can not copy file %s\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+
+    close(fd_in);
+  }
+
+  if(close(fd_out))
+  {
+    fprintf(stderr, "error: can not write file %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+/* reads the header size, the number of datarecords, the size and the duration of a datarecord from the header, */
+/* annot_offset and annot_len are the position of the first annotation signal in a datarecord, annot_len is 0 if there's none */
+static int read_header(int fd, long long *hdrsize, long long *datrecs, long long *recsize, long long *duration, long long *annot_offset, int *annot_len)
+{
+  int i, ns, sz, smp_bytes;
+
+  char *hdr;
+
+  struct stat st;
+
+  if(fstat(fd, &st))
+  {
+    return -1;
+  }
+
+  if((st.st_size < 512) || (st.st_size > (256 * 641)))
+  {
+    return -1;
+  }
+
+  hdr = (char *)malloc(st.st_size);
+  if(hdr == NULL)
+  {
+    return -1;
+  }
+
+  if(pread(fd, hdr, st.st_size, 0) != st.st_size)
+  {
+    free(hdr);
+    return -1;
+  }
+
+  if(hdr[0] == '0')
+  {
+    smp_bytes = 2;  /* EDF */
+  }
+  else if((unsigned char)hdr[0] == 0xff)
+    {
+      smp_bytes = 3;  /* BDF */
+    }
+    else
+    {
+      free(hdr);
+      return -1;
+    }
+
+  *hdrsize = antoi(hdr + 184, 8);
+
+  *datrecs = antoi(hdr + 236, 8);
+
+  ns = antoi(hdr + 252, 4);
+
+  if((ns < 1) || (*hdrsize != ((ns + 1) * 256)) || (*hdrsize != st.st_size) || (*datrecs < 1))
+  {
+    free(hdr);
+    return -1;
+  }
+
+  if(parse_time(hdr + 244, 8, duration) || (*duration < 1))
+  {
+    free(hdr);
+    return -1;
+  }
+
+  *recsize = 0;
+
+  *annot_len = 0;
+
+  for(i=0; i<ns; i++)
+  {
+    sz = antoi(hdr + 256 + (ns * 216) + (i * 8), 8) * smp_bytes;
+
+    if((!*annot_len) && (!strncmp(hdr + 256 + (i * 16), (smp_bytes == 3) ? "BDF Annotations " : "EDF Annotations ", 16)))
+    {
+      *annot_offset = *recsize;
+
+      *annot_len = sz;
+    }
+
+    *recsize += sz;
+  }
+
+  free(hdr);
+
+  if(*recsize < 1)
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* reads the onset of the first TAL of the annotation signal at offset in the first datarecord of fd */
+static int read_onset(int fd, long long offset, int len, long long *onset)
+{
+  int n;
+
+  char str[64];
+
+  if(len > 63)
+  {
+    len = 63;
+  }
+
+  if(pread(fd, str, len, offset) != len)
+  {
+    return -1;
+  }
+
+  str[len] = 0;
+
+  if((str[0] != '+') && (str[0] != '-'))
+  {
+    return -1;
+  }
+
+  for(n=1; n<len; n++)
+  {
+    if(str[n] == 20)
+    {
+      break;
+    }
+  }
+
+  if(n == len)
+  {
+    return -1;
+  }
+
+  return parse_time(str, n, onset);
+}
+
+
+/* converts a number of seconds (e.g. "+12.25" or "0.1     ") into units of TIME_DIMENSION, */
+/* the number must fill the first len characters of str, trailing spaces are allowed */
+static int parse_time(const char *str, int len, long long *t)
+{
+  int i=0, digits=0, neg=0;
+
+  long long scale=TIME_DIMENSION;
+
+  *t = 0;
+
+  if((str[0] == '+') || (str[0] == '-'))
+  {
+    neg = (str[0] == '-');
+
+    i++;
+  }
+
+  for(; (i<len) && (str[i] >= '0') && (str[i] <= '9'); i++, digits++)
+  {
+    *t = (*t * 10) + (str[i] - '0');
+  }
+
+  *t *= TIME_DIMENSION;
+
+  if((i < len) && (str[i] == '.'))
+  {
+    for(i++; (i<len) && (str[i] >= '0') && (str[i] <= '9'); i++, digits++)
+    {
+      scale /= 10;
+
+      *t += (str[i] - '0') * scale;
+    }
+  }
+
+  for(; i<len; i++)
+  {
+    if(str[i] != ' ')
+    {
+      return -1;
+    }
+  }
+
+  if(!digits)
+  {
+    return -1;
+  }
+
+  if(neg)
+  {
+    *t = -*t;
+  }
+
+  return 0;
+}
+
+
+/* appends len bytes of fd_in to fd_out */
+static int copy_file(int fd_in, int fd_out, long long len)
+{
+  ssize_t n;
+
+  while(len > 0)
+  {
+    n = copy_file_range(fd_in, NULL, fd_out, NULL, (len > COPY_BLOCK_SZ) ? COPY_BLOCK_SZ : len, 0);
+
+    if(n < 0)
+    {
+      if((errno == EXDEV) || (errno == EINVAL) || (errno == ENOSYS) || (errno == EOPNOTSUPP))
+      {
+        /* no copy_file_range() between these files, the file positions have not changed */
+        return copy_file_splice(fd_in, fd_out, len);
+      }
+
+      return -1;
+    }
+
+    if(n == 0)
+    {
+      return -1;  /* the file is shorter than expected */
+    }
+
+    len -= n;
+  }
+
+  return 0;
+}
+
+
+/* moves the data through a pipe, the pages are not copied into userspace */
+static int copy_file_splice(int fd_in, int fd_out, long long len)
+{
+  int pipefd[2];
+
+  ssize_t n, m;
+
+  if(pipe(pipefd))
+  {
+    return copy_file_rw(fd_in, fd_out, len);
+  }
+
+  while(len > 0)
+  {
+    n = splice(fd_in, NULL, pipefd[1], NULL, (len > PIPE_BLOCK_SZ) ? PIPE_BLOCK_SZ : len, SPLICE_F_MOVE);
+
+    if(n < 0)
+    {
+      close(pipefd[0]);
+      close(pipefd[1]);
+
+      if(errno == EINVAL)
+      {
+        return copy_file_rw(fd_in, fd_out, len);
+      }
+
+      return -1;
+    }
+
+    if(n == 0)
+    {
+      close(pipefd[0]);
+      close(pipefd[1]);
+      return -1;
+    }
+
+    len -= n;
+
+    while(n > 0)
+    {
+      m = splice(pipefd[0], NULL, fd_out, NULL, n, SPLICE_F_MOVE);
+
+      if(m < 1)
+      {
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return -1;
+      }
+
+      n -= m;
+    }
+  }
+
+  close(pipefd[0]);
+  close(pipefd[1]);
+
+  return 0;
+}
+
+
+/* last resort */
+static int copy_file_rw(int fd_in, int fd_out, long long len)
+{
+  char *buf;
+
+  ssize_t n, m, pos;
+
+  buf = (char *)malloc(PIPE_BLOCK_SZ * 16);
+  if(buf == NULL)
+  {
+    return -1;
+  }
+
+  while(len > 0)
+  {
+    n = read(fd_in, buf, (len > (PIPE_BLOCK_SZ * 16)) ? (PIPE_BLOCK_SZ * 16) : len);
+
+    if(n < 1)
+    {
+      free(buf);
+      return -1;
+    }
+
+    for(pos=0; pos<n; pos+=m)
+    {
+      m = write(fd_out, buf + pos, n - pos);
+
+      if(m < 1)
+      {
+        free(buf);
+        return -1;
+      }
+    }
+
+    len -= n;
+  }
+
+  free(buf);
+
+  return 0;
+}
+
@@ -0,0 +1,482 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+/* Checks the time-keeping annotations (TAL) that edflib writes with the sequential write functions.
+ * These functions keep the TAL of the previous datarecord as a template and add the datarecord duration
+ * to its digits (edflib_next_tal()). Every case is written twice:
+ * with the sequential write functions (template) and with edf_write_header_for_datarecords(),
+ * edf_fill_datarecord_annotations() and edf_pwrite_datarecords() (the TAL is formatted from scratch).
+ * In normal mode both files must be identical. In stream mode the annotations are stored in other datarecords,
+ * the header, the samples and the time-keeping TAL of every datarecord must be identical.
+ * The cases cover fractional and microsecond datarecord durations, subsecond starttimes
+ * and onsets that need an extra digit (e.g. 9.75 -> 10.00 and 999 -> 1000).
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <unistd.h>
+
+#include "edflib.h"
+#include "utils.h"
+
+#define PROGRAM_NAME       "edftaltest"
+
+#define TEST_SIGNALS       (2)
+
+#define TEST_ANNOTATIONS  (20)
+
+/* the number of datarecords that is written with one call of edf_blockwrite_records_digital_samples() */
+#define TEST_BLOCK_RECS  (777)
+
+
+/* one datarecord duration of the test */
+struct tal_case_struct
+{
+  int duration;
+  int micro;        /* duration is expressed in microseconds instead of units of 10 microseconds */
+  int datrecs;
+  const char *name;
+};
+
+
+static const struct tal_case_struct tal_cases[]={
+  {     25000, 0,  1200, "0.25 sec."},
+  {     33333, 0,  1200, "0.33333 sec."},
+  {    100000, 0,  1200, "1 sec."},
+  {    150000, 0,   800, "1.5 sec."},
+  {       100, 0, 12000, "0.001 sec."},
+  {   5999999, 0,   120, "59.99999 sec."},
+  {         7, 1,  3000, "7 usec."},
+  {      9999, 1,  3000, "9999 usec."}};
+
+static const int subseconds[]={0, 1, 5000000, 9999999};
+
+static int sf[TEST_SIGNALS]={3, 2};
+
+
+static int write_template(const char *, const struct tal_case_struct *, int, int, int, int);
+static int write_formatted(const char *, const struct tal_case_struct *, int, int);
+static int open_file(const char *, const struct tal_case_struct *, int, int);
+static int compare_files(const char *, const char *, int);
+static unsigned char * read_file(const char *, long long *);
+static int sample_value(int, int, int);
+
+
+int main(int argc, char **argv)
+{
+  int i, s, annot, stream, mode,
+      cases=0,
+      failed=0;
+
+  char dir[1024]=".",
+       path_a[2048]="",
+       path_b[2048]="";
+
+  setlocale(LC_ALL, "C");
+
+  if(argc > 2)
+  {
+    fprintf(stdout, "\n Usage: " PROGRAM_NAME " [directory of the temporary files, default: .]\n\n");
+    return EXIT_FAILURE;
+  }
+
+  if(argc == 2)
+  {
+    strlcpy(dir, argv[1], 1024);
+  }
+
+  snprintf(path_a, 2048, "%s/" PROGRAM_NAME "_a.edf", dir);
+
+  snprintf(path_b, 2048, "%s/" PROGRAM_NAME "_b.edf", dir);
+
+  for(i=0; i<(int)(sizeof(tal_cases) / sizeof(tal_cases[0])); i++)
+  {
+    for(s=0; s<(int)(sizeof(subseconds) / sizeof(subseconds[0])); s++)
+    {
+      for(annot=1; annot<=2; annot++)
+      {
+        if(write_formatted(path_b, &tal_cases[i], subseconds[s], annot))
+        {
+          fprintf(stderr, "error: can not write file %s\n", path_b);
+          unlink(path_b);
+          return EXIT_FAILURE;
+        }
+
+        for(stream=0; stream<2; stream++)
+        {
+          /* mode 0: one datarecord per call, mode 1: many datarecords per call */
+          for(mode=0; mode<2; mode++)
+          {
+            cases++;
+
+            if(write_template(path_a, &tal_cases[i], subseconds[s], annot, stream, mode) ||
+               compare_files(path_a, path_b, stream))
+            {
+              fprintf(stderr, "FAILED: duration %s, subsecond starttime %i, %i annotation signal(s), %s mode, %s\n",
+                      tal_cases[i].name, subseconds[s], annot, stream ? "stream" : "normal",
+                      mode ? "edf_blockwrite_records_digital_samples()" : "edfwrite_digital_samples()");
+
+              failed++;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  unlink(path_a);
+  unlink(path_b);
+
+  fprintf(stdout, "%i of %i cases passed\n", cases - failed, cases);
+
+  if(failed)
+  {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+/* creates the file of a case and adds the annotations, returns the handle or -1 on error */
+static int open_file(const char *path, const struct tal_case_struct *tcase, int subsecond, int annot)
+{
+  int i, hdl, err;
+
+  hdl = edfopen_file_writeonly(path, EDFLIB_FILETYPE_EDFPLUS, TEST_SIGNALS);
+  if(hdl < 0)
+  {
+    return -1;
+  }
+
+  err = 0;
+
+  for(i=0; i<TEST_SIGNALS; i++)
+  {
+    err |= edf_set_samplefrequency(hdl, i, sf[i]);
+    err |= edf_set_physical_maximum(hdl, i, 100);
+    err |= edf_set_physical_minimum(hdl, i, -100);
+    err |= edf_set_digital_maximum(hdl, i, 32767);
+    err |= edf_set_digital_minimum(hdl, i, -32768);
+  }
+
+  err |= edf_set_startdatetime(hdl, 2020, 1, 1, 0, 0, 0);
+
+  if(tcase->micro)
+  {
+    err |= edf_set_micro_datarecord_duration(hdl, tcase->duration);
+  }
+  else
+  {
+    err |= edf_set_datarecord_duration(hdl, tcase->duration);
+  }
+
+  err |= edf_set_subsecond_starttime(hdl, subsecond);
+
+  err |= edf_set_number_of_annotation_signals(hdl, annot);
+
+  for(i=0; i<TEST_ANNOTATIONS; i++)
+  {
+    err |= edfwrite_annotation_latin1(hdl, i * 70LL, -1, "event");
+  }
+
+  if(err)
+  {
+    edfclose_file(hdl);
+    return -1;
+  }
+
+  return hdl;
+}
+
+
+/* writes the datarecords with the sequential write functions, edflib updates the TAL of the previous datarecord */
+static int write_template(const char *path, const struct tal_case_struct *tcase, int subsecond, int annot, int stream, int mode)
+{
+  int i, j, k, n, hdl,
+      err=0,
+      *buf;
+
+  hdl = open_file(path, tcase, subsecond, annot);
+  if(hdl < 0)
+  {
+    return -1;
+  }
+
+  if(stream && edf_set_stream_mode(hdl, tcase->datrecs))
+  {
+    edfclose_file(hdl);
+    return -1;
+  }
+
+  buf = (int *)malloc(sizeof(int[TEST_BLOCK_RECS * (TEST_SIGNALS * 3)]));
+  if(buf == NULL)
+  {
+    edfclose_file(hdl);
+    return -1;
+  }
+
+  for(j=0; (j<tcase->datrecs) && !err; j+=n)
+  {
+    n = mode ? (tcase->datrecs - j) : 1;
+
+    if(n > TEST_BLOCK_RECS)
+    {
+      n = TEST_BLOCK_RECS;
+    }
+
+    if(mode)
+    {
+      /* the samples of n datarecords, in the order of the datarecords */
+      for(i=0; i<n; i++)
+      {
+        for(k=0; k<sf[0]; k++)
+        {
+          buf[(i * (sf[0] + sf[1])) + k] = sample_value(j + i, 0, k);
+        }
+
+        for(k=0; k<sf[1]; k++)
+        {
+          buf[(i * (sf[0] + sf[1])) + sf[0] + k] = sample_value(j + i, 1, k);
+        }
+      }
+
+      err = edf_blockwrite_records_digital_samples(hdl, buf, n);
+    }
+    else
+    {
+      for(i=0; (i<TEST_SIGNALS) && !err; i++)
+      {
+        for(k=0; k<sf[i]; k++)
+        {
+          buf[k] = sample_value(j, i, k);
+        }
+
+        err = edfwrite_digital_samples(hdl, buf);
+      }
+    }
+  }
+
+  free(buf);
+
+  if(edfclose_file(hdl))
+  {
+    err = -1;
+  }
+
+  return err ? -1 : 0;
+}
+
+
+/* Assembles the datarecords, the TAL of every datarecord is formatted from scratch by edf_fill_datarecord_annotations(),
+ * and writes them with edf_pwrite_datarecords(). The annotations are stored by edfclose_file().
+ */
+static int write_formatted(const char *path, const struct tal_case_struct *tcase, int subsecond, int annot)
+{
+  int i, j, k, m, hdl, recsize,
+      err=0;
+
+  unsigned char *buf;
+
+  hdl = open_file(path, tcase, subsecond, annot);
+  if(hdl < 0)
+  {
+    return -1;
+  }
+
+  if(edf_write_header_for_datarecords(hdl, tcase->datrecs))
+  {
+    edfclose_file(hdl);
+    return -1;
+  }
+
+  recsize = edf_get_datarecord_size(hdl);
+
+  buf = (unsigned char *)malloc(recsize);
+  if(buf == NULL)
+  {
+    edfclose_file(hdl);
+    return -1;
+  }
+
+  for(j=0; (j<tcase->datrecs) && !err; j++)
+  {
+    for(i=0, k=0; i<TEST_SIGNALS; k+=sf[i++])
+    {
+      for(m=0; m<sf[i]; m++)
+      {
+        buf[(k + m) * 2] = sample_value(j, i, m) & 0xff;
+
+        buf[((k + m) * 2) + 1] = (sample_value(j, i, m) >> 8) & 0xff;
+      }
+    }
+
+    err = edf_fill_datarecord_annotations(hdl, j, buf);
+
+    if(!err)
+    {
+      err = edf_pwrite_datarecords(hdl, j, 1, buf);
+    }
+  }
+
+  free(buf);
+
+  if(edfclose_file(hdl))
+  {
+    err = -1;
+  }
+
+  return err ? -1 : 0;
+}
+
+
+/* Compares file a with file b. With tal_only, the samples and the time-keeping TAL
+ * of every datarecord are compared, the annotations that follow the TAL are skipped.
+ * Returns 0 if the files are equal.
+ */
+static int compare_files(const char *path_a, const char *path_b, int tal_only)
+{
+  int i, ns, hdrsize, recsize, annot_pos, datrecs,
+      err=0;
+
+  long long sz_a, sz_b, pos;
+
+  unsigned char *a, *b;
+
+  a = read_file(path_a, &sz_a);
+  b = read_file(path_b, &sz_b);
+  if((a == NULL) || (b == NULL) || (sz_a != sz_b) || (sz_a < 512))
+  {
+    free(a);
+    free(b);
+    return -1;
+  }
+
+  if(!tal_only)
+  {
+    err = memcmp(a, b, sz_a) ? -1 : 0;
+
+    free(a);
+    free(b);
+
+    return err;
+  }
+
+  ns = antoi((char *)a + 252, 4);
+
+  hdrsize = (ns + 1) * 256;
+
+  recsize = 0;
+
+  for(i=0; i<ns; i++)
+  {
+    recsize += antoi((char *)a + 256 + (ns * 216) + (i * 8), 8) * 2;
+  }
+
+  annot_pos = (sf[0] + sf[1]) * 2;
+
+  datrecs = (sz_a - hdrsize) / recsize;
+
+  if(memcmp(a, b, hdrsize))
+  {
+    err = -1;
+  }
+
+  for(i=0; (i<datrecs) && !err; i++)
+  {
+    pos = hdrsize + ((long long)recsize * i);
+
+    /* the samples and the TAL up to and including the 0 that ends it */
+    if(memcmp(a + pos, b + pos, annot_pos) || memcmp(a + pos + annot_pos, b + pos + annot_pos, strlen((char *)b + pos + annot_pos) + 1))
+    {
+      err = -1;
+    }
+  }
+
+  free(a);
+  free(b);
+
+  return err;
+}
+
+
+/* reads a complete file, returns NULL on error */
+static unsigned char * read_file(const char *path, long long *sz)
+{
+  unsigned char *buf;
+
+  FILE *f;
+
+  f = fopen(path, "rb");
+  if(f == NULL)
+  {
+    return NULL;
+  }
+
+  fseeko(f, 0LL, SEEK_END);
+
+  *sz = ftello(f);
+
+  fseeko(f, 0LL, SEEK_SET);
+
+  buf = (unsigned char *)malloc(*sz + 1);
+  if(buf == NULL)
+  {
+    fclose(f);
+    return NULL;
+  }
+
+  if(fread(buf, *sz, 1, f) != 1)
+  {
+    fclose(f);
+    free(buf);
+    return NULL;
+  }
+
+  fclose(f);
+
+  return buf;
+}
+
+
+/* a different value for every sample of every datarecord */
+static int sample_value(int datrec, int chan, int smp)
+{
+  return ((datrec * 7) + (chan * 1000) + smp) % 30000;
+}
+
+
+
+
+
+
+
+
@@ -0,0 +1,561 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+
+
+#include "generate.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "edflib.h"
+#include "stats.h"
+#include "trace.h"
+
+
+static void generate_wave(int, double *, int, int, const struct wavegen_par_struct *);
+static int generate_channel(int, struct gen_job_struct *, double *);
+static void generate_channel_task(int, int, void *);
+static void pack_channel(int, struct gen_job_struct *, const double *);
+
+
+/* assigns the arrays of sp to mem and returns the total size, */
+/* with mem == NULL only the size is calculated */
+size_t sig_par_layout(struct sig_par_struct *sp, unsigned char *mem, int chns)
+{
+  size_t pos=0;
+
+  sp->sf = sig_par_carve(mem, &pos, sizeof(int[chns]));
+  sp->digmax = sig_par_carve(mem, &pos, sizeof(int[chns]));
+  sp->digmin = sig_par_carve(mem, &pos, sizeof(int[chns]));
+  sp->waveform = sig_par_carve(mem, &pos, sizeof(int[chns]));
+  sp->signalfreq = sig_par_carve(mem, &pos, sizeof(double[chns]));
+  sp->physmax = sig_par_carve(mem, &pos, sizeof(double[chns]));
+  sp->physmin = sig_par_carve(mem, &pos, sizeof(double[chns]));
+  sp->peakamp = sig_par_carve(mem, &pos, sizeof(double[chns]));
+  sp->dutycycle = sig_par_carve(mem, &pos, sizeof(double[chns]));
+  sp->dc_offset = sig_par_carve(mem, &pos, sizeof(double[chns]));
+  sp->phase = sig_par_carve(mem, &pos, sizeof(double[chns]));
+  sp->physdim = sig_par_carve(mem, &pos, sizeof(char[chns][32]));
+  sp->quant = sig_par_carve(mem, &pos, sizeof(struct wavegen_quant_struct[chns]));
+  sp->datrec_offset = sig_par_carve(mem, &pos, sizeof(int[chns]));
+  sp->period = sig_par_carve(mem, &pos, sizeof(int[chns]));
+  sp->prng = sig_par_carve(mem, &pos, sizeof(struct prng_struct[chns]));
+  sp->pink = sig_par_carve(mem, &pos, sizeof(struct pinknoise_struct[chns]));
+  sp->pink_chan = sig_par_carve(mem, &pos, sizeof(int[chns][PINKNOISE_LANES]));
+  sp->buf = sig_par_carve(mem, &pos, sizeof(double *[chns]));
+
+  return pos;
+}
+
+
+/* returns the next sz bytes of mem (or NULL if mem is NULL), the position is rounded up to the next cacheline */
+void * sig_par_carve(unsigned char *mem, size_t *pos, size_t sz)
+{
+  void *ptr=NULL;
+
+  if(mem != NULL)
+  {
+    ptr = mem + *pos;
+  }
+
+  *pos += ((sz + SIG_PAR_ALIGN - 1) / SIG_PAR_ALIGN) * SIG_PAR_ALIGN;
+
+  return ptr;
+}
+
+
+/* groups the pink noise signals with equal samplerate in filter banks of up to PINKNOISE_LANES signals */
+void sig_par_pink_setup(struct sig_par_struct *sp, int chns)
+{
+  int i, j, n;
+
+  sp->pink_banks = 0;
+
+  for(i=0; i<chns; i++)
+  {
+    if(sp->waveform[i] == WAVE_PINK_NOISE)
+    {
+      for(j=0; j<sp->pink_banks; j++)
+      {
+        if((sp->sf[sp->pink_chan[j][0]] == sp->sf[i]) && (sp->pink[j].lanes < PINKNOISE_LANES))
+        {
+          break;
+        }
+      }
+
+      if(j == sp->pink_banks)
+      {
+        pinknoise_bank_init(&sp->pink[j]);
+
+        sp->pink_banks++;
+      }
+
+      n = pinknoise_bank_add(&sp->pink[j], sp->peakamp[i], sp->dc_offset[i]);
+
+      sp->pink_chan[j][n] = i;
+    }
+  }
+}
+
+
+static void generate_wave(int waveform, double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  if(waveform == WAVE_SINE)
+  {
+    wavegen_sine(buf, start, n, par);
+  }
+  else if(waveform == WAVE_SQUARE)
+    {
+      wavegen_square(buf, start, n, par);
+    }
+    else if(waveform == WAVE_RAMP)
+      {
+        wavegen_ramp(buf, start, n, par);
+      }
+      else if(waveform == WAVE_TRIANGLE)
+        {
+          wavegen_triangle(buf, start, n, par);
+        }
+}
+
+
+/* generates one datarecord of one signal, can be called from multiple threads at once */
+static int generate_channel(int chan, struct gen_job_struct *job, double *buf)
+{
+  struct sig_par_struct *sp=job->sp;
+
+  int i, n;
+
+  long long t,
+            t_trace;
+
+  double chunk_buf[WAVEGEN_CHUNK];
+
+  struct wavegen_par_struct wave_par;
+
+  struct prng_struct prng;
+
+  /* the phase at the start of the datarecord is calculated from the datarecord index, */
+  /* this way the phase does not drift and stays accurate in very long files */
+  if(sp->period[chan])
+  {
+    /* the index is reduced to the period, this makes the signal exactly periodic */
+    wave_par.phase = (sp->phase[chan] / 360.0) + fmod(sp->signalfreq[chan] * (job->datrec % sp->period[chan]), 1.0);
+  }
+  else
+  {
+    wave_par.phase = (sp->phase[chan] / 360.0) + fmod(sp->signalfreq[chan] * job->datrec, 1.0);
+  }
+  wave_par.step = sp->signalfreq[chan] / sp->sf[chan];
+  wave_par.amp = sp->peakamp[chan];
+  wave_par.dutycycle = sp->dutycycle[chan] / 100.0;
+  wave_par.dc_offset = sp->dc_offset[chan];
+
+  t = stats_lap(0LL, -1);
+
+  t_trace = trace_time();
+
+  if((sp->waveform[chan] <= WAVE_TRIANGLE) && !job->merge_set)
+  {
+    /* generate, convert and pack in chunks that stay in the cache, */
+    /* the samples go straight into the datarecord buffer */
+    for(i=0; i<sp->sf[chan]; i+=WAVEGEN_CHUNK)
+    {
+      n = sp->sf[chan] - i;
+
+      if(n > WAVEGEN_CHUNK)
+      {
+        n = WAVEGEN_CHUNK;
+      }
+
+      generate_wave(sp->waveform[chan], chunk_buf, i, n, &wave_par);
+
+      t = stats_lap(t, STATS_GEN + sp->waveform[chan]);
+
+      if(job->filetype == FILETYPE_BDF)
+      {
+        wavegen_pack_bdf(chunk_buf, n, &sp->quant[chan], job->datrec_buf + sp->datrec_offset[chan] + (i * 3));
+      }
+      else
+      {
+        wavegen_pack_edf(chunk_buf, n, &sp->quant[chan], job->datrec_buf + sp->datrec_offset[chan] + (i * 2));
+      }
+
+      t = stats_lap(t, STATS_QUANT);
+    }
+
+    /* the span includes the quantization, it's done in the same chunks */
+    trace_span(TRACE_GEN + sp->waveform[chan], chan, job->datrec, t_trace);
+  }
+  else if(sp->waveform[chan] <= WAVE_TRIANGLE)
+    {
+      generate_wave(sp->waveform[chan], buf, 0, sp->sf[chan], &wave_par);
+
+      stats_lap(t, STATS_GEN + sp->waveform[chan]);
+
+      trace_span(TRACE_GEN + sp->waveform[chan], chan, job->datrec, t_trace);
+    }
+        else if(sp->waveform[chan] == WAVE_WHITE_NOISE)
+          {
+            /* the position in the stream is the index of the first sample of the datarecord, */
+            /* this way the datarecords can be generated in any order */
+            prng = sp->prng[chan];
+
+            prng_seek(&prng, (uint64_t)job->datrec * sp->sf[chan]);
+
+            prng_uniform(&prng, buf, sp->sf[chan]);
+
+            for(i=0; i<sp->sf[chan]; i++)
+            {
+              buf[i] = (buf[i] * sp->peakamp[chan]) + sp->dc_offset[chan];
+            }
+
+            t = stats_lap(t, STATS_GEN + WAVE_WHITE_NOISE);
+
+            trace_span(TRACE_GEN + WAVE_WHITE_NOISE, chan, job->datrec, t_trace);
+
+            if(!job->merge_set)
+            {
+              t_trace = trace_time();
+
+              pack_channel(chan, job, buf);
+
+              stats_lap(t, STATS_QUANT);
+
+              trace_span(TRACE_QUANT, chan, job->datrec, t_trace);
+            }
+          }
+
+  return 0;
+}
+
+
+static void generate_channel_task(int task, int thread, void *arg)
+{
+  int err;
+
+  struct gen_job_struct *job;
+
+  struct sig_par_struct *sp;
+
+  job = (struct gen_job_struct *)arg;
+
+  sp = job->sp;
+
+  (void)thread;
+
+  /* the first tasks are the signals, the pink noise banks follow */
+  if(task < job->chns)
+  {
+    if(sp->waveform[task] == WAVE_PINK_NOISE)
+    {
+      return;  /* generated by the task of its bank */
+    }
+
+    err = generate_channel(task, job, sp->buf[task]);
+  }
+  else
+  {
+    err = generate_pink_bank(task - job->chns, job);
+  }
+
+  if(err)
+  {
+    __atomic_store_n(&job->err, 1, __ATOMIC_RELAXED);
+  }
+}
+
+
+/* generates the pink noise signals of a bank, all signals of a bank have the same samplerate */
+int generate_pink_bank(int bank, struct gen_job_struct *job)
+{
+  struct sig_par_struct *sp=job->sp;
+
+  int lane, chan, sf;
+
+  long long t,
+            t_trace;
+
+  double *buf[PINKNOISE_LANES];
+
+  struct prng_struct prng;
+
+  t = stats_lap(0LL, -1);
+
+  t_trace = trace_time();
+
+  sf = sp->sf[sp->pink_chan[bank][0]];
+
+  for(lane=0; lane<sp->pink[bank].lanes; lane++)
+  {
+    chan = sp->pink_chan[bank][lane];
+
+    prng = sp->prng[chan];
+
+    prng_seek(&prng, (uint64_t)job->datrec * sf);
+
+    prng_uniform(&prng, sp->buf[chan], sf);
+
+    buf[lane] = sp->buf[chan];
+  }
+
+  pinknoise_generate(&sp->pink[bank], buf, sf);
+
+  t = stats_lap(t, STATS_GEN + WAVE_PINK_NOISE);
+
+  /* the span of a bank is shown at its first signal */
+  trace_span(TRACE_GEN + WAVE_PINK_NOISE, sp->pink_chan[bank][0], job->datrec, t_trace);
+
+  if(!job->merge_set)
+  {
+    t_trace = trace_time();
+
+    for(lane=0; lane<sp->pink[bank].lanes; lane++)
+    {
+      pack_channel(sp->pink_chan[bank][lane], job, sp->buf[sp->pink_chan[bank][lane]]);
+    }
+
+    stats_lap(t, STATS_QUANT);
+
+    trace_span(TRACE_QUANT, sp->pink_chan[bank][0], job->datrec, t_trace);
+  }
+
+  return 0;
+}
+
+
+/* converts the physical samples in buf and stores them in the datarecord */
+static void pack_channel(int chan, struct gen_job_struct *job, const double *buf)
+{
+  struct sig_par_struct *sp=job->sp;
+
+  if(job->filetype == FILETYPE_BDF)
+  {
+    wavegen_pack_bdf(buf, sp->sf[chan], &sp->quant[chan], job->datrec_buf + sp->datrec_offset[chan]);
+  }
+  else
+  {
+    wavegen_pack_edf(buf, sp->sf[chan], &sp->quant[chan], job->datrec_buf + sp->datrec_offset[chan]);
+  }
+}
+
+
+/* generates all signals of one datarecord into buf */
+int generate_datarecord(struct gen_job_struct *job, int datrec, unsigned char *buf)
+{
+  struct sig_par_struct *sp=job->sp;
+
+  int i, chan;
+
+  long long t_trace;
+
+  double *merge_buf;
+
+  t_trace = trace_time();
+
+  job->datrec = datrec;
+
+  job->datrec_buf = buf;
+
+  tpool_run(job->pool, job->chns + sp->pink_banks, generate_channel_task, job);
+
+  if(job->err)
+  {
+    return -1;
+  }
+
+  if(job->merge_set)
+  {
+    merge_buf = (double *)buf;
+
+    memset(merge_buf, 0, sizeof(double[sp->sf[0]]));
+
+    for(chan=0; chan<job->chns; chan++)
+    {
+      for(i=0; i<sp->sf[chan]; i++)
+      {
+        merge_buf[i] += sp->buf[chan][i];
+      }
+    }
+  }
+
+  trace_span(TRACE_DATAREC, -1, datrec, t_trace);
+
+  return 0;
+}
+
+
+/* generates all signals of one datarecord in the calling thread, */
+/* scratch and merge_buf must be able to hold the samples of the signal with the highest samplerate */
+int generate_datarecord_local(struct gen_job_struct *job, int datrec, unsigned char *buf, double *scratch, double *merge_buf)
+{
+  struct sig_par_struct *sp=job->sp;
+
+  int i, chan;
+
+  long long t,
+            t_trace;
+
+  double *src;
+
+  t_trace = trace_time();
+
+  job->datrec = datrec;
+
+  job->datrec_buf = buf;
+
+  if(job->merge_set)
+  {
+    memset(merge_buf, 0, sizeof(double[sp->sf[0]]));
+  }
+
+  /* the pink noise filters keep their state in sig_par, only one thread can call this when there's pink noise */
+  for(i=0; i<sp->pink_banks; i++)
+  {
+    if(generate_pink_bank(i, job))
+    {
+      return -1;
+    }
+  }
+
+  for(chan=0; chan<job->chns; chan++)
+  {
+    if(sp->waveform[chan] == WAVE_PINK_NOISE)
+    {
+      src = sp->buf[chan];
+    }
+    else
+    {
+      if(generate_channel(chan, job, scratch))
+      {
+        return -1;
+      }
+
+      src = scratch;
+    }
+
+    if(job->merge_set)
+    {
+      for(i=0; i<sp->sf[chan]; i++)
+      {
+        merge_buf[i] += src[i];
+      }
+    }
+  }
+
+  /* same conversion as edfwrite_physical_samples() */
+  if(job->merge_set)
+  {
+    t = stats_lap(0LL, -1);
+
+    pack_channel(0, job, merge_buf);
+
+    stats_lap(t, STATS_QUANT);
+  }
+
+  trace_span(TRACE_DATAREC, -1, datrec, t_trace);
+
+  return 0;
+}
+
+
+int write_datarecord(int hdl, int filetype, int merge_set, unsigned char *buf)
+{
+  if(merge_set)
+  {
+    if(edfwrite_physical_samples(hdl, (double *)buf))
+    {
+      fprintf(stderr, "error: edfwrite_physical_samples() line %i file %s\n", __LINE__, __FILE__);
+      return -1;
+    }
+  }
+  else if(filetype == FILETYPE_BDF)
+    {
+      if(edf_blockwrite_digital_3byte_samples(hdl, buf))
+      {
+        fprintf(stderr, "error: edf_blockwrite_digital_3byte_samples() line %i file %s\n", __LINE__, __FILE__);
+        return -1;
+      }
+    }
+    else
+    {
+      if(edf_blockwrite_digital_2byte_samples(hdl, buf))
+      {
+        fprintf(stderr, "error: edf_blockwrite_digital_2byte_samples() line %i file %s\n", __LINE__, __FILE__);
+        return -1;
+      }
+    }
+
+  return 0;
+}
+
+
+int write_datarecords(int hdl, int filetype, int merge_set, unsigned char *buf, int n)
+{
+  if(merge_set)
+  {
+    if(edf_blockwrite_records_physical_samples(hdl, (double *)buf, n))
+    {
+      fprintf(stderr, "error: edf_blockwrite_records_physical_samples() line %i file %s\n", __LINE__, __FILE__);
+      return -1;
+    }
+  }
+  else if(filetype == FILETYPE_BDF)
+    {
+      if(edf_blockwrite_records_digital_3byte_samples(hdl, buf, n))
+      {
+        fprintf(stderr, "error: edf_blockwrite_records_digital_3byte_samples() line %i file %s\n", __LINE__, __FILE__);
+        return -1;
+      }
+    }
+    else
+    {
+      if(edf_blockwrite_records_digital_2byte_samples(hdl, buf, n))
+      {
+        fprintf(stderr, "error: edf_blockwrite_records_digital_2byte_samples() line %i file %s\n", __LINE__, __FILE__);
+        return -1;
+      }
+    }
+
+  return 0;
+}
+
+
+
+
+
+
+
+
+
+
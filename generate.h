@@ -0,0 +1,156 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#ifndef GENERATE_INCLUDED
+#define GENERATE_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdlib.h>
+
+#include "threadpool.h"
+#include "prng.h"
+#include "pinknoise.h"
+#include "wavegen.h"
+
+
+#define FILETYPE_EDF       (0)
+#define FILETYPE_BDF       (1)
+
+#define WAVE_SINE          (0)
+#define WAVE_SQUARE        (1)
+#define WAVE_RAMP          (2)
+#define WAVE_TRIANGLE      (3)
+#define WAVE_WHITE_NOISE   (4)
+#define WAVE_PINK_NOISE    (5)
+
+#define SIG_PAR_ALIGN     (64)
+
+
+/* The generation of the datarecords of edfgenerator, edfbench links the same code.
+ * The samples of a datarecord are calculated from the datarecord index, the datarecords
+ * can be generated in any order and by multiple threads, except for pink noise.
+ */
+
+/* The parameters are stored as a structure of arrays, one element per signal.
+ * All arrays are allocated in one block by sig_par_alloc() when the number of signals is known,
+ * every array starts at a cacheline. The sample buffers are allocated in one block as well.
+ */
+struct sig_par_struct
+{
+  int *sf;
+  int *digmax;
+  int *digmin;
+  int *waveform;
+
+  double *signalfreq;
+  double *physmax;
+  double *physmin;
+  double *peakamp;
+  double *dutycycle;
+  double *dc_offset;
+  double *phase;
+
+  char (*physdim)[32];
+
+  struct wavegen_quant_struct *quant;
+
+  int *datrec_offset;  /* offset of the signal in the datarecord buffer */
+
+  int *period;  /* number of datarecords after which a periodic signal repeats, 0 if unknown */
+
+  struct prng_struct *prng;  /* noise generator of the signal */
+
+  /* pink noise signals with equal samplerate share a filter bank */
+  int pink_banks;
+
+  struct pinknoise_struct *pink;
+
+  int (*pink_chan)[PINKNOISE_LANES];  /* signal of every lane of a bank */
+
+  double **buf;
+
+  unsigned char *mem;
+
+  unsigned char *buf_mem;
+};
+
+
+/* one datarecord that is being generated by the threadpool */
+struct gen_job_struct
+{
+  int datrec;
+  int chns;
+  int filetype;
+  int merge_set;
+  struct sig_par_struct *sp;
+  struct tpool_struct *pool;
+  unsigned char *datrec_buf;
+  int err;
+};
+
+
+/* assigns the arrays of sp to mem and returns the total size, */
+/* with mem == NULL only the size is calculated */
+size_t sig_par_layout(struct sig_par_struct *sp, unsigned char *mem, int chns);
+
+/* returns the next sz bytes of mem (or NULL if mem is NULL), the position is rounded up to the next cacheline */
+void * sig_par_carve(unsigned char *mem, size_t *pos, size_t sz);
+
+/* groups the pink noise signals with equal samplerate in filter banks, */
+/* the prng of every signal must have been initialized */
+void sig_par_pink_setup(struct sig_par_struct *sp, int chns);
+
+/* generates the pink noise signals of a bank into the buffers of the signals, returns 0 on success */
+int generate_pink_bank(int bank, struct gen_job_struct *job);
+
+/* generates all signals of one datarecord into buf with the threadpool of job, returns 0 on success */
+int generate_datarecord(struct gen_job_struct *job, int datrec, unsigned char *buf);
+
+/* generates all signals of one datarecord in the calling thread, returns 0 on success, */
+/* scratch and merge_buf must be able to hold the samples of the signal with the highest samplerate */
+int generate_datarecord_local(struct gen_job_struct *job, int datrec, unsigned char *buf, double *scratch, double *merge_buf);
+
+/* writes one datarecord that was generated by generate_datarecord() with edflib, returns 0 on success */
+int write_datarecord(int hdl, int filetype, int merge_set, unsigned char *buf);
+
+/* writes n consecutive datarecords with edflib, returns 0 on success */
+int write_datarecords(int hdl, int filetype, int merge_set, unsigned char *buf, int n);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
+
+
@@ -26,6 +26,8 @@
 */
 
 
+#define _GNU_SOURCE  /* O_DIRECT */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -38,69 +40,191 @@
 #include <float.h>
 #include <getopt.h>
 #include <errno.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "edflib.h"
 #include "utils.h"
+#include "wavegen.h"
+#include "threadpool.h"
+#include "ring.h"
+#include "prng.h"
+#include "pinknoise.h"
+#include "writebehind.h"
+#include "stats.h"
+#include "trace.h"
+#include "generate.h"
 
 #define PROGRAM_NAME       "edfgenerator"
 #define PROGRAM_VERSION    "1.10"
 
-#define FILETYPE_EDF       (0)
-#define FILETYPE_BDF       (1)
+#define EDF_MAX_CHNS      (EDFLIB_MAXSIGNALS)
+
+#define RING_DEFAULT_DEPTH  (8)
+
+/* the period of a periodic signal is detected with a resolution of 1e-6 cycles per datarecord */
+#define MEMO_FREQ_DEN     (1000000)
+
+/* maximum size of the datarecords that are generated once and written again and again */
+#define MEMO_MAX_BYTES    (64 * 1024 * 1024)
+
+/* a short period is repeated in the cache until it's at least this size, the cache is written with one call */
+#define MEMO_WRITE_BYTES  (1024 * 1024)
+
+/* size of the buffer of the file, the sequential modes write the datarecords in blocks of this size */
+#define WRITE_BUF_BYTES   (1024 * 1024)
+
+/* size of the chunks in parallel write mode */
+#define CHUNK_BYTES       (4 * 1024 * 1024)
+
+/* number of write-behind buffers in addition to the one that every thread is filling */
+#define WB_DEFAULT_DEPTH  (4)
 
-#define WAVE_SINE          (0)
-#define WAVE_SQUARE        (1)
-#define WAVE_RAMP          (2)
-#define WAVE_TRIANGLE      (3)
-#define WAVE_WHITE_NOISE   (4)
-#define WAVE_PINK_NOISE    (5)
+/* alignment of the file offset, the size and the address of the buffer of a write with O_DIRECT */
+#define DIRECT_ALIGN      (4096)
 
-#define EDF_MAX_CHNS      (16)
+/* maximum number of options on one line of a batch file */
+#define BATCH_MAX_ARGS    (256)
 
 
-struct sig_par_struct
+/* the datarecords of the file are split in chunks, every thread generates */
+/* complete chunks (including the annotations) and writes them with pwrite() */
+struct chunk_job_struct
 {
-  int sf[EDF_MAX_CHNS];
-  int digmax[EDF_MAX_CHNS];
-  int digmin[EDF_MAX_CHNS];
-  int waveform[EDF_MAX_CHNS];
-
-  double w[EDF_MAX_CHNS];
-  double q[EDF_MAX_CHNS];
-  double sine_1[EDF_MAX_CHNS];
-  double square_1[EDF_MAX_CHNS];
-  double triangle_1[EDF_MAX_CHNS];
-  double signalfreq[EDF_MAX_CHNS];
-  double physmax[EDF_MAX_CHNS];
-  double physmin[EDF_MAX_CHNS];
-  double peakamp[EDF_MAX_CHNS];
-  double dutycycle[EDF_MAX_CHNS];
-  double dc_offset[EDF_MAX_CHNS];
-  double phase[EDF_MAX_CHNS];
-
-  double b0[EDF_MAX_CHNS];
-  double b1[EDF_MAX_CHNS];
-  double b2[EDF_MAX_CHNS];
-  double b3[EDF_MAX_CHNS];
-  double b4[EDF_MAX_CHNS];
-  double b5[EDF_MAX_CHNS];
-  double b6[EDF_MAX_CHNS];
-
-  char physdim[EDF_MAX_CHNS][32];
-
-  double *buf[EDF_MAX_CHNS];
-
-  int *randbuf[EDF_MAX_CHNS];
-} sig_par;
+  struct gen_job_struct job;  /* template for the jobs of the threads */
+  int hdl;
+  int datrecs;                /* datarecords in the complete file */
+  int fd;                     /* shard file in part mode, -1 writes into the file of hdl */
+  int mapped;                 /* the datarecords are generated directly into the file mapping of hdl */
+  struct wb_struct *wb;       /* the chunks are written by the write-behind queue */
+  unsigned char *stream;      /* direct I/O: the chunks are generated into this buffer, it starts with datarecord first */
+  int first;                  /* first datarecord */
+  int last;                   /* last datarecord + 1 */
+  int recs;                   /* number of datarecords in a chunk */
+  int recsize;                /* size of a complete datarecord */
+  unsigned char *buf[TPOOL_MAX_THREADS];
+  double *scratch[TPOOL_MAX_THREADS];
+  double *merge_buf[TPOOL_MAX_THREADS];
+  int err;
+};
+
+/* the thread that fills the ring with datarecords */
+struct producer_struct
+{
+  struct gen_job_struct *job;
+  struct ring_struct *ring;
+  int datrecs;
+};
+
+/* The buffers and the threadpool of a file are kept when the file is finished,
+ * the next file of a batch reuses them. The buffers only grow.
+ */
+struct gen_cache_struct
+{
+  int batch;                   /* the file is a job of a batch */
+  int locked;                  /* gen_lock is held */
+  int hdl;                     /* the file that is open, -1 if none */
+  struct tpool_struct *pool;
+  unsigned char *sig_mem;      /* parameters of the signals */
+  size_t sig_mem_sz;
+  unsigned char *buf_mem;      /* sample buffers of the signals */
+  size_t buf_mem_sz;
+  unsigned char *datrec_buf;
+  size_t datrec_buf_sz;
+  unsigned char *memo_buf;
+  size_t memo_buf_sz;
+  char path[1024];             /* path of the file */
+};
+
+/* one line of the batch file */
+struct batch_job_struct
+{
+  char *line;                  /* the options of the file */
+  int line_nr;
+  int err;
+  double seconds;
+  char path[1024];
+};
+
+/* the files of a batch, the threads of the pool take the next job when they finish one */
+struct batch_struct
+{
+  int jobs;
+  struct batch_job_struct *job;
+  struct gen_cache_struct cache[TPOOL_MAX_THREADS];  /* one per thread */
+};
+
+
+/* serializes the parts of a batch job that use global state: option parsing and opening/closing files with edflib */
+static pthread_mutex_t gen_lock=PTHREAD_MUTEX_INITIALIZER;
+
+
+static int generate_file(int, char **, struct gen_cache_struct *);
+static int run_batch(const char *, int, int);
+static void run_batch_task(int, int, void *);
+static void batch_free(struct batch_struct *);
+static unsigned char * cache_buf(unsigned char **, size_t *, size_t);
+static void cache_free(struct gen_cache_struct *);
+static long long batch_time_ns(void);
+static int sig_par_alloc(struct sig_par_struct *, int, struct gen_cache_struct *);
+static int signal_period(double);
+static void * produce_datarecords(void *);
+static void generate_chunk_task(int, int, void *);
+static void run_chunks(struct chunk_job_struct *, int);
+static int write_chunked(struct chunk_job_struct *, int);
+static int chunk_alloc(struct chunk_job_struct *, int, int);
+static int write_part(struct chunk_job_struct *, int, const char *);
+static int write_mapped(struct chunk_job_struct *, int);
+static int write_behind(struct chunk_job_struct *, int, int, int);
+static int write_direct(struct chunk_job_struct *, int, const char *);
+static int pwrite_all(int, const unsigned char *, size_t, long long);
 
 
 int main(int argc, char **argv)
+{
+  int err;
+
+  struct gen_cache_struct cache;
+
+  struct stats_clock_struct t_start;
+
+  stats_clock(&t_start);
+
+  setlocale(LC_ALL, "C");
+
+  setlinebuf(stdout);
+  setlinebuf(stderr);
+
+  memset(&cache, 0, sizeof(struct gen_cache_struct));
+
+  cache.hdl = -1;
+
+  err = generate_file(argc, argv, &cache);
+
+  cache_free(&cache);
+
+  /* in case of a batch, the report and the trace cover all files */
+  if(stats_enabled())
+  {
+    stats_print(stderr, &t_start);
+  }
+
+  if(trace_close())
+  {
+    err = EXIT_FAILURE;
+  }
+
+  return err;
+}
+
+
+/* generates the file described by the options in argv, returns EXIT_SUCCESS or EXIT_FAILURE */
+/* the options are parsed with gen_lock held, if it's still held on return, the caller must unlock it */
+static int generate_file(int argc, char **argv, struct gen_cache_struct *cache)
 {
   int i, j, n, chan,
-      err,
       option_index=0,
       c=0,
-      fd=-1,
       hdl=-1,
       filetype=0,
       duration=30,
@@ -110,38 +234,73 @@ int main(int argc, char **argv)
       datrecs_set=0,
       datrecduration_set=0,
       merge_set=0,
+      precision=WAVEGEN_PRECISION_FAST,
       chns=1,
-      edf_chns=1;
-
-  double datrecduration=1,
-         ftmp,
-         white_noise,
-         *merge_buf=NULL;
+      edf_chns=1,
+      smp_bytes=2,
+      datrec_sz=0,
+      datrec_smps=0,
+      threads=1,
+      ring_depth=RING_DEFAULT_DEPTH,
+      ring_stats=0,
+      memo_set=1,
+      chunk_set=0,
+      memo_period=0,
+      memo_recs=0,
+      seed_set=0,
+      part_k=0,
+      part_n=0,
+      mmap_set=0,
+      wb_backend=-1,
+      direct_set=0,
+      stream_set=0,
+      stats_set=0,
+      err;
+
+  double datrecduration=1;
+
+  unsigned long long seed=0;
+
+  size_t buf_sz=0;
 
   char str[1024]="",
+       part_path[1024]="",
+       file_path[1024]="",
+       output_path[1024]="",
+       batch_path[1024]="",
+       trace_path[1024]="",
        *s_ptr=NULL;
 
+  unsigned char *datrec_buf=NULL,
+                *memo_buf=NULL;
+
   const char waveforms_str[6][16]={"sine", "square", "ramp", "triangle", "white-noise", "pink-noise"};
 
-  setlocale(LC_ALL, "C");
+  struct sig_par_struct sig_par;
 
-  setlinebuf(stdout);
-  setlinebuf(stderr);
+  struct gen_job_struct gen_job;
+
+  struct tpool_struct *pool=NULL;
+
+  struct ring_struct *ring=NULL;
+
+  struct producer_struct producer;
+
+  struct chunk_job_struct chunk_job;
+
+  pthread_t producer_tid;
+
+  struct stats_clock_struct t_parse,
+                            t_close;
+
+  long long t_trace;
 
   memset(&sig_par, 0, sizeof(struct sig_par_struct));
 
-  for(i=0; i<EDF_MAX_CHNS; i++)
+  /* in a batch, the files are generated in parallel and overlap each other's writes */
+  if(cache->batch)
   {
-    sig_par.sf[i] = 500;
-    sig_par.w[i] = 1;
-    sig_par.q[i] = 1;
-    sig_par.signalfreq[i] = 10;
-    sig_par.physmax[i] = 1200;
-    sig_par.physmin[i] = -1200;
-    sig_par.peakamp[i] = 1000;
-    sig_par.dutycycle[i] = 50;
-    sig_par.phase[i] = 0;
-    strlcpy(sig_par.physdim[i], "uV", 32);
+    ring_depth = 0;
   }
 
   struct option long_options[] = {
@@ -164,41 +323,97 @@ int main(int argc, char **argv)
     {"signals",         required_argument, 0, 0},  /* 16 */
     {"merge",           no_argument,       0, 0},  /* 17 */
     {"help",            no_argument,       0, 0},  /* 18 */
+    {"precision",       required_argument, 0, 0},  /* 19 */
+    {"threads",         required_argument, 0, 0},  /* 20 */
+    {"ring-depth",      required_argument, 0, 0},  /* 21 */
+    {"ring-stats",      no_argument,       0, 0},  /* 22 */
+    {"seed",            required_argument, 0, 0},  /* 23 */
+    {"no-memo",         no_argument,       0, 0},  /* 24 */
+    {"parallel-write",  no_argument,       0, 0},  /* 25 */
+    {"part",            required_argument, 0, 0},  /* 26 */
+    {"mmap",            no_argument,       0, 0},  /* 27 */
+    {"async-write",     optional_argument, 0, 0},  /* 28 */
+    {"direct-io",       no_argument,       0, 0},  /* 29 */
+    {"output",          required_argument, 0, 0},  /* 30 */
+    {"batch",           required_argument, 0, 0},  /* 31 */
+    {"stats",           no_argument,       0, 0},  /* 32 */
+    {"trace",           required_argument, 0, 0},  /* 33 */
     {0, 0, 0, 0}
   };
 
+  /* getopt and strtok are not reentrant, the jobs of a batch parse their options one at a time */
+  pthread_mutex_lock(&gen_lock);
+
+  cache->locked = 1;
+
+  stats_clock(&t_parse);  /* --stats is not known yet */
+
+  optind = 0;  /* reinitializes getopt for every file of a batch */
+
   while(1)
   {
     c = getopt_long_only(argc, argv, "", long_options, &option_index);
 
     if(c == -1)  break;
 
-      if(option_index == 16)  /* signals */
+    /* getopt has printed the error, option_index still holds the previous option */
+    if(c != 0)
+    {
+      fprintf(stderr, "--help for help\n");
+      return EXIT_FAILURE;
+    }
+
+    if(option_index == 16)  /* signals */
+    {
+      chns = atoi(optarg);
+      if((chns < 1) || (chns > EDF_MAX_CHNS))
       {
-        chns = atoi(optarg);
-        if((chns < 1) || (chns > EDF_MAX_CHNS))
-        {
-          fprintf(stderr, "illegal value for option %s, must be in the range 1 to %i\n", long_options[option_index].name, EDF_MAX_CHNS);
-          return EXIT_FAILURE;
-        }
-        if(chns == 1)
-        {
-          merge_set = 0;
-        }
+        fprintf(stderr, "illegal value for option %s, must be in the range 1 to %i\n", long_options[option_index].name, EDF_MAX_CHNS);
+        return EXIT_FAILURE;
+      }
+      if(chns == 1)
+      {
+        merge_set = 0;
       }
+    }
   }
 
   optind = 1;
 
+  if(sig_par_alloc(&sig_par, chns, cache))
+  {
+    fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
+    return EXIT_FAILURE;
+  }
+
+  for(i=0; i<chns; i++)
+  {
+    sig_par.sf[i] = 500;
+    sig_par.signalfreq[i] = 10;
+    sig_par.physmax[i] = 1200;
+    sig_par.physmin[i] = -1200;
+    sig_par.peakamp[i] = 1000;
+    sig_par.dutycycle[i] = 50;
+    sig_par.phase[i] = 0;
+    strlcpy(sig_par.physdim[i], "uV", 32);
+  }
+
   while(1)
   {
     c = getopt_long_only(argc, argv, "", long_options, &option_index);
 
     if(c == -1)  break;
 
+    /* getopt has printed the error, option_index still holds the previous option */
+    if(c != 0)
+    {
+      fprintf(stderr, "--help for help\n");
+      return EXIT_FAILURE;
+    }
+
     if(c == 0)
     {
-      if(option_index < 17)
+      if(((option_index < 17) || (option_index > 18)) && (option_index != 22) && (option_index != 24) && (option_index != 25) && (option_index != 27) && (option_index != 28) && (option_index != 29) && (option_index != 32))
       {
         if(optarg == NULL)
         {
@@ -384,6 +599,165 @@ int main(int argc, char **argv)
         }
       }
 
+      if(option_index == 19)  /* precision */
+      {
+        if(cache->batch)
+        {
+          fprintf(stderr, "error: option %s applies to all files of a batch, it must be passed on the command line\n", long_options[option_index].name);
+          return EXIT_FAILURE;
+        }
+
+        if(!strcmp(optarg, "fast"))
+        {
+          precision = WAVEGEN_PRECISION_FAST;
+        }
+        else if(!strcmp(optarg, "exact"))
+          {
+            precision = WAVEGEN_PRECISION_EXACT;
+          }
+          else
+          {
+            fprintf(stderr, "unrecognized value for option %s\n", long_options[option_index].name);
+            return EXIT_FAILURE;
+          }
+      }
+
+      if(option_index == 20)  /* threads */
+      {
+        threads = atoi(optarg);
+        if((threads < 1) || (threads > TPOOL_MAX_THREADS))
+        {
+          fprintf(stderr, "illegal value for option %s, must be in the range 1 to %i\n", long_options[option_index].name, TPOOL_MAX_THREADS);
+          return EXIT_FAILURE;
+        }
+      }
+
+      if(option_index == 21)  /* ring-depth */
+      {
+        ring_depth = atoi(optarg);
+        if((ring_depth < 0) || (ring_depth > RING_MAX_DEPTH))
+        {
+          fprintf(stderr, "illegal value for option %s, must be in the range 0 to %i\n", long_options[option_index].name, RING_MAX_DEPTH);
+          return EXIT_FAILURE;
+        }
+      }
+
+      if(option_index == 22)  /* ring-stats */
+      {
+        ring_stats = 1;
+      }
+
+      if(option_index == 23)  /* seed */
+      {
+        errno = 0;
+        seed = strtoull(optarg, &s_ptr, 0);
+        if(errno || (s_ptr == optarg) || (*s_ptr != 0))
+        {
+          fprintf(stderr, "illegal value for option %s\n", long_options[option_index].name);
+          return EXIT_FAILURE;
+        }
+        seed_set = 1;
+      }
+
+      if(option_index == 24)  /* no-memo */
+      {
+        memo_set = 0;
+      }
+
+      if(option_index == 25)  /* parallel-write */
+      {
+        chunk_set = 1;
+      }
+
+      if(option_index == 26)  /* part */
+      {
+        if((sscanf(optarg, "%i/%i", &part_k, &part_n) != 2) || (part_n < 1) || (part_k < 1) || (part_k > part_n))
+        {
+          fprintf(stderr, "illegal value for option %s, must be k/N with 1 <= k <= N e.g.: --part=3/8\n", long_options[option_index].name);
+          return EXIT_FAILURE;
+        }
+      }
+
+      if(option_index == 27)  /* mmap */
+      {
+        mmap_set = 1;
+      }
+
+      if(option_index == 29)  /* direct-io */
+      {
+        direct_set = 1;
+      }
+
+      if(option_index == 30)  /* output */
+      {
+        if(strlen(optarg) < 1)
+        {
+          fprintf(stderr, "illegal value for option %s\n", long_options[option_index].name);
+          return EXIT_FAILURE;
+        }
+        strlcpy(output_path, optarg, 1024);
+      }
+
+      if(option_index == 31)  /* batch */
+      {
+        if(cache->batch)
+        {
+          fprintf(stderr, "error: option %s can not be used in a batch file\n", long_options[option_index].name);
+          return EXIT_FAILURE;
+        }
+
+        if(strlen(optarg) < 1)
+        {
+          fprintf(stderr, "illegal value for option %s\n", long_options[option_index].name);
+          return EXIT_FAILURE;
+        }
+        strlcpy(batch_path, optarg, 1024);
+      }
+
+      if(option_index == 32)  /* stats */
+      {
+        if(cache->batch)
+        {
+          fprintf(stderr, "error: option %s can not be used in a batch file\n", long_options[option_index].name);
+          return EXIT_FAILURE;
+        }
+
+        stats_set = 1;
+      }
+
+      if(option_index == 33)  /* trace */
+      {
+        if(cache->batch)
+        {
+          fprintf(stderr, "error: option %s can not be used in a batch file\n", long_options[option_index].name);
+          return EXIT_FAILURE;
+        }
+
+        if(strlen(optarg) < 1)
+        {
+          fprintf(stderr, "illegal value for option %s\n", long_options[option_index].name);
+          return EXIT_FAILURE;
+        }
+        strlcpy(trace_path, optarg, 1024);
+      }
+
+      if(option_index == 28)  /* async-write */
+      {
+        if((optarg == NULL) || !strcmp(optarg, "uring"))
+        {
+          wb_backend = WB_BACKEND_URING;
+        }
+        else if(!strcmp(optarg, "threads"))
+          {
+            wb_backend = WB_BACKEND_THREADS;
+          }
+          else
+          {
+            fprintf(stderr, "unrecognized value for option %s\n", long_options[option_index].name);
+            return EXIT_FAILURE;
+          }
+      }
+
       if(option_index == 18)
       {
         fprintf(stdout, "\n EDF generator version " PROGRAM_VERSION
@@ -407,8 +781,43 @@ int main(int argc, char **argv)
           "\n --datrecs=number of datarecords that will be written into the file, has precedence over --len.\n"
           "\n --datrec-duration=duration of a datarecord in seconds default: 1 (may be a real number e.g. 0.25)\n"
           "                   effective samplerate and signal frequency will be inversely proportional to the datarecord duration\n"
-          "\n --signals=number of signals default: 1 in case of multiple signals, signal parameters must be separated by a comma e.g.: --rate=1000,800,133\n"
+          "\n --signals=number of signals (1 - 640) default: 1 in case of multiple signals, signal parameters must be separated by a comma e.g.: --rate=1000,800,133\n"
           "\n --merge  merge all signals into one trace, requires equal samplerate and equal physical max/min and equal digital max/min and equal physical dimension (units) for all signals\n"
+          "\n --threads=number of threads used to generate the signals default: 1\n"
+          "\n --ring-depth=number of datarecords that can be queued between the generator and the writer default: 8\n"
+          "              the generator and the writer run in parallel, 0 generates and writes one datarecord at a time\n"
+          "\n --ring-stats  print how often the generator and the writer had to wait for each other\n"
+          "\n --seed=seed for the white and pink noise generator (0 - 18446744073709551615) default: random\n"
+          "         the same seed and the same options always produce the same file\n"
+          "\n --no-memo  generate every datarecord, by default the datarecords of a file with only periodic signals\n"
+          "            are generated for one period and written again and again\n"
+          "\n --parallel-write  split the file in chunks of datarecords, every thread generates complete chunks\n"
+          "                   and writes them at their position in the file (not used for pink noise)\n"
+          "\n --part=k/N  generate only the k-th of N equal slices of the datarecords, e.g.: --part=3/8\n"
+          "             the datarecords are written without header into <file>.part3of8, the header into <file>.header\n"
+          "             the parts can be generated on different machines and joined with: edfstitch <file> <file>.header <file>.part1of8 ...\n"
+          "             with white or pink noise --seed is required, all parts must use the same seed\n"
+          "\n --mmap  map the file into memory, the threads generate the datarecords directly into the mapping\n"
+          "\n --async-write[=uring|threads]  the threads generate chunks of datarecords into a few buffers that are written\n"
+          "                                in the background with io_uring (falls back to writer threads if not available)\n"
+          "\n --direct-io  write the datarecords with O_DIRECT in large aligned blocks, bypassing the page cache\n"
+          "\n --output=path of the file default: a name derived from the signal parameters\n"
+          "           - writes the file to stdout as a stream (without seeking), e.g.: --output=- | gzip > test.edf.gz\n"
+          "\n --batch=path of a batch file, every line contains the options of one file (lines starting with # are skipped)\n"
+          "          the files are generated in parallel, --threads sets the number of files that are generated at once\n"
+          "          --precision, --stats and --trace apply to all files, the other options on the command line are ignored\n"
+          "          a report with the status and the duration of every file is printed when the batch is finished\n"
+          "\n --stats  print the wall time and the cpu time of every stage (parsing, header, generation per waveform,\n"
+          "          quantization, TAL, write, fflush and close), the number of samples and bytes, the throughput\n"
+          "          and the peak memory usage when the program exits\n"
+          "\n --trace=path of a file that receives a timeline of the generation and the writing of every datarecord\n"
+          "          in Chrome trace-event format (JSON), open it with https://ui.perfetto.dev or chrome://tracing\n"
+          "\n --precision=fast|exact default: fast\n"
+          "              exact: the output of the SIMD waveform kernels is bit-identical to the output of the scalar kernels\n"
+          "              fast: the SIMD waveform kernels may use fused multiply-add (output can differ one LSB)\n"
+          "              the SIMD kernels are used on x86-64 only\n"
+          "              with both settings the phase of every sample is calculated from its index, compared to version 1.10\n"
+          "              samples on the slopes of ramp and triangle can differ one LSB and edges can move one sample\n"
           "\n --help\n\n"
           " Note: decimal separator (if any) must be a dot, do not use a comma as a decimal separator\n\n"
         );
@@ -428,6 +837,55 @@ int main(int argc, char **argv)
     return EXIT_FAILURE;
   }
 
+  cache->locked = 0;
+
+  pthread_mutex_unlock(&gen_lock);
+
+  if(stats_set)
+  {
+    stats_enable();
+  }
+
+  stats_stop(&t_parse, STATS_PARSE);
+
+  if(trace_path[0])
+  {
+    if(trace_open(trace_path, TRACE_DEFAULT_EVENTS))
+    {
+      fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
+      return EXIT_FAILURE;
+    }
+
+    /* the stages of edflib are passed to the trace as well */
+    stats_edf()->trace = trace_edflib;
+  }
+
+  if(batch_path[0])
+  {
+    return run_batch(batch_path, threads, precision);
+  }
+
+  if(!strcmp(output_path, "-"))
+  {
+    if(cache->batch)
+    {
+      fprintf(stderr, "error: a file of a batch can not be written to stdout\n");
+      return EXIT_FAILURE;
+    }
+
+    /* these modes write the datarecords at their position in the file */
+    if(part_n || chunk_set || mmap_set || (wb_backend >= 0) || direct_set)
+    {
+      fprintf(stderr, "error: --output=- can not be combined with --part, --parallel-write, --mmap, --async-write or --direct-io\n");
+      return EXIT_FAILURE;
+    }
+
+    stream_set = 1;
+
+    /* the samples are binary, don't flush at every newline */
+    setvbuf(stdout, NULL, _IOFBF, 1024 * 1024);
+  }
+
   for(chan=0; chan<chns; chan++)
   {
     if(!digmax_set)
@@ -582,27 +1040,55 @@ int main(int argc, char **argv)
     datrecs = duration;
   }
 
-  for(i=0; i<EDF_MAX_CHNS; i++)
+  if(part_n > datrecs)
+  {
+    fprintf(stderr, "error: the number of parts (%i) must not exceed the number of datarecords (%i)\n", part_n, datrecs);
+    return EXIT_FAILURE;
+  }
+
+  /* the parts must continue the same noise streams, a random seed would differ per part */
+  if(part_n && !seed_set)
   {
-    sig_par.buf[i] = NULL;
+    for(i=0; i<chns; i++)
+    {
+      if((sig_par.waveform[i] == WAVE_WHITE_NOISE) || (sig_par.waveform[i] == WAVE_PINK_NOISE))
+      {
+        fprintf(stderr, "error: --part with white or pink noise requires --seed, every part must use the same seed\n");
+        return EXIT_FAILURE;
+      }
+    }
   }
 
+  /* the periodic waveforms are converted to digital samples in small chunks, */
+  /* they don't need a buffer for a complete datarecord */
+  buf_sz = 0;
+
   for(i=0; i<chns; i++)
   {
-    sig_par.buf[i] = (double *)calloc(1, sizeof(double[sig_par.sf[i]]));
-    if(sig_par.buf[i]==NULL)
+    if(merge_set || (sig_par.waveform[i] == WAVE_WHITE_NOISE) || (sig_par.waveform[i] == WAVE_PINK_NOISE))
+    {
+      buf_sz += ((sizeof(double[sig_par.sf[i]]) + SIG_PAR_ALIGN - 1) / SIG_PAR_ALIGN) * SIG_PAR_ALIGN;
+    }
+  }
+
+  if(buf_sz)
+  {
+    sig_par.buf_mem = cache_buf(&cache->buf_mem, &cache->buf_mem_sz, buf_sz);
+    if(sig_par.buf_mem == NULL)
     {
       fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
       return EXIT_FAILURE;
     }
 
-    if((sig_par.waveform[i] == WAVE_WHITE_NOISE) || (sig_par.waveform[i] == WAVE_PINK_NOISE))  /* white or pink noise */
+    memset(sig_par.buf_mem, 0, buf_sz);
+
+    buf_sz = 0;
+
+    for(i=0; i<chns; i++)
     {
-      sig_par.randbuf[i] = (int *)calloc(1, sizeof(int[sig_par.sf[i]]));
-      if(sig_par.randbuf[i]==NULL)
+      if(merge_set || (sig_par.waveform[i] == WAVE_WHITE_NOISE) || (sig_par.waveform[i] == WAVE_PINK_NOISE))
       {
-        fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
-        return EXIT_FAILURE;
+        sig_par.buf[i] = sig_par_carve(sig_par.buf_mem, &buf_sz, sizeof(double[sig_par.sf[i]]));
       }
     }
   }
@@ -641,28 +1127,67 @@ int main(int argc, char **argv)
   if(filetype == FILETYPE_BDF)
   {
     strlcat(str, ".bdf", 1024);
-
-    hdl = edfopen_file_writeonly(str, EDFLIB_FILETYPE_BDFPLUS, edf_chns);
   }
   else if(filetype == FILETYPE_EDF)
     {
       strlcat(str, ".edf", 1024);
-
-      hdl = edfopen_file_writeonly(str, EDFLIB_FILETYPE_EDFPLUS, edf_chns);
     }
 
-  if(hdl<0)
+  if(output_path[0])
   {
-    fprintf(stderr, "error: edfopen_file_writeonly() line %i file %s\n", __LINE__, __FILE__);
-
-    return EXIT_FAILURE;
+    strlcpy(str, output_path, 1024);
   }
 
-  if(datrecduration_set)
+  /* in part mode the file contains only the header, the datarecords go into the shard */
+  if(part_n)
   {
-    if(edf_set_datarecord_duration(hdl, (int)((datrecduration * 100000) + 0.5)))
-    {
-      fprintf(stderr, "error: edf_set_datarecord_duration() line %i file %s\n", __LINE__, __FILE__);
+    snprintf(part_path, 1024, "%s.part%iof%i", str, part_k, part_n);
+
+    strlcat(str, ".header", 1024);
+  }
+
+  strlcpy(file_path, str, 1024);  /* str is reused for the signal labels */
+
+  strlcpy(cache->path, file_path, 1024);
+
+  /* the list of open files of edflib is shared by the jobs of a batch */
+  pthread_mutex_lock(&gen_lock);
+
+  if(filetype == FILETYPE_BDF)
+  {
+    hdl = edfopen_file_writeonly(str, EDFLIB_FILETYPE_BDFPLUS, edf_chns);
+  }
+  else if(filetype == FILETYPE_EDF)
+    {
+      hdl = edfopen_file_writeonly(str, EDFLIB_FILETYPE_EDFPLUS, edf_chns);
+    }
+
+  cache->hdl = hdl;
+
+  pthread_mutex_unlock(&gen_lock);
+
+  if(hdl<0)
+  {
+    fprintf(stderr, "error: edfopen_file_writeonly() line %i file %s\n", __LINE__, __FILE__);
+
+    return EXIT_FAILURE;
+  }
+
+  if(stats_enabled() || trace_enabled())
+  {
+    if(edf_set_write_stats(hdl, stats_edf()))
+    {
+      fprintf(stderr, "error: edf_set_write_stats() line %i file %s\n", __LINE__, __FILE__);
+
+      return EXIT_FAILURE;
+    }
+  }
+
+  if(datrecduration_set)
+  {
+    if(edf_set_datarecord_duration(hdl, (int)((datrecduration * 100000) + 0.5)))
+    {
+      fprintf(stderr, "error: edf_set_datarecord_duration() line %i file %s\n", __LINE__, __FILE__);
 
       return EXIT_FAILURE;
     }
@@ -762,232 +1287,1330 @@ int main(int argc, char **argv)
     }
   }
 
+  /* the kernels are global, in a batch they are selected once for all files */
+  if(!cache->batch)
+  {
+    wavegen_init(precision);
+
+    pinknoise_init();
+  }
+
+  if(filetype == FILETYPE_BDF)
+  {
+    smp_bytes = 3;
+  }
+
   for(i=0; i<chns; i++)
   {
-    sig_par.w[i] = M_PI * 2.0;
+    wavegen_quant_init(&sig_par.quant[i], sig_par.physmax[i], sig_par.physmin[i], sig_par.digmax[i], sig_par.digmin[i]);
+
+    sig_par.datrec_offset[i] = datrec_sz;
+
+    datrec_sz += sig_par.sf[i] * smp_bytes;
+  }
+
+  /* in case of merge, a datarecord is passed to edflib as physical samples */
+  if(merge_set)
+  {
+    datrec_sz = sizeof(double[sig_par.sf[0]]);
+  }
+
+  if(!seed_set)
+  {
+    seed = prng_random_seed();
+  }
 
-    sig_par.q[i] = 1.0 / sig_par.sf[i];
+  /* every signal has its own stream, a signal produces the same noise */
+  /* independent of the number of signals and threads */
+  for(i=0; i<chns; i++)
+  {
+    prng_init(&sig_par.prng[i], seed, i);
+  }
 
-    sig_par.w[i] /= (sig_par.sf[i] / sig_par.signalfreq[i]);
+  sig_par_pink_setup(&sig_par, chns);
 
-    sig_par.sine_1[i] = ((M_PI * 2.0) * sig_par.phase[i]) / 360;
+  /* the threads are created once and reused for every datarecord and for the next file of a batch */
+  if((cache->pool != NULL) && (cache->pool->threads != threads))
+  {
+    tpool_destroy(cache->pool);
 
-    sig_par.square_1[i] = ((1.0 / sig_par.signalfreq[i]) * sig_par.phase[i]) / 360;
+    cache->pool = NULL;
+  }
 
-    sig_par.triangle_1[i] = ((1.0 / sig_par.signalfreq[i]) * sig_par.phase[i]) / 360;
+  if(cache->pool == NULL)
+  {
+    cache->pool = tpool_create(threads);
+    if(cache->pool == NULL)
+    {
+      fprintf(stderr, "error: tpool_create() line %i file %s\n", __LINE__, __FILE__);
+      return EXIT_FAILURE;
+    }
   }
 
+  pool = cache->pool;
+
   for(i=0; i<chns; i++)
   {
-    if((sig_par.waveform[i] == WAVE_WHITE_NOISE) || (sig_par.waveform[i] == WAVE_PINK_NOISE))
+    if(sig_par.waveform[i] <= WAVE_TRIANGLE)
     {
-      fd = open("/dev/urandom", O_RDONLY | O_NONBLOCK);
-      if(fd < 0)
+      sig_par.period[i] = signal_period(sig_par.signalfreq[i]);
+    }
+  }
+
+  if(memo_set)
+  {
+    memo_period = 1;
+
+    for(i=0; i<chns; i++)
+    {
+      if(!sig_par.period[i])
       {
-        fprintf(stderr, "error: cannot open /dev/urandom    line %i file %s\n", __LINE__, __FILE__);
+        memo_period = 0;  /* noise or no exact period */
 
-        return EXIT_FAILURE;
+        break;
       }
 
-      break;
+      if(((long long)(memo_period / t_gcd(memo_period, sig_par.period[i])) * sig_par.period[i]) >= datrecs)
+      {
+        memo_period = 0;  /* the file is shorter than the period */
+
+        break;
+      }
+
+      memo_period = t_lcm(memo_period, sig_par.period[i]);
+    }
+
+    if(((long long)memo_period * datrec_sz) > MEMO_MAX_BYTES)
+    {
+      memo_period = 0;
     }
   }
 
-  if(merge_set)
+  gen_job.chns = chns;
+  gen_job.filetype = filetype;
+  gen_job.merge_set = merge_set;
+  gen_job.sp = &sig_par;
+  gen_job.pool = pool;
+  gen_job.err = 0;
+
+  if(stream_set)
   {
-    merge_buf = malloc(sizeof(double[sig_par.sf[0]]));
-    if(merge_buf == NULL)
+    /* the header is written with the final number of datarecords, edfclose_file() doesn't need to seek back */
+    if(edf_set_stream_mode(hdl, datrecs))
     {
-      fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
+      fprintf(stderr, "error: edf_set_stream_mode() line %i file %s\n", __LINE__, __FILE__);
+      return EXIT_FAILURE;
+    }
+  }
+  else
+  {
+    if(edf_set_write_buffer_size(hdl, WRITE_BUF_BYTES))
+    {
+      fprintf(stderr, "error: edf_set_write_buffer_size() line %i file %s\n", __LINE__, __FILE__);
       return EXIT_FAILURE;
     }
   }
 
-  for(j=0; j<datrecs; j++)
+  /* the modes that generate the file in chunks of datarecords */
+  chunk_job.job = gen_job;
+  chunk_job.hdl = hdl;
+  chunk_job.datrecs = datrecs;
+  chunk_job.fd = -1;
+  chunk_job.mapped = 0;
+  chunk_job.wb = NULL;
+  chunk_job.stream = NULL;
+  chunk_job.first = 0;
+  chunk_job.last = datrecs;
+
+  if(part_n)
   {
-    if(merge_set)
+    /* the slices are generated from the datarecord index, the shards of all parts */
+    /* concatenated are identical to the datarecords of a file that is generated at once */
+    chunk_job.first = ((long long)datrecs * (part_k - 1)) / part_n;
+    chunk_job.last = ((long long)datrecs * part_k) / part_n;
+
+    if(write_part(&chunk_job, threads, part_path))
     {
-      memset(merge_buf, 0, sizeof(double[sig_par.sf[0]]));
+      return EXIT_FAILURE;
     }
+  }
+  else if(mmap_set)
+  {
+    chunk_job.mapped = 1;
 
-    for(chan=0; chan<chns; chan++)
+    if(write_mapped(&chunk_job, threads))
     {
-      if(sig_par.waveform[chan] == WAVE_SINE)
-      {
-        for(i=0; i<sig_par.sf[chan]; i++)
-        {
-          sig_par.buf[chan][i] = (sin(sig_par.sine_1[chan]) * sig_par.peakamp[chan]) + sig_par.dc_offset[chan];
+      return EXIT_FAILURE;
+    }
+  }
+  else if(wb_backend >= 0)
+  {
+    /* the threads generate chunks into the write-behind buffers, the writes are done in the background */
+    if(write_behind(&chunk_job, threads, wb_backend, ring_stats))
+    {
+      return EXIT_FAILURE;
+    }
+  }
+  else if(direct_set)
+  {
+    if(write_direct(&chunk_job, threads, file_path))
+    {
+      return EXIT_FAILURE;
+    }
+  }
+  else if(memo_period)
+  {
+    /* All signals are periodic and the content of the datarecords repeats every memo_period datarecords. */
+    /* Those datarecords are generated once, the rest of the file is written from the cache. */
+    /* The cache holds a whole number of periods, so every write starts at the first datarecord of a period. */
+    memo_recs = memo_period;
+
+    while(((long long)memo_recs * datrec_sz < MEMO_WRITE_BYTES) &&
+          (memo_recs + memo_period <= datrecs) &&
+          ((long long)(memo_recs + memo_period) * datrec_sz <= MEMO_MAX_BYTES))
+    {
+      memo_recs += memo_period;
+    }
 
-          sig_par.sine_1[chan] += sig_par.w[chan];
-        }
-      }
-      else if(sig_par.waveform[chan] == WAVE_SQUARE)
-        {
-          for(i=0; i<sig_par.sf[chan]; i++)
-          {
-            ftmp = fmod(sig_par.square_1[chan], 1.0 / sig_par.signalfreq[chan]);
+    memo_buf = cache_buf(&cache->memo_buf, &cache->memo_buf_sz, (size_t)datrec_sz * memo_recs);
+    if(memo_buf == NULL)
+    {
+      fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
+      return EXIT_FAILURE;
+    }
 
-            if((ftmp * sig_par.signalfreq[chan]) < (sig_par.dutycycle[chan] / 100.0))
-            {
-              sig_par.buf[chan][i] = sig_par.peakamp[chan];
-            }
-            else
-            {
-              sig_par.buf[chan][i] = -sig_par.peakamp[chan];
-            }
-            sig_par.buf[chan][i] += sig_par.dc_offset[chan];
+    for(j=0; j<memo_period; j++)
+    {
+      if(generate_datarecord(&gen_job, j, memo_buf + ((size_t)datrec_sz * j)))
+      {
+        return EXIT_FAILURE;
+      }
+    }
 
-            sig_par.square_1[chan] += sig_par.q[chan];
-          }
-        }
-        else if(sig_par.waveform[chan] == WAVE_RAMP)
-          {
-            for(i=0; i<sig_par.sf[chan]; i++)
-            {
-              ftmp = fmod(sig_par.triangle_1[chan], 1.0 / sig_par.signalfreq[chan]);
+    for(j=memo_period; j<memo_recs; j+=memo_period)
+    {
+      memcpy(memo_buf + ((size_t)datrec_sz * j), memo_buf, (size_t)datrec_sz * memo_period);
+    }
 
-              if((ftmp * sig_par.signalfreq[chan]) < (sig_par.dutycycle[chan] / 100.0))
-              {
-                sig_par.buf[chan][i] = sig_par.peakamp[chan] * (200.0 / sig_par.dutycycle[chan]) * ftmp * sig_par.signalfreq[chan] - sig_par.peakamp[chan];
-              }
-              else
-              {
-                sig_par.buf[chan][i] = -sig_par.peakamp[chan];
-              }
-              sig_par.buf[chan][i] += sig_par.dc_offset[chan];
+    for(j=0; j<datrecs; j+=memo_recs)
+    {
+      n = datrecs - j;
 
-              sig_par.triangle_1[chan] += sig_par.q[chan];
-            }
-          }
-          else if(sig_par.waveform[chan] == WAVE_TRIANGLE)
-            {
-              for(i=0; i<sig_par.sf[chan]; i++)
-              {
-                ftmp = fmod(sig_par.triangle_1[chan], 1.0 / sig_par.signalfreq[chan]);
+      if(n > memo_recs)
+      {
+        n = memo_recs;
+      }
 
-                if((ftmp * sig_par.signalfreq[chan]) < (sig_par.dutycycle[chan] / 200.0))
-                {
-                  sig_par.buf[chan][i] = sig_par.peakamp[chan] * (400.0 / sig_par.dutycycle[chan]) * ftmp * sig_par.signalfreq[chan] - sig_par.peakamp[chan];
-                  sig_par.buf[chan][i] += sig_par.dc_offset[chan];
-                }
-                else if((ftmp * sig_par.signalfreq[chan]) < (sig_par.dutycycle[chan] / 100.0))
-                  {
-                    sig_par.buf[chan][i] = sig_par.peakamp[chan] * (400.0 / sig_par.dutycycle[chan]) * ((sig_par.dutycycle[chan] / 100.0) - (ftmp * sig_par.signalfreq[chan])) - sig_par.peakamp[chan];
-                  }
-                  else
-                  {
-                    sig_par.buf[chan][i] = -sig_par.peakamp[chan];
-                  }
-                  sig_par.buf[chan][i] += sig_par.dc_offset[chan];
-
-                  sig_par.triangle_1[chan] += sig_par.q[chan];
-              }
-            }
-            else if((sig_par.waveform[chan] == WAVE_WHITE_NOISE) || (sig_par.waveform[chan] == WAVE_PINK_NOISE))
-              {
-                err = read(fd, sig_par.randbuf[chan], sizeof(int[sig_par.sf[chan]]));
-                if(err != (sig_par.sf[chan] * 4))
-                {
-                  perror(NULL);
-                  fprintf(stderr, "error: read() returned %i   line %i\n", err, __LINE__);
+      if(write_datarecords(hdl, filetype, merge_set, memo_buf, n))
+      {
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  else if(chunk_set && !sig_par.pink_banks)
+  {
+    /* the pink noise filter is a recursion over the whole file, it can't be split in chunks */
+    if(write_chunked(&chunk_job, threads))
+    {
+      return EXIT_FAILURE;
+    }
+  }
+  else if(ring_depth)
+  {
+    /* A separate thread generates the datarecords into the ring, */
+    /* this thread takes them out of the ring and writes them into the file. */
+    /* Generation and writing overlap, the ring absorbs the variations in disk latency. */
+    ring = ring_create(ring_depth, datrec_sz);
+    if(ring == NULL)
+    {
+      fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
+      return EXIT_FAILURE;
+    }
 
-                  return EXIT_FAILURE;
-                }
+    producer.job = &gen_job;
+    producer.ring = ring;
+    producer.datrecs = datrecs;
 
-                if(sig_par.waveform[chan] == WAVE_WHITE_NOISE)
-                {
-                  for(i=0; i<sig_par.sf[chan]; i++)
-                  {
-                    sig_par.buf[chan][i] = (sig_par.randbuf[chan][i] % ((int)(sig_par.peakamp[chan] * 100.0))) / 100.0;
-                    sig_par.buf[chan][i] += sig_par.dc_offset[chan];
-                  }
-                }
-                else if(sig_par.waveform[chan] == WAVE_PINK_NOISE)
-                  {
-  /* This is an approximation to a -10dB/decade (-3dB/octave) filter using a weighted sum
-   * of first order filters. It is accurate to within +/-0.05dB above 9.2Hz
-   * (44100Hz sampling rate). Unity gain is at Nyquist, but can be adjusted
-   * by scaling the numbers at the end of each line.
-   * http://www.firstpr.com.au/dsp/pink-noise/
-   */
-                    for(i=0; i<sig_par.sf[chan]; i++)
-                    {
-                      white_noise = (sig_par.randbuf[chan][i] % ((int)(sig_par.peakamp[chan] * 100.0))) / 600.0;
-                      sig_par.b0[chan] = 0.99886 * sig_par.b0[chan] + white_noise * 0.0555179;
-                      sig_par.b1[chan] = 0.99332 * sig_par.b1[chan] + white_noise * 0.0750759;
-                      sig_par.b2[chan] = 0.96900 * sig_par.b2[chan] + white_noise * 0.1538520;
-                      sig_par.b3[chan] = 0.86650 * sig_par.b3[chan] + white_noise * 0.3104856;
-                      sig_par.b4[chan] = 0.55000 * sig_par.b4[chan] + white_noise * 0.5329522;
-                      sig_par.b5[chan] = -0.7616 * sig_par.b5[chan] - white_noise * 0.0168980;
-                      sig_par.buf[chan][i] = sig_par.b0[chan] + sig_par.b1[chan] + sig_par.b2[chan] + sig_par.b3[chan] + sig_par.b4[chan] + sig_par.b5[chan] + sig_par.b6[chan] + white_noise * 0.5362;
-                      sig_par.buf[chan][i] += sig_par.dc_offset[chan];
-                      sig_par.b6[chan] = white_noise * 0.115926;
-                    }
-                  }
-              }
+    if(pthread_create(&producer_tid, NULL, produce_datarecords, &producer))
+    {
+      fprintf(stderr, "error: pthread_create() line %i file %s\n", __LINE__, __FILE__);
+      ring_destroy(ring);
+      return EXIT_FAILURE;
+    }
 
-      if(merge_set)
+    for(j=0; ; j++)
+    {
+      datrec_buf = ring_read_slot(ring);
+      if(datrec_buf == NULL)
       {
-        for(i=0; i<sig_par.sf[chan]; i++)
-        {
-          merge_buf[i] += sig_par.buf[chan][i];
-        }
+        break;
       }
-      else
+
+      if(write_datarecord(hdl, filetype, merge_set, datrec_buf))
       {
-        if(edfwrite_physical_samples(hdl, sig_par.buf[chan]))
-        {
-          fprintf(stderr, "error: edfwrite_physical_samples() line %i file %s\n", __LINE__, __FILE__);
-          return EXIT_FAILURE;
-        }
+        ring_abort(ring);
+
+        break;
       }
+
+      ring_read_commit(ring);
     }
 
-    if(merge_set)
+    pthread_join(producer_tid, NULL);
+
+    datrec_buf = NULL;
+
+    if((j != datrecs) || gen_job.err)
+    {
+      ring_destroy(ring);
+      return EXIT_FAILURE;
+    }
+
+    if(ring_stats)
+    {
+      fprintf(stderr, "ring depth: %i datarecords\n"
+                      "generator stalls (ring full, writer is the bottleneck): %lli  %.3f sec.\n"
+                      "writer stalls (ring empty, generator is the bottleneck): %lli  %.3f sec.\n",
+              ring_depth,
+              ring->producer_stalls, ring->producer_stall_ns / 1e9,
+              ring->consumer_stalls, ring->consumer_stall_ns / 1e9);
+    }
+
+    ring_destroy(ring);
+  }
+  else
+  {
+    datrec_buf = cache_buf(&cache->datrec_buf, &cache->datrec_buf_sz, datrec_sz);
+    if(datrec_buf == NULL)
+    {
+      fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
+      return EXIT_FAILURE;
+    }
+
+    for(j=0; j<datrecs; j++)
     {
-      if(edfwrite_physical_samples(hdl, merge_buf))
+      if(generate_datarecord(&gen_job, j, datrec_buf))
+      {
+        return EXIT_FAILURE;
+      }
+
+      if(write_datarecord(hdl, filetype, merge_set, datrec_buf))
       {
-        fprintf(stderr, "error: edfwrite_physical_samples() line %i file %s\n", __LINE__, __FILE__);
         return EXIT_FAILURE;
       }
     }
   }
 
-  if(fd >= 0)
+  if(stats_enabled())
   {
-    close(fd);
+    /* the samples and the size of the file (in part mode the header and the shard) */
+    n = chunk_job.last - chunk_job.first;
+
+    datrec_smps = 0;
+
+    for(i=0; i<edf_chns; i++)
+    {
+      datrec_smps += sig_par.sf[i];
+    }
+
+    stats_count((long long)n * datrec_smps, edf_get_datarecord_offset(hdl, 0) + ((long long)n * edf_get_datarecord_size(hdl)));
   }
 
-  edfclose_file(hdl);
+  pthread_mutex_lock(&gen_lock);
 
-  for(i=0; i<chns; i++)
+  stats_start(&t_close);
+
+  t_trace = trace_time();
+
+  err = edfclose_file(hdl);
+
+  trace_span(TRACE_CLOSE, -1, -1LL, t_trace);
+
+  stats_stop(&t_close, STATS_CLOSE);
+
+  cache->hdl = -1;
+
+  pthread_mutex_unlock(&gen_lock);
+
+  if(err)
   {
-    free(sig_par.buf[i]);
-    free(sig_par.randbuf[i]);
+    fprintf(stderr, "error: edfclose_file() line %i file %s\n", __LINE__, __FILE__);
+    return EXIT_FAILURE;
   }
-  free(merge_buf);
 
   return EXIT_SUCCESS;
 }
 
 
+/* Generates the files of the batch file at path, every line holds the options of one file.
+ * Empty lines and lines that start with # are skipped.
+ * The files are generated in parallel by threads threads, every thread keeps its buffers for the next file.
+ */
+static int run_batch(const char *path, int threads, int precision)
+{
+  int i, line_nr=0, failed=0, err=0;
+
+  size_t line_sz=0;
+
+  long long t0;
+
+  char *line=NULL,
+       *s_ptr;
+
+  FILE *f;
 
+  struct batch_struct *batch;
 
+  struct batch_job_struct *job;
 
+  struct tpool_struct *pool;
 
+  batch = (struct batch_struct *)calloc(1, sizeof(struct batch_struct));
+  if(batch == NULL)
+  {
+    fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
+    return EXIT_FAILURE;
+  }
+
+  f = fopen(path, "rb");
+  if(f == NULL)
+  {
+    fprintf(stderr, "error: can not open batch file %s\n", path);
+    free(batch);
+    return EXIT_FAILURE;
+  }
+
+  while(getline(&line, &line_sz, f) != -1)
+  {
+    line_nr++;
+
+    for(s_ptr=line; (*s_ptr == ' ') || (*s_ptr == '\t'); s_ptr++);
+
+    if((*s_ptr == '#') || (*s_ptr == '\n') || (*s_ptr == '\r') || (*s_ptr == 0))
+    {
+      continue;
+    }
 
+    if(!(batch->jobs % 64))
+    {
+      job = (struct batch_job_struct *)realloc(batch->job, sizeof(struct batch_job_struct[batch->jobs + 64]));
+      if(job == NULL)
+      {
+        err = 1;
+        break;
+      }
 
+      batch->job = job;
+    }
 
+    memset(&batch->job[batch->jobs], 0, sizeof(struct batch_job_struct));
 
+    batch->job[batch->jobs].line = strdup(s_ptr);
+    if(batch->job[batch->jobs].line == NULL)
+    {
+      err = 1;
+      break;
+    }
 
+    batch->job[batch->jobs++].line_nr = line_nr;
+  }
 
+  free(line);
 
+  fclose(f);
 
+  if(err)
+  {
+    fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
+    batch_free(batch);
+    return EXIT_FAILURE;
+  }
 
+  if(!batch->jobs)
+  {
+    fprintf(stderr, "error: no files in batch file %s\n", path);
+    batch_free(batch);
+    return EXIT_FAILURE;
+  }
 
+  wavegen_init(precision);
 
+  pinknoise_init();
 
+  for(i=0; i<TPOOL_MAX_THREADS; i++)
+  {
+    batch->cache[i].batch = 1;
 
+    batch->cache[i].hdl = -1;
+  }
 
+  if(threads > batch->jobs)
+  {
+    threads = batch->jobs;
+  }
 
+  /* the jobs are claimed one at a time, a thread that finishes a small file */
+  /* takes the next job while the other threads are still busy with large files */
+  pool = tpool_create(threads);
+  if(pool == NULL)
+  {
+    fprintf(stderr, "error: tpool_create() line %i file %s\n", __LINE__, __FILE__);
+    batch_free(batch);
+    return EXIT_FAILURE;
+  }
+
+  t0 = batch_time_ns();
+
+  tpool_run(pool, batch->jobs, run_batch_task, batch);
+
+  tpool_destroy(pool);
+
+  for(i=0; i<TPOOL_MAX_THREADS; i++)
+  {
+    cache_free(&batch->cache[i]);
+  }
+
+  for(i=0; i<batch->jobs; i++)
+  {
+    fprintf(stdout, "line %4i: %-6s  %8.3f sec.  %s\n",
+            batch->job[i].line_nr, batch->job[i].err ? "FAILED" : "ok", batch->job[i].seconds, batch->job[i].path);
+
+    if(batch->job[i].err)
+    {
+      failed++;
+    }
+  }
+
+  fprintf(stdout, "%i files generated, %i failed, %.3f sec.\n", batch->jobs - failed, failed, (batch_time_ns() - t0) / 1e9);
+
+  batch_free(batch);
+
+  if(failed)
+  {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+/* generates the file of one line of the batch file, called by the threads of the pool */
+static void run_batch_task(int task, int thread, void *arg)
+{
+  int argc=1;
+
+  long long t0;
+
+  char *argv[BATCH_MAX_ARGS + 1],
+       *s_ptr,
+       *save_ptr=NULL;
+
+  struct batch_struct *batch;
+
+  struct batch_job_struct *job;
+
+  struct gen_cache_struct *cache;
+
+  batch = (struct batch_struct *)arg;
+
+  job = &batch->job[task];
+
+  cache = &batch->cache[thread];
+
+  t0 = batch_time_ns();
+
+  argv[0] = PROGRAM_NAME;
+
+  for(s_ptr=strtok_r(job->line, " \t\r\n", &save_ptr); s_ptr!=NULL; s_ptr=strtok_r(NULL, " \t\r\n", &save_ptr))
+  {
+    if(argc == BATCH_MAX_ARGS)
+    {
+      fprintf(stderr, "error: batch file line %i: more than %i options\n", job->line_nr, BATCH_MAX_ARGS - 1);
+      job->err = 1;
+      return;
+    }
+
+    argv[argc++] = s_ptr;
+  }
+
+  argv[argc] = NULL;
+
+  cache->path[0] = 0;
+
+  if(generate_file(argc, argv, cache) != EXIT_SUCCESS)
+  {
+    fprintf(stderr, "error: batch file line %i: the file could not be generated\n", job->line_nr);
+
+    job->err = 1;
+  }
+
+  if(cache->locked)
+  {
+    cache->locked = 0;
+
+    pthread_mutex_unlock(&gen_lock);
+  }
+
+  /* a file that failed halfway is closed, the file slot of edflib is needed for the next job */
+  if(cache->hdl >= 0)
+  {
+    pthread_mutex_lock(&gen_lock);
+
+    edfclose_file(cache->hdl);
+
+    cache->hdl = -1;
+
+    pthread_mutex_unlock(&gen_lock);
+  }
+
+  strlcpy(job->path, cache->path, 1024);
+
+  job->seconds = (batch_time_ns() - t0) / 1e9;
+}
+
+
+/* returns a buffer of at least sz bytes aligned to a cacheline, the buffer is reused if it's large enough */
+static unsigned char * cache_buf(unsigned char **buf, size_t *buf_sz, size_t sz)
+{
+  if(*buf_sz >= sz)
+  {
+    return *buf;
+  }
+
+  free(*buf);
+
+  *buf_sz = 0;
+
+  if(posix_memalign((void **)buf, SIG_PAR_ALIGN, sz))
+  {
+    *buf = NULL;
+
+    return NULL;
+  }
+
+  *buf_sz = sz;
+
+  return *buf;
+}
+
+
+/* frees the lines of the jobs, the jobs and the batch */
+static void batch_free(struct batch_struct *batch)
+{
+  int i;
+
+  for(i=0; i<batch->jobs; i++)
+  {
+    free(batch->job[i].line);
+  }
+
+  free(batch->job);
+  free(batch);
+}
+
+
+static void cache_free(struct gen_cache_struct *cache)
+{
+  if(cache->pool != NULL)
+  {
+    tpool_destroy(cache->pool);
+
+    cache->pool = NULL;
+  }
+
+  free(cache->sig_mem);
+  free(cache->buf_mem);
+  free(cache->datrec_buf);
+  free(cache->memo_buf);
+
+  cache->sig_mem = NULL;
+  cache->buf_mem = NULL;
+  cache->datrec_buf = NULL;
+  cache->memo_buf = NULL;
+
+  cache->sig_mem_sz = 0;
+  cache->buf_mem_sz = 0;
+  cache->datrec_buf_sz = 0;
+  cache->memo_buf_sz = 0;
+}
+
+
+static long long batch_time_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+
+static void * produce_datarecords(void *arg)
+{
+  int j;
+
+  unsigned char *buf;
+
+  struct producer_struct *producer;
+
+  producer = (struct producer_struct *)arg;
+
+  for(j=0; j<producer->datrecs; j++)
+  {
+    buf = ring_write_slot(producer->ring);
+    if(buf == NULL)
+    {
+      break;  /* the writer gave up */
+    }
+
+    if(generate_datarecord(producer->job, j, buf))
+    {
+      break;
+    }
+
+    ring_write_commit(producer->ring);
+  }
+
+  ring_close(producer->ring);
+
+  return NULL;
+}
+
+
+/* allocates the parameter arrays for chns signals, returns 0 on success */
+static int sig_par_alloc(struct sig_par_struct *sp, int chns, struct gen_cache_struct *cache)
+{
+  size_t sz;
+
+  sz = sig_par_layout(sp, NULL, chns);
+
+  sp->mem = cache_buf(&cache->sig_mem, &cache->sig_mem_sz, sz);
+  if(sp->mem == NULL)
+  {
+    return -1;
+  }
+
+  memset(sp->mem, 0, sz);
+
+  sig_par_layout(sp, sp->mem, chns);
+
+  return 0;
+}
+
+
+/* Returns the number of datarecords after which the phase of a periodic signal repeats exactly.
+ * The signal frequency is expressed in cycles per datarecord, when it's a multiple of 1 / MEMO_FREQ_DEN,
+ * the period is MEMO_FREQ_DEN / gcd(fraction * MEMO_FREQ_DEN, MEMO_FREQ_DEN).
+ * Returns 0 if the frequency has more decimals.
+ */
+static int signal_period(double signalfreq)
+{
+  int num;
+
+  double frac;
+
+  frac = (signalfreq - floor(signalfreq)) * MEMO_FREQ_DEN;
+
+  num = nearbyint(frac);
+
+  if(fabs(frac - num) > 1e-3)
+  {
+    return 0;
+  }
+
+  if(num >= MEMO_FREQ_DEN)
+  {
+    num = 0;
+  }
+
+  return MEMO_FREQ_DEN / t_gcd(num, MEMO_FREQ_DEN);
+}
+
+
+static void generate_chunk_task(int task, int thread, void *arg)
+{
+  int i, n, first;
+
+  unsigned char *ptr;
+
+  struct chunk_job_struct *chunk;
+
+  struct gen_job_struct job;
+
+  chunk = (struct chunk_job_struct *)arg;
+
+  job = chunk->job;
+
+  first = chunk->first + (task * chunk->recs);
+
+  n = chunk->last - first;
+
+  if(n > chunk->recs)
+  {
+    n = chunk->recs;
+  }
+
+  if(chunk->mapped)
+  {
+    ptr = edf_get_datarecord_ptr(chunk->hdl, first);
+  }
+  else if(chunk->stream != NULL)
+    {
+      ptr = chunk->stream + ((size_t)chunk->recsize * (first - chunk->first));
+    }
+    else if(chunk->wb != NULL)
+      {
+        /* waits when all buffers are in flight, the amount of memory is bounded */
+        ptr = wb_get_buf(chunk->wb);
+        if(ptr == NULL)
+        {
+          __atomic_store_n(&chunk->err, 1, __ATOMIC_RELAXED);
+
+          return;
+        }
+      }
+      else
+      {
+        ptr = chunk->buf[thread];
+      }
+
+  for(i=0; i<n; i++)
+  {
+    if(generate_datarecord_local(&job, first + i, ptr + ((size_t)chunk->recsize * i), chunk->scratch[thread], chunk->merge_buf[thread]))
+    {
+      __atomic_store_n(&chunk->err, 1, __ATOMIC_RELAXED);
+
+      if(chunk->wb != NULL)
+      {
+        /* the buffer is not submitted, the threads waiting for a buffer must not wait forever */
+        wb_abort(chunk->wb, ptr);
+      }
+
+      return;
+    }
+
+    edf_fill_datarecord_annotations(chunk->hdl, first + i, ptr + ((size_t)chunk->recsize * i));
+  }
+
+  if(chunk->mapped)
+  {
+    /* the chunk is complete, let the kernel write it back instead of accumulating dirty pages */
+    if(edf_msync_datarecords(chunk->hdl, first, n, 0))
+    {
+      fprintf(stderr, "error: edf_msync_datarecords() line %i file %s\n", __LINE__, __FILE__);
+
+      __atomic_store_n(&chunk->err, 1, __ATOMIC_RELAXED);
+    }
+
+    return;
+  }
+
+  if(chunk->stream != NULL)
+  {
+    return;  /* written by write_direct() */
+  }
+
+  if(chunk->wb != NULL)
+  {
+    if(wb_submit(chunk->wb, ptr, (size_t)chunk->recsize * n, edf_get_datarecord_offset(chunk->hdl, first)))
+    {
+      fprintf(stderr, "error: write-behind failed line %i file %s\n", __LINE__, __FILE__);
+
+      __atomic_store_n(&chunk->err, 1, __ATOMIC_RELAXED);
+    }
+
+    return;
+  }
+
+  if(chunk->fd < 0)
+  {
+    if(edf_pwrite_datarecords(chunk->hdl, first, n, chunk->buf[thread]))
+    {
+      fprintf(stderr, "error: edf_pwrite_datarecords() line %i file %s\n", __LINE__, __FILE__);
+
+      __atomic_store_n(&chunk->err, 1, __ATOMIC_RELAXED);
+    }
+
+    return;
+  }
+
+  /* the shard has no header, it starts with the first datarecord of the part */
+  if(pwrite_all(chunk->fd, ptr, (size_t)chunk->recsize * n, (long long)chunk->recsize * (first - chunk->first)))
+  {
+    fprintf(stderr, "error: pwrite() line %i file %s\n", __LINE__, __FILE__);
+
+    __atomic_store_n(&chunk->err, 1, __ATOMIC_RELAXED);
+  }
+}
+
+
+/* generates the chunks from first to last with the threadpool, */
+/* with pink noise the chunks are generated in order by the calling thread */
+static void run_chunks(struct chunk_job_struct *chunk, int tasks)
+{
+  int i;
+
+  if(!chunk->job.sp->pink_banks)
+  {
+    tpool_run(chunk->job.pool, tasks, generate_chunk_task, chunk);
+  }
+  else
+  {
+    /* the pink noise filter is a recursion over the whole file, the chunks must be generated in order */
+    for(i=0; i<tasks; i++)
+    {
+      generate_chunk_task(i, 0, chunk);
+    }
+  }
+}
+
+
+/* Writes the header with the final number of datarecords and generates and writes the file in chunks. */
+/* The datarecords are generated from their index, the file is identical to a sequentially written file. */
+static int write_chunked(struct chunk_job_struct *chunk, int threads)
+{
+  int err;
+
+  err = edf_write_header_for_datarecords(chunk->hdl, chunk->datrecs);
+  if(err)
+  {
+    fprintf(stderr, "error: edf_write_header_for_datarecords() returned %i line %i file %s\n", err, __LINE__, __FILE__);
+    return -1;
+  }
+
+  if(chunk_alloc(chunk, threads, 1))
+  {
+    return -1;
+  }
+
+  chunk->err = 0;
+
+  tpool_run(chunk->job.pool, (chunk->last - chunk->first + chunk->recs - 1) / chunk->recs, generate_chunk_task, chunk);
+
+  free(chunk->buf[0]);
+
+  if(chunk->err)
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* sets the number of datarecords per chunk and allocates the buffers of the threads in one block, */
+/* with_buf adds a buffer for the datarecords of a chunk, the block must be freed with free(chunk->buf[0]) */
+static int chunk_alloc(struct chunk_job_struct *chunk, int threads, int with_buf)
+{
+  struct sig_par_struct *sp=chunk->job.sp;
+
+  int i,
+      max_sf=1;
+
+  size_t chunk_sz,
+         scratch_sz;
+
+  unsigned char *mem;
+
+  chunk->recsize = edf_get_datarecord_size(chunk->hdl);
+
+  chunk->recs = CHUNK_BYTES / chunk->recsize;
+
+  if(chunk->recs < 1)
+  {
+    chunk->recs = 1;
+  }
+
+  if(chunk->recs > (chunk->last - chunk->first))
+  {
+    chunk->recs = chunk->last - chunk->first;
+  }
+
+  for(i=0; i<chunk->job.chns; i++)
+  {
+    if(sp->sf[i] > max_sf)
+    {
+      max_sf = sp->sf[i];
+    }
+  }
+
+  chunk_sz = (((size_t)chunk->recsize * chunk->recs + SIG_PAR_ALIGN - 1) / SIG_PAR_ALIGN) * SIG_PAR_ALIGN;
+
+  if(!with_buf)
+  {
+    chunk_sz = 0;  /* the datarecords are generated in the mapping or in a write-behind buffer */
+  }
+
+  scratch_sz = ((sizeof(double[max_sf]) + SIG_PAR_ALIGN - 1) / SIG_PAR_ALIGN) * SIG_PAR_ALIGN;
+
+  if(posix_memalign((void **)&mem, SIG_PAR_ALIGN, (chunk_sz + (scratch_sz * 2)) * threads))
+  {
+    fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
+    return -1;
+  }
+
+  for(i=0; i<threads; i++)
+  {
+    chunk->buf[i] = mem + ((chunk_sz + (scratch_sz * 2)) * i);
+
+    chunk->scratch[i] = (double *)(chunk->buf[i] + chunk_sz);
+
+    chunk->merge_buf[i] = (double *)(chunk->buf[i] + chunk_sz + scratch_sz);
+  }
+
+  return 0;
+}
+
+
+/* Writes the header of the complete file and generates the datarecords first ... last - 1 into a shard without header. */
+/* Every part writes the same header, the header and the shards of all parts are joined by edfstitch. */
+static int write_part(struct chunk_job_struct *chunk, int threads, const char *shard_path)
+{
+  struct sig_par_struct *sp=chunk->job.sp;
+
+  int i, j, err, tasks;
+
+  err = edf_write_header_only(chunk->hdl, chunk->datrecs);
+  if(err)
+  {
+    fprintf(stderr, "error: edf_write_header_only() returned %i line %i file %s\n", err, __LINE__, __FILE__);
+    return -1;
+  }
+
+  if(chunk_alloc(chunk, threads, 1))
+  {
+    return -1;
+  }
+
+  chunk->fd = open(shard_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(chunk->fd < 0)
+  {
+    fprintf(stderr, "error: can not create file %s line %i file %s\n", shard_path, __LINE__, __FILE__);
+    free(chunk->buf[0]);
+    return -1;
+  }
+
+  chunk->err = 0;
+
+  tasks = (chunk->last - chunk->first + chunk->recs - 1) / chunk->recs;
+
+  /* The pink noise filter is a recursion over the whole file. */
+  /* Run the filters over the preceding datarecords to get the same state as a complete file. */
+  if(sp->pink_banks)
+  {
+    chunk->job.datrec_buf = chunk->buf[0];
+
+    for(j=0; j<chunk->first; j++)
+    {
+      chunk->job.datrec = j;
+
+      for(i=0; i<sp->pink_banks; i++)
+      {
+        generate_pink_bank(i, &chunk->job);
+      }
+    }
+  }
+
+  run_chunks(chunk, tasks);
+
+  if(close(chunk->fd))
+  {
+    chunk->err = 1;
+  }
+
+  free(chunk->buf[0]);
+
+  if(chunk->err)
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* Maps the file into memory and generates the datarecords in chunks directly into the mapping. */
+/* There is no copy into a write buffer and no system call per datarecord. */
+static int write_mapped(struct chunk_job_struct *chunk, int threads)
+{
+  int err, tasks;
+
+  err = edf_map_datarecords(chunk->hdl, chunk->datrecs);
+  if(err)
+  {
+    fprintf(stderr, "error: edf_map_datarecords() returned %i line %i file %s\n", err, __LINE__, __FILE__);
+    return -1;
+  }
+
+  if(chunk_alloc(chunk, threads, 0))
+  {
+    return -1;
+  }
+
+  chunk->err = 0;
+
+  tasks = (chunk->last - chunk->first + chunk->recs - 1) / chunk->recs;
+
+  run_chunks(chunk, tasks);
+
+  free(chunk->buf[0]);
+
+  if(chunk->err)
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* Writes the header with the final number of datarecords, the threads generate the chunks into write-behind buffers. */
+/* The generation doesn't wait for the disk unless all buffers are in flight. */
+static int write_behind(struct chunk_job_struct *chunk, int threads, int backend, int stats)
+{
+  int err, tasks;
+
+  err = edf_write_header_for_datarecords(chunk->hdl, chunk->datrecs);
+  if(err)
+  {
+    fprintf(stderr, "error: edf_write_header_for_datarecords() returned %i line %i file %s\n", err, __LINE__, __FILE__);
+    return -1;
+  }
+
+  if(chunk_alloc(chunk, threads, 0))
+  {
+    return -1;
+  }
+
+  chunk->wb = wb_create(edf_get_file_descriptor(chunk->hdl), threads + WB_DEFAULT_DEPTH, (size_t)chunk->recsize * chunk->recs, backend);
+  if(chunk->wb == NULL)
+  {
+    fprintf(stderr, "error: wb_create() line %i file %s\n", __LINE__, __FILE__);
+    free(chunk->buf[0]);
+    return -1;
+  }
+
+  chunk->err = 0;
+
+  tasks = (chunk->last - chunk->first + chunk->recs - 1) / chunk->recs;
+
+  run_chunks(chunk, tasks);
+
+  if(wb_wait(chunk->wb))
+  {
+    fprintf(stderr, "error: write-behind failed line %i file %s\n", __LINE__, __FILE__);
+
+    chunk->err = 1;
+  }
+
+  if(stats)
+  {
+    fprintf(stderr, "write-behind: %s, %i buffers of %i datarecords\n"
+                    "generator stalls (all buffers in flight, the disk is the bottleneck): %lli  %.3f sec.\n",
+            wb_get_backend(chunk->wb), chunk->wb->depth, chunk->recs,
+            chunk->wb->stalls, chunk->wb->stall_ns / 1e9);
+  }
+
+  wb_destroy(chunk->wb);
+
+  chunk->wb = NULL;
+
+  free(chunk->buf[0]);
+
+  if(chunk->err)
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* Writes the datarecords with O_DIRECT, the page cache is not used for the datarecords.
+ * The threads generate a round of chunks directly into a 4 KiB aligned stream buffer
+ * that starts at an aligned file offset. After every round the aligned part of the buffer is written,
+ * the unaligned rest (less than DIRECT_ALIGN bytes) is moved to the start of the buffer.
+ * The first block starts with the end of the header and the last unaligned block is written without O_DIRECT,
+ * the header itself and the number of datarecords are written by edflib as usual.
+ */
+static int write_direct(struct chunk_job_struct *chunk, int threads, const char *path)
+{
+  int err, tasks, fd_direct, fd,
+      first=0;
+
+  size_t stream_sz,
+         pos,
+         aligned;
+
+  long long base,
+            hdrsize;
+
+  unsigned char *stream;
+
+  err = edf_write_header_for_datarecords(chunk->hdl, chunk->datrecs);
+  if(err)
+  {
+    fprintf(stderr, "error: edf_write_header_for_datarecords() returned %i line %i file %s\n", err, __LINE__, __FILE__);
+    return -1;
+  }
+
+  fd = edf_get_file_descriptor(chunk->hdl);
+
+  fd_direct = open(path, O_WRONLY | O_DIRECT);
+  if(fd_direct < 0)
+  {
+    /* e.g. a filesystem that doesn't support O_DIRECT, the file is still correct */
+    fprintf(stderr, "warning: can not open file %s with O_DIRECT, using buffered writes\n", path);
+
+    fd_direct = -1;
+  }
+
+  if(chunk_alloc(chunk, threads, 0))
+  {
+    if(fd_direct >= 0)  close(fd_direct);
+    return -1;
+  }
+
+  hdrsize = edf_get_datarecord_offset(chunk->hdl, 0);
+
+  base = hdrsize - (hdrsize % DIRECT_ALIGN);
+
+  stream_sz = (size_t)chunk->recsize * chunk->recs * threads + (DIRECT_ALIGN * 2);
+
+  stream_sz = ((stream_sz + DIRECT_ALIGN - 1) / DIRECT_ALIGN) * DIRECT_ALIGN;
+
+  if(posix_memalign((void **)&stream, DIRECT_ALIGN, stream_sz))
+  {
+    fprintf(stderr, "Malloc error line %i file %s\n", __LINE__, __FILE__);
+    if(fd_direct >= 0)  close(fd_direct);
+    free(chunk->buf[0]);
+    return -1;
+  }
+
+  /* the first aligned block starts with the last part of the header */
+  pos = hdrsize - base;
+
+  if(pos && (pread(fd, stream, pos, base) != (ssize_t)pos))
+  {
+    fprintf(stderr, "error: pread() line %i file %s\n", __LINE__, __FILE__);
+    chunk->err = 1;
+  }
+  else
+  {
+    chunk->err = 0;
+  }
+
+  for(first=0; (first<chunk->datrecs) && !chunk->err; first=chunk->last)
+  {
+    chunk->first = first;
+
+    chunk->last = first + (chunk->recs * threads);
+
+    if(chunk->last > chunk->datrecs)
+    {
+      chunk->last = chunk->datrecs;
+    }
+
+    chunk->stream = stream + pos;
+
+    tasks = (chunk->last - chunk->first + chunk->recs - 1) / chunk->recs;
+
+    run_chunks(chunk, tasks);
+
+    pos += (size_t)chunk->recsize * (chunk->last - chunk->first);
+
+    aligned = pos - (pos % DIRECT_ALIGN);
+
+    if(aligned)
+    {
+      if(pwrite_all((fd_direct >= 0) ? fd_direct : fd, stream, aligned, base))
+      {
+        fprintf(stderr, "error: pwrite() line %i file %s\n", __LINE__, __FILE__);
+        chunk->err = 1;
+      }
+
+      memmove(stream, stream + aligned, pos - aligned);
+
+      base += aligned;
+
+      pos -= aligned;
+    }
+  }
+
+  /* the unaligned tail */
+  if(pos && !chunk->err)
+  {
+    if(pwrite_all(fd, stream, pos, base))
+    {
+      fprintf(stderr, "error: pwrite() line %i file %s\n", __LINE__, __FILE__);
+      chunk->err = 1;
+    }
+  }
+
+  chunk->stream = NULL;
+
+  if(fd_direct >= 0)
+  {
+    if(close(fd_direct))
+    {
+      chunk->err = 1;
+    }
+  }
+
+  free(stream);
+
+  free(chunk->buf[0]);
+
+  if(chunk->err)
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+
+static int pwrite_all(int fd, const unsigned char *buf, size_t len, long long offset)
+{
+  ssize_t n;
+
+  long long t_trace;
+
+  struct stats_clock_struct t;
+
+  stats_start(&t);
+
+  t_trace = trace_time();
+
+  while(len > 0)
+  {
+    n = pwrite(fd, buf, len, offset);
+
+    if(n < 1)
+    {
+      if((n < 0) && (errno == EINTR))
+      {
+        continue;
+      }
+
+      stats_stop(&t, STATS_WRITE);
+
+      trace_span(TRACE_PWRITE, -1, -1LL, t_trace);
+
+      return -1;
+    }
+
+    buf += n;
+
+    offset += n;
+
+    len -= n;
+  }
+
+  stats_stop(&t, STATS_WRITE);
+
+  trace_span(TRACE_PWRITE, -1, -1LL, t_trace);
+
+  return 0;
+}
 
@@ -0,0 +1,171 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+
+#include "pinknoise.h"
+
+#include <string.h>
+
+
+static pinknoise_kernel_t kernel_filter=pinknoise_filter_scalar;
+
+static const char *kernel_isa="scalar";
+
+
+void pinknoise_init(void)
+{
+  kernel_filter = pinknoise_filter_scalar;
+  kernel_isa = "scalar";
+
+  /* only on x86-64, see wavegen_init() */
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+
+  if(__builtin_cpu_supports("avx2"))
+  {
+    kernel_filter = pinknoise_filter_avx2;
+    kernel_isa = "avx2";
+  }
+  else if(__builtin_cpu_supports("sse2"))
+    {
+      kernel_filter = pinknoise_filter_sse2;
+      kernel_isa = "sse2";
+    }
+#endif
+}
+
+
+void pinknoise_init_scalar(void)
+{
+  kernel_filter = pinknoise_filter_scalar;
+  kernel_isa = "scalar";
+}
+
+
+const char * pinknoise_get_isa(void)
+{
+  return kernel_isa;
+}
+
+
+void pinknoise_bank_init(struct pinknoise_struct *bank)
+{
+  memset(bank, 0, sizeof(struct pinknoise_struct));
+}
+
+
+int pinknoise_bank_add(struct pinknoise_struct *bank, double amp, double dc_offset)
+{
+  if(bank->lanes >= PINKNOISE_LANES)
+  {
+    return -1;
+  }
+
+  bank->scale[bank->lanes] = amp / 6.0;
+
+  bank->dc_offset[bank->lanes] = dc_offset;
+
+  return bank->lanes++;
+}
+
+
+void pinknoise_generate(struct pinknoise_struct *bank, double **buf, int n)
+{
+  int i, j, lane, blk;
+
+  double tile[PINKNOISE_TILE * PINKNOISE_LANES] __attribute__((aligned(64)));
+
+  /* the unused lanes are filtered as well, they just stay zero */
+  memset(tile, 0, sizeof(tile));
+
+  for(i=0; i<n; i+=PINKNOISE_TILE)
+  {
+    blk = n - i;
+
+    if(blk > PINKNOISE_TILE)
+    {
+      blk = PINKNOISE_TILE;
+    }
+
+    for(lane=0; lane<bank->lanes; lane++)
+    {
+      for(j=0; j<blk; j++)
+      {
+        tile[(j * PINKNOISE_LANES) + lane] = buf[lane][i + j];
+      }
+    }
+
+    kernel_filter(bank, tile, blk);
+
+    for(lane=0; lane<bank->lanes; lane++)
+    {
+      for(j=0; j<blk; j++)
+      {
+        buf[lane][i + j] = tile[(j * PINKNOISE_LANES) + lane];
+      }
+    }
+  }
+}
+
+
+/* This is an approximation to a -10dB/decade (-3dB/octave) filter using a weighted sum
+ * of first order filters. It is accurate to within +/-0.05dB above 9.2Hz
+ * (44100Hz sampling rate). Unity gain is at Nyquist, but can be adjusted
+ * by scaling the numbers at the end of each line.
+ * http://www.firstpr.com.au/dsp/pink-noise/
+ *
+ * The SIMD kernels use exactly the same sequence of operations.
+ */
+void pinknoise_filter_scalar(struct pinknoise_struct *bank, double *tile, int n)
+{
+  int i, lane;
+
+  double white,
+         out;
+
+  for(lane=0; lane<bank->lanes; lane++)
+  {
+    for(i=0; i<n; i++)
+    {
+      white = tile[(i * PINKNOISE_LANES) + lane] * bank->scale[lane];
+      bank->b0[lane] = 0.99886 * bank->b0[lane] + white * 0.0555179;
+      bank->b1[lane] = 0.99332 * bank->b1[lane] + white * 0.0750759;
+      bank->b2[lane] = 0.96900 * bank->b2[lane] + white * 0.1538520;
+      bank->b3[lane] = 0.86650 * bank->b3[lane] + white * 0.3104856;
+      bank->b4[lane] = 0.55000 * bank->b4[lane] + white * 0.5329522;
+      bank->b5[lane] = -0.7616 * bank->b5[lane] - white * 0.0168980;
+      out = bank->b0[lane] + bank->b1[lane] + bank->b2[lane] + bank->b3[lane] + bank->b4[lane] + bank->b5[lane] + bank->b6[lane] + white * 0.5362;
+      tile[(i * PINKNOISE_LANES) + lane] = out + bank->dc_offset[lane];
+      bank->b6[lane] = white * 0.115926;
+    }
+  }
+}
+
+
@@ -0,0 +1,105 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#ifndef PINKNOISE_INCLUDED
+#define PINKNOISE_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdlib.h>
+
+
+/* maximum number of signals in a bank, must be a multiple of 4 */
+#define PINKNOISE_LANES  (8)
+
+/* number of samples that are transposed at once */
+#define PINKNOISE_TILE  (64)
+
+
+/* Pink noise filter bank for up to PINKNOISE_LANES signals with equal samplerate.
+ * The filter is a recursion in time, but the signals are independent. The state is
+ * stored as a structure of arrays, so the SIMD kernels can advance all signals of
+ * the bank at once. The kernels produce exactly the same bits as the scalar kernel.
+ */
+struct pinknoise_struct
+{
+  double b0[PINKNOISE_LANES] __attribute__((aligned(64)));
+  double b1[PINKNOISE_LANES] __attribute__((aligned(64)));
+  double b2[PINKNOISE_LANES] __attribute__((aligned(64)));
+  double b3[PINKNOISE_LANES] __attribute__((aligned(64)));
+  double b4[PINKNOISE_LANES] __attribute__((aligned(64)));
+  double b5[PINKNOISE_LANES] __attribute__((aligned(64)));
+  double b6[PINKNOISE_LANES] __attribute__((aligned(64)));
+  double scale[PINKNOISE_LANES] __attribute__((aligned(64)));      /* peak amplitude / 6 */
+  double dc_offset[PINKNOISE_LANES] __attribute__((aligned(64)));
+  int lanes;  /* number of signals in the bank */
+};
+
+typedef void (*pinknoise_kernel_t)(struct pinknoise_struct *, double *, int);
+
+
+/* Selects the fastest kernel supported by the cpu, must be called once before generating */
+void pinknoise_init(void);
+
+/* selects the scalar reference kernel (for benchmarks) */
+void pinknoise_init_scalar(void);
+
+/* returns the name of the instruction set used by the selected kernel e.g. "avx2" */
+const char * pinknoise_get_isa(void);
+
+/* clears the filter state and removes all signals from the bank */
+void pinknoise_bank_init(struct pinknoise_struct *bank);
+
+/* adds a signal to the bank, returns its lane or -1 if the bank is full */
+int pinknoise_bank_add(struct pinknoise_struct *bank, double amp, double dc_offset);
+
+/* Converts n samples of white noise in the range [-1.0, 1.0) of every signal of the bank into pink noise.
+ * buf[lane] points to the samples of the signal in that lane, the conversion is done in place.
+ */
+void pinknoise_generate(struct pinknoise_struct *bank, double **buf, int n);
+
+/* Filters n rows of a tile, row i contains sample i of every lane: tile[(i * PINKNOISE_LANES) + lane] */
+void pinknoise_filter_scalar(struct pinknoise_struct *bank, double *tile, int n);
+
+#if defined(__x86_64__)
+void pinknoise_filter_sse2(struct pinknoise_struct *, double *, int);
+void pinknoise_filter_avx2(struct pinknoise_struct *, double *, int);
+#endif
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
+
+
@@ -0,0 +1,107 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+
+/* All lanes of the bank are advanced at once, 4 vectors of 2 signals. */
+/* The kernel produces exactly the same bits as pinknoise_filter_scalar() (no fused multiply-add). */
+
+
+#include "pinknoise.h"
+
+
+#if defined(__x86_64__)
+
+#include <emmintrin.h>
+
+
+#define PINKNOISE_VECS  (PINKNOISE_LANES / 2)
+
+
+void pinknoise_filter_sse2(struct pinknoise_struct *bank, double *tile, int n)
+{
+  int i, k;
+
+  __m128d b0[PINKNOISE_VECS], b1[PINKNOISE_VECS], b2[PINKNOISE_VECS], b3[PINKNOISE_VECS],
+          b4[PINKNOISE_VECS], b5[PINKNOISE_VECS], b6[PINKNOISE_VECS],
+          scale[PINKNOISE_VECS], dc[PINKNOISE_VECS],
+          white, out;
+
+  for(k=0; k<PINKNOISE_VECS; k++)
+  {
+    b0[k] = _mm_load_pd(bank->b0 + (k * 2));
+    b1[k] = _mm_load_pd(bank->b1 + (k * 2));
+    b2[k] = _mm_load_pd(bank->b2 + (k * 2));
+    b3[k] = _mm_load_pd(bank->b3 + (k * 2));
+    b4[k] = _mm_load_pd(bank->b4 + (k * 2));
+    b5[k] = _mm_load_pd(bank->b5 + (k * 2));
+    b6[k] = _mm_load_pd(bank->b6 + (k * 2));
+    scale[k] = _mm_load_pd(bank->scale + (k * 2));
+    dc[k] = _mm_load_pd(bank->dc_offset + (k * 2));
+  }
+
+  for(i=0; i<n; i++)
+  {
+    /* the lanes are independent, the compiler interleaves the vectors */
+    for(k=0; k<PINKNOISE_VECS; k++)
+    {
+      white = _mm_mul_pd(_mm_load_pd(tile + (i * PINKNOISE_LANES) + (k * 2)), scale[k]);
+      b0[k] = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(0.99886), b0[k]), _mm_mul_pd(white, _mm_set1_pd(0.0555179)));
+      b1[k] = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(0.99332), b1[k]), _mm_mul_pd(white, _mm_set1_pd(0.0750759)));
+      b2[k] = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(0.96900), b2[k]), _mm_mul_pd(white, _mm_set1_pd(0.1538520)));
+      b3[k] = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(0.86650), b3[k]), _mm_mul_pd(white, _mm_set1_pd(0.3104856)));
+      b4[k] = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(0.55000), b4[k]), _mm_mul_pd(white, _mm_set1_pd(0.5329522)));
+      b5[k] = _mm_sub_pd(_mm_mul_pd(_mm_set1_pd(-0.7616), b5[k]), _mm_mul_pd(white, _mm_set1_pd(0.0168980)));
+      out = _mm_add_pd(b0[k], b1[k]);
+      out = _mm_add_pd(out, b2[k]);
+      out = _mm_add_pd(out, b3[k]);
+      out = _mm_add_pd(out, b4[k]);
+      out = _mm_add_pd(out, b5[k]);
+      out = _mm_add_pd(out, b6[k]);
+      out = _mm_add_pd(out, _mm_mul_pd(white, _mm_set1_pd(0.5362)));
+      _mm_store_pd(tile + (i * PINKNOISE_LANES) + (k * 2), _mm_add_pd(out, dc[k]));
+      b6[k] = _mm_mul_pd(white, _mm_set1_pd(0.115926));
+    }
+  }
+
+  for(k=0; k<PINKNOISE_VECS; k++)
+  {
+    _mm_store_pd(bank->b0 + (k * 2), b0[k]);
+    _mm_store_pd(bank->b1 + (k * 2), b1[k]);
+    _mm_store_pd(bank->b2 + (k * 2), b2[k]);
+    _mm_store_pd(bank->b3 + (k * 2), b3[k]);
+    _mm_store_pd(bank->b4 + (k * 2), b4[k]);
+    _mm_store_pd(bank->b5 + (k * 2), b5[k]);
+    _mm_store_pd(bank->b6 + (k * 2), b6[k]);
+  }
+}
+
+#endif
+
+
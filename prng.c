@@ -0,0 +1,131 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+
+#include "prng.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#define PRNG_GOLDEN  (0x9e3779b97f4a7c15ULL)
+
+
+static inline uint64_t prng_mix64(uint64_t);
+
+
+
+void prng_init(struct prng_struct *prng, uint64_t seed, unsigned int stream)
+{
+  prng->key = prng_mix64(prng_mix64(seed) + ((stream + 1ULL) * 0xd1b54a32d192ed03ULL));
+
+  prng->counter = 0;
+}
+
+
+void prng_seek(struct prng_struct *prng, uint64_t pos)
+{
+  prng->counter = pos;
+}
+
+
+void prng_jump(struct prng_struct *prng, uint64_t n)
+{
+  prng->counter += n;
+}
+
+
+uint64_t prng_next(struct prng_struct *prng)
+{
+  return prng_mix64(prng->key + ((++prng->counter) * PRNG_GOLDEN));
+}
+
+
+void prng_uniform(struct prng_struct *prng, double *buf, int n)
+{
+  int i;
+
+  uint64_t key,
+           counter;
+
+  /* local copies, otherwise the compiler assumes that buf can alias prng */
+  key = prng->key;
+
+  counter = prng->counter;
+
+  for(i=0; i<n; i++)
+  {
+    /* the upper 53 bits fill the mantissa */
+    buf[i] = ((double)(prng_mix64(key + ((counter + i + 1) * PRNG_GOLDEN)) >> 11) * (2.0 / 9007199254740992.0)) - 1.0;
+  }
+
+  prng->counter = counter + n;
+}
+
+
+uint64_t prng_random_seed(void)
+{
+  uint64_t seed=0;
+
+  FILE *f;
+
+  struct timespec ts;
+
+  f = fopen("/dev/urandom", "rb");
+  if(f != NULL)
+  {
+    if(fread(&seed, sizeof(uint64_t), 1, f) == 1)
+    {
+      fclose(f);
+
+      return seed;
+    }
+
+    fclose(f);
+  }
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  return prng_mix64(((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec + ((uint64_t)getpid() << 32));
+}
+
+
+/* SplitMix64 finalizer */
+static inline uint64_t prng_mix64(uint64_t z)
+{
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+  return z ^ (z >> 31);
+}
+
+
@@ -0,0 +1,82 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#ifndef PRNG_INCLUDED
+#define PRNG_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdlib.h>
+#include <stdint.h>
+
+
+/* Counter-based pseudo random number generator.
+ * Number n of a stream is the SplitMix64 finalizer applied to key + (n * golden ratio).
+ * Because a number only depends on the key and its position, a stream can jump to
+ * any position in constant time and the numbers can be generated in any order and
+ * by any thread. Every stream (signal) has its own key, derived from the seed and
+ * the stream number. The same seed always produces the same numbers.
+ * This is not a cryptographic generator.
+ */
+struct prng_struct
+{
+  uint64_t key;
+  uint64_t counter;  /* position of the next number in the stream */
+};
+
+
+/* initializes stream number stream of the seed, the position is set to zero */
+void prng_init(struct prng_struct *prng, uint64_t seed, unsigned int stream);
+
+/* sets the position of the next number */
+void prng_seek(struct prng_struct *prng, uint64_t pos);
+
+/* skips the next n numbers */
+void prng_jump(struct prng_struct *prng, uint64_t n);
+
+/* returns the next number (all 64 bits are random) */
+uint64_t prng_next(struct prng_struct *prng);
+
+/* stores the next n numbers in buf as uniformly distributed doubles in the range [-1.0, 1.0) */
+void prng_uniform(struct prng_struct *prng, double *buf, int n);
+
+/* returns a seed that is different for every call, reads /dev/urandom if possible */
+uint64_t prng_random_seed(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
+
+
@@ -0,0 +1,231 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+
+#include "ring.h"
+
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+
+
+#define RING_SPINS  (64)
+
+
+static void ring_backoff(int);
+static long long ring_time_ns(void);
+
+
+
+struct ring_struct * ring_create(int depth, size_t slot_sz)
+{
+  struct ring_struct *ring;
+
+  if((depth < 1) || (depth > RING_MAX_DEPTH) || (slot_sz < 1))
+  {
+    return NULL;
+  }
+
+  if(posix_memalign((void **)&ring, RING_CACHELINE, sizeof(struct ring_struct)))
+  {
+    return NULL;
+  }
+
+  memset(ring, 0, sizeof(struct ring_struct));
+
+  ring->depth = depth;
+
+  ring->slot_sz = ((slot_sz + RING_CACHELINE - 1) / RING_CACHELINE) * RING_CACHELINE;
+
+  if(posix_memalign((void **)&ring->mem, RING_CACHELINE, ring->slot_sz * depth))
+  {
+    free(ring);
+
+    return NULL;
+  }
+
+  return ring;
+}
+
+
+unsigned char * ring_write_slot(struct ring_struct *ring)
+{
+  int i;
+
+  unsigned int head;
+
+  long long t0;
+
+  head = ring->head;  /* only the producer writes head */
+
+  if((head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) >= (unsigned int)ring->depth)
+  {
+    ring->producer_stalls++;
+
+    t0 = ring_time_ns();
+
+    for(i=0; (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) >= (unsigned int)ring->depth; i++)
+    {
+      if(__atomic_load_n(&ring->aborted, __ATOMIC_ACQUIRE))
+      {
+        return NULL;
+      }
+
+      ring_backoff(i);
+    }
+
+    ring->producer_stall_ns += ring_time_ns() - t0;
+  }
+
+  if(__atomic_load_n(&ring->aborted, __ATOMIC_ACQUIRE))
+  {
+    return NULL;
+  }
+
+  return ring->mem + ((head % ring->depth) * ring->slot_sz);
+}
+
+
+void ring_write_commit(struct ring_struct *ring)
+{
+  __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+
+void ring_close(struct ring_struct *ring)
+{
+  __atomic_store_n(&ring->closed, 1, __ATOMIC_RELEASE);
+}
+
+
+unsigned char * ring_read_slot(struct ring_struct *ring)
+{
+  int i;
+
+  unsigned int tail;
+
+  long long t0;
+
+  tail = ring->tail;  /* only the consumer writes tail */
+
+  if(__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail)
+  {
+    ring->consumer_stalls++;
+
+    t0 = ring_time_ns();
+
+    for(i=0; __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail; i++)
+    {
+      if(__atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE))
+      {
+        /* the producer may have committed a slot just before it closed the ring */
+        if(__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) != tail)
+        {
+          break;
+        }
+
+        ring->consumer_stall_ns += ring_time_ns() - t0;
+
+        return NULL;
+      }
+
+      ring_backoff(i);
+    }
+
+    ring->consumer_stall_ns += ring_time_ns() - t0;
+  }
+
+  return ring->mem + ((tail % ring->depth) * ring->slot_sz);
+}
+
+
+void ring_read_commit(struct ring_struct *ring)
+{
+  __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+
+void ring_abort(struct ring_struct *ring)
+{
+  __atomic_store_n(&ring->aborted, 1, __ATOMIC_RELEASE);
+}
+
+
+void ring_destroy(struct ring_struct *ring)
+{
+  if(ring == NULL)
+  {
+    return;
+  }
+
+  free(ring->mem);
+
+  free(ring);
+}
+
+
+/* spin a little, then yield, then sleep */
+static void ring_backoff(int i)
+{
+  struct timespec ts;
+
+  if(i < RING_SPINS)
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+    return;
+  }
+
+  if(i < (RING_SPINS * 2))
+  {
+    sched_yield();
+
+    return;
+  }
+
+  ts.tv_sec = 0;
+
+  ts.tv_nsec = 50000;
+
+  nanosleep(&ts, NULL);
+}
+
+
+static long long ring_time_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+
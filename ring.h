@@ -0,0 +1,104 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#ifndef RING_INCLUDED
+#define RING_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdlib.h>
+
+
+#define RING_MAX_DEPTH  (1024)
+
+#define RING_CACHELINE    (64)
+
+
+/* Single producer / single consumer ring of fixed size buffers (slots).
+ * The producer and the consumer only synchronize through the head and tail indices,
+ * no locks are used. A side that has to wait spins for a short while and then sleeps.
+ * The number of times and the time a side had to wait is counted, this shows
+ * which side is the bottleneck: if the producer stalls often, the consumer is too slow
+ * and vice versa.
+ */
+struct ring_struct
+{
+  int depth;                /* number of slots */
+  size_t slot_sz;           /* size of a slot in bytes, multiple of RING_CACHELINE */
+  unsigned char *mem;
+
+  /* head and tail are in their own cacheline to prevent false sharing */
+  unsigned int head __attribute__((aligned(RING_CACHELINE)));  /* slots written, updated by the producer */
+  int closed;                                                   /* set by the producer when it's done */
+  long long producer_stalls;                                    /* times the producer found the ring full */
+  long long producer_stall_ns;
+
+  unsigned int tail __attribute__((aligned(RING_CACHELINE)));  /* slots read, updated by the consumer */
+  int aborted;                                                  /* set by the consumer when it gives up */
+  long long consumer_stalls;                                    /* times the consumer found the ring empty */
+  long long consumer_stall_ns;
+};
+
+
+/* Creates a ring with depth slots of slot_sz bytes, returns NULL on error */
+struct ring_struct * ring_create(int depth, size_t slot_sz);
+
+/* Producer: returns the next free slot, waits while the ring is full */
+/* returns NULL when the consumer has aborted */
+unsigned char * ring_write_slot(struct ring_struct *ring);
+
+/* Producer: passes the slot returned by ring_write_slot() to the consumer */
+void ring_write_commit(struct ring_struct *ring);
+
+/* Producer: no more slots will be written */
+void ring_close(struct ring_struct *ring);
+
+/* Consumer: returns the oldest written slot, waits while the ring is empty */
+/* returns NULL when the ring is empty and closed */
+unsigned char * ring_read_slot(struct ring_struct *ring);
+
+/* Consumer: gives the slot returned by ring_read_slot() back to the producer */
+void ring_read_commit(struct ring_struct *ring);
+
+/* Consumer: no more slots will be read, ring_write_slot() will return NULL */
+void ring_abort(struct ring_struct *ring);
+
+void ring_destroy(struct ring_struct *ring);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
+
+
@@ -0,0 +1,324 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+#include "stats.h"
+
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+
+/* the counters of one thread */
+struct stats_block_struct
+{
+  long long wall_ns[STATS_STAGES];
+  long long cpu_ns[STATS_STAGES];
+  long long calls[STATS_STAGES];
+  struct stats_block_struct *next;
+};
+
+
+static int stats_on=0;
+
+static long long stats_samples=0,
+                 stats_bytes=0;
+
+static struct edf_write_stats_struct stats_edf_par;
+
+/* the blocks of all threads that have timed a stage, they are never freed */
+/* because a thread may exit before the report is printed */
+static struct stats_block_struct *stats_blocks=NULL;
+
+static pthread_mutex_t stats_lock=PTHREAD_MUTEX_INITIALIZER;
+
+static __thread struct stats_block_struct *stats_local=NULL;
+
+
+static struct stats_block_struct * stats_block(void);
+static long long stats_time_ns(clockid_t);
+static void stats_print_stage(FILE *, const char *, long long, long long, long long, int);
+
+
+
+void stats_enable(void)
+{
+  stats_on = 1;
+}
+
+
+int stats_enabled(void)
+{
+  return stats_on;
+}
+
+
+void stats_clock(struct stats_clock_struct *clk)
+{
+  clk->wall_ns = stats_time_ns(CLOCK_MONOTONIC);
+
+  clk->cpu_ns = stats_time_ns(CLOCK_THREAD_CPUTIME_ID);
+}
+
+
+void stats_start(struct stats_clock_struct *clk)
+{
+  if(!stats_on)
+  {
+    return;
+  }
+
+  stats_clock(clk);
+}
+
+
+void stats_stop(const struct stats_clock_struct *clk, int stage)
+{
+  struct stats_block_struct *blk;
+
+  if(!stats_on)
+  {
+    return;
+  }
+
+  blk = stats_block();
+  if(blk == NULL)
+  {
+    return;
+  }
+
+  blk->wall_ns[stage] += stats_time_ns(CLOCK_MONOTONIC) - clk->wall_ns;
+
+  blk->cpu_ns[stage] += stats_time_ns(CLOCK_THREAD_CPUTIME_ID) - clk->cpu_ns;
+
+  blk->calls[stage]++;
+}
+
+
+long long stats_lap(long long t, int stage)
+{
+  long long now;
+
+  struct stats_block_struct *blk;
+
+  if(!stats_on)
+  {
+    return 0;
+  }
+
+  now = stats_time_ns(CLOCK_MONOTONIC);
+
+  if(stage < 0)
+  {
+    return now;
+  }
+
+  blk = stats_block();
+  if(blk == NULL)
+  {
+    return now;
+  }
+
+  blk->wall_ns[stage] += now - t;
+
+  blk->calls[stage]++;
+
+  return now;
+}
+
+
+void stats_count(long long samples, long long bytes)
+{
+  __atomic_add_fetch(&stats_samples, samples, __ATOMIC_RELAXED);
+
+  __atomic_add_fetch(&stats_bytes, bytes, __ATOMIC_RELAXED);
+}
+
+
+struct edf_write_stats_struct * stats_edf(void)
+{
+  return &stats_edf_par;
+}
+
+
+/* must be called when all threads have finished */
+void stats_print(FILE *f, const struct stats_clock_struct *start)
+{
+  int i;
+
+  long long wall_ns[STATS_STAGES],
+            cpu_ns[STATS_STAGES],
+            calls[STATS_STAGES],
+            elapsed_ns;
+
+  double seconds,
+         cpu_seconds;
+
+  const char gen_str[STATS_GEN_WAVES][32]={"generate sine", "generate square", "generate ramp",
+                                           "generate triangle", "generate white noise", "generate pink noise"};
+
+  struct stats_block_struct *blk;
+
+  struct rusage usage;
+
+  memset(wall_ns, 0, sizeof(wall_ns));
+  memset(cpu_ns, 0, sizeof(cpu_ns));
+  memset(calls, 0, sizeof(calls));
+
+  pthread_mutex_lock(&stats_lock);
+
+  for(blk=stats_blocks; blk!=NULL; blk=blk->next)
+  {
+    for(i=0; i<STATS_STAGES; i++)
+    {
+      wall_ns[i] += blk->wall_ns[i];
+
+      cpu_ns[i] += blk->cpu_ns[i];
+
+      calls[i] += blk->calls[i];
+    }
+  }
+
+  pthread_mutex_unlock(&stats_lock);
+
+  elapsed_ns = stats_time_ns(CLOCK_MONOTONIC) - start->wall_ns;
+
+  seconds = elapsed_ns / 1e9;
+
+  memset(&usage, 0, sizeof(struct rusage));
+
+  getrusage(RUSAGE_SELF, &usage);
+
+  cpu_seconds = usage.ru_utime.tv_sec + (usage.ru_utime.tv_usec / 1e6) + usage.ru_stime.tv_sec + (usage.ru_stime.tv_usec / 1e6);
+
+  fprintf(f, "\n%-26s %11s %15s %11s\n", "stage", "calls", "wall (s)", "cpu (s)");
+
+  stats_print_stage(f, "parse options", calls[STATS_PARSE], wall_ns[STATS_PARSE], cpu_ns[STATS_PARSE], 1);
+
+  stats_print_stage(f, "write header", stats_edf_par.calls[EDFLIB_STATS_HEADER], stats_edf_par.wall_ns[EDFLIB_STATS_HEADER], stats_edf_par.cpu_ns[EDFLIB_STATS_HEADER], 1);
+
+  for(i=0; i<STATS_GEN_WAVES; i++)
+  {
+    stats_print_stage(f, gen_str[i], calls[STATS_GEN + i], wall_ns[STATS_GEN + i], 0, 0);
+  }
+
+  stats_print_stage(f, "quantize", calls[STATS_QUANT], wall_ns[STATS_QUANT], 0, 0);
+
+  stats_print_stage(f, "quantize (edflib)", stats_edf_par.calls[EDFLIB_STATS_CONVERT], stats_edf_par.wall_ns[EDFLIB_STATS_CONVERT], stats_edf_par.cpu_ns[EDFLIB_STATS_CONVERT], 1);
+
+  stats_print_stage(f, "write TAL", stats_edf_par.calls[EDFLIB_STATS_TAL], stats_edf_par.wall_ns[EDFLIB_STATS_TAL], stats_edf_par.cpu_ns[EDFLIB_STATS_TAL], 1);
+
+  stats_print_stage(f, "write (edflib)", stats_edf_par.calls[EDFLIB_STATS_WRITE], stats_edf_par.wall_ns[EDFLIB_STATS_WRITE], stats_edf_par.cpu_ns[EDFLIB_STATS_WRITE], 1);
+
+  stats_print_stage(f, "write (pwrite)", calls[STATS_WRITE], wall_ns[STATS_WRITE], cpu_ns[STATS_WRITE], 1);
+
+  stats_print_stage(f, "fflush", stats_edf_par.calls[EDFLIB_STATS_FLUSH], stats_edf_par.wall_ns[EDFLIB_STATS_FLUSH], stats_edf_par.cpu_ns[EDFLIB_STATS_FLUSH], 1);
+
+  stats_print_stage(f, "edfclose_file", calls[STATS_CLOSE], wall_ns[STATS_CLOSE], cpu_ns[STATS_CLOSE], 1);
+
+  fprintf(f, "\nsamples: %lli  bytes: %lli\n", stats_samples, stats_bytes);
+
+  if(seconds > 0)
+  {
+    fprintf(f, "throughput: %.3f Msamples/sec.  %.3f MB/sec.\n", stats_samples / seconds / 1e6, stats_bytes / seconds / 1e6);
+  }
+
+  fprintf(f, "wall time: %.3f sec.  cpu time: %.3f sec. (user %.3f  system %.3f)  cpu / wall: %.2f\n",
+          seconds, cpu_seconds,
+          usage.ru_utime.tv_sec + (usage.ru_utime.tv_usec / 1e6),
+          usage.ru_stime.tv_sec + (usage.ru_stime.tv_usec / 1e6),
+          (seconds > 0) ? (cpu_seconds / seconds) : 0.0);
+
+  fprintf(f, "peak RSS: %li KB\n", usage.ru_maxrss);
+
+  fprintf(f, "the times of the stages are summed over all threads, the generate and quantize stages only measure the wall time\n");
+}
+
+
+static void stats_print_stage(FILE *f, const char *name, long long calls, long long wall_ns, long long cpu_ns, int has_cpu)
+{
+  if(!calls)
+  {
+    return;
+  }
+
+  if(has_cpu)
+  {
+    fprintf(f, "%-26s %11lli %15.6f %11.6f\n", name, calls, wall_ns / 1e9, cpu_ns / 1e9);
+  }
+  else
+  {
+    fprintf(f, "%-26s %11lli %15.6f %11s\n", name, calls, wall_ns / 1e9, "-");
+  }
+}
+
+
+/* returns the counters of the calling thread, they are allocated at the first call */
+static struct stats_block_struct * stats_block(void)
+{
+  if(stats_local != NULL)
+  {
+    return stats_local;
+  }
+
+  stats_local = (struct stats_block_struct *)calloc(1, sizeof(struct stats_block_struct));
+  if(stats_local == NULL)
+  {
+    return NULL;
+  }
+
+  pthread_mutex_lock(&stats_lock);
+
+  stats_local->next = stats_blocks;
+
+  stats_blocks = stats_local;
+
+  pthread_mutex_unlock(&stats_lock);
+
+  return stats_local;
+}
+
+
+static long long stats_time_ns(clockid_t clk_id)
+{
+  struct timespec ts;
+
+  clock_gettime(clk_id, &ts);
+
+  return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+
+
+
+
+
+
+
@@ -0,0 +1,104 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#ifndef STATS_INCLUDED
+#define STATS_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "edflib.h"
+
+
+/* stages of edfgenerator, the stages of edflib are counted separately in a struct edf_write_stats_struct */
+#define STATS_PARSE       (0)   /* parsing the options */
+#define STATS_GEN         (1)   /* generating the samples, one stage per waveform: STATS_GEN + waveform */
+#define STATS_GEN_WAVES   (6)
+#define STATS_QUANT       (7)   /* conversion of physical samples to digital samples and packing */
+#define STATS_WRITE       (8)   /* pwrite() by edfgenerator itself (parallel-write, part, direct-io) */
+#define STATS_CLOSE       (9)   /* edfclose_file() */
+#define STATS_STAGES     (10)
+
+
+/* The generation and quantization stages are timed per chunk of samples.
+ * Reading the cpu time of a thread is a system call that takes longer than generating a chunk,
+ * for these stages only the wall time is measured (with stats_lap()). The other stages
+ * measure the wall time and the cpu time of the calling thread (with stats_start() and stats_stop()).
+ * Every thread accumulates into its own counters, no atomic operations are needed.
+ */
+struct stats_clock_struct
+{
+  long long wall_ns;
+  long long cpu_ns;
+};
+
+
+/* Enables the statistics, until then stats_start(), stats_stop() and stats_lap() do nothing */
+void stats_enable(void);
+
+int stats_enabled(void);
+
+/* reads the monotonic clock and the cpu time of the calling thread, also when the statistics are disabled */
+void stats_clock(struct stats_clock_struct *clk);
+
+/* starts timing a stage */
+void stats_start(struct stats_clock_struct *clk);
+
+/* adds the wall time and the cpu time since stats_start() or stats_clock() to stage */
+void stats_stop(const struct stats_clock_struct *clk, int stage);
+
+/* Adds the wall time since t to stage and returns the current time, a stage < 0 only returns the current time.
+ * Consecutive stages can be timed with one clock reading per stage:
+ * t = stats_lap(0, -1); ... t = stats_lap(t, STATS_GEN); ... t = stats_lap(t, STATS_QUANT);
+ * Returns 0 when the statistics are disabled.
+ */
+long long stats_lap(long long t, int stage);
+
+/* adds the samples and the bytes of a file that has been written */
+void stats_count(long long samples, long long bytes);
+
+/* returns the structure that collects the stages of edflib, see edf_set_write_stats() */
+struct edf_write_stats_struct * stats_edf(void);
+
+/* Prints the report, start is the time the process started */
+void stats_print(FILE *f, const struct stats_clock_struct *start);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
+
+
@@ -0,0 +1,252 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+
+#include "threadpool.h"
+
+
+static void * tpool_worker(void *);
+static int tpool_do_tasks(struct tpool_struct *, int);
+
+
+
+struct tpool_struct * tpool_create(int threads)
+{
+  int i;
+
+  struct tpool_struct *pool;
+
+  if((threads < 1) || (threads > TPOOL_MAX_THREADS))
+  {
+    return NULL;
+  }
+
+  pool = (struct tpool_struct *)calloc(1, sizeof(struct tpool_struct));
+  if(pool == NULL)
+  {
+    return NULL;
+  }
+
+  pool->threads = threads;
+
+  pthread_mutex_init(&pool->mutex, NULL);
+
+  pthread_cond_init(&pool->work_cond, NULL);
+
+  pthread_cond_init(&pool->done_cond, NULL);
+
+  for(i=1; i<threads; i++)
+  {
+    pool->worker[i].pool = pool;
+
+    pool->worker[i].thread = i;
+
+    if(pthread_create(&pool->tid[i], NULL, tpool_worker, &pool->worker[i]))
+    {
+      pool->threads = i;
+
+      tpool_destroy(pool);
+
+      return NULL;
+    }
+  }
+
+  return pool;
+}
+
+
+void tpool_run(struct tpool_struct *pool, int tasks, tpool_func_t func, void *arg)
+{
+  int done;
+
+  if(pool->threads == 1)
+  {
+    for(done=0; done<tasks; done++)
+    {
+      func(done, 0, arg);
+    }
+
+    return;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+
+  pool->func = func;
+
+  pool->arg = arg;
+
+  pool->tasks = tasks;
+
+  pool->tasks_done = 0;
+
+  __atomic_store_n(&pool->next_task, 0, __ATOMIC_RELAXED);
+
+  pool->busy = pool->threads - 1;
+
+  pool->generation++;
+
+  pthread_cond_broadcast(&pool->work_cond);
+
+  pthread_mutex_unlock(&pool->mutex);
+
+  done = tpool_do_tasks(pool, 0);
+
+  pthread_mutex_lock(&pool->mutex);
+
+  pool->tasks_done += done;
+
+  /* wait until all tasks are done and all workers are idle again, */
+  /* otherwise a slow worker could claim a task of the next batch with the old arguments */
+  while((pool->tasks_done < pool->tasks) || pool->busy)
+  {
+    pthread_cond_wait(&pool->done_cond, &pool->mutex);
+  }
+
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+
+void tpool_destroy(struct tpool_struct *pool)
+{
+  int i;
+
+  if(pool == NULL)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+
+  pool->quit = 1;
+
+  pthread_cond_broadcast(&pool->work_cond);
+
+  pthread_mutex_unlock(&pool->mutex);
+
+  for(i=1; i<pool->threads; i++)
+  {
+    pthread_join(pool->tid[i], NULL);
+  }
+
+  pthread_cond_destroy(&pool->work_cond);
+
+  pthread_cond_destroy(&pool->done_cond);
+
+  pthread_mutex_destroy(&pool->mutex);
+
+  free(pool);
+}
+
+
+/* claims and runs tasks until there are no tasks left, returns the number of tasks done */
+static int tpool_do_tasks(struct tpool_struct *pool, int thread)
+{
+  int task,
+      done=0;
+
+  while(1)
+  {
+    task = __atomic_fetch_add(&pool->next_task, 1, __ATOMIC_RELAXED);
+
+    if(task >= pool->tasks)
+    {
+      break;
+    }
+
+    pool->func(task, thread, pool->arg);
+
+    done++;
+  }
+
+  return done;
+}
+
+
+static void * tpool_worker(void *arg)
+{
+  int done;
+
+  unsigned int generation=0;
+
+  struct tpool_worker_struct *worker;
+
+  struct tpool_struct *pool;
+
+  worker = (struct tpool_worker_struct *)arg;
+
+  pool = worker->pool;
+
+  while(1)
+  {
+    pthread_mutex_lock(&pool->mutex);
+
+    while((pool->generation == generation) && (!pool->quit))
+    {
+      pthread_cond_wait(&pool->work_cond, &pool->mutex);
+    }
+
+    if(pool->quit)
+    {
+      pthread_mutex_unlock(&pool->mutex);
+
+      break;
+    }
+
+    generation = pool->generation;
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    done = tpool_do_tasks(pool, worker->thread);
+
+    pthread_mutex_lock(&pool->mutex);
+
+    pool->tasks_done += done;
+
+    pool->busy--;
+
+    if((pool->tasks_done >= pool->tasks) && (!pool->busy))
+    {
+      pthread_cond_signal(&pool->done_cond);
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+  }
+
+  return NULL;
+}
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,93 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#ifndef THREADPOOL_INCLUDED
+#define THREADPOOL_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdlib.h>
+#include <pthread.h>
+
+
+#define TPOOL_MAX_THREADS  (64)
+
+
+/* the function that is called for every task, thread is 0 for the calling thread */
+typedef void (*tpool_func_t)(int task, int thread, void *arg);
+
+struct tpool_struct;
+
+struct tpool_worker_struct
+{
+  struct tpool_struct *pool;
+  int thread;
+};
+
+struct tpool_struct
+{
+  int threads;
+  pthread_t tid[TPOOL_MAX_THREADS];
+  struct tpool_worker_struct worker[TPOOL_MAX_THREADS];
+  pthread_mutex_t mutex;
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+  unsigned int generation;  /* incremented for every batch */
+  int tasks;
+  int next_task;            /* next task to be claimed, accessed atomically */
+  int tasks_done;           /* protected by mutex */
+  int busy;                 /* number of workers that are still working on the current batch */
+  int quit;
+  tpool_func_t func;
+  void *arg;
+};
+
+
+/* Creates a pool with threads - 1 worker threads, the calling thread is the last worker */
+/* threads must be in the range 1 to TPOOL_MAX_THREADS, returns NULL on error */
+struct tpool_struct * tpool_create(int threads);
+
+/* Runs func for tasks 0 ... tasks - 1, the tasks are distributed over the worker threads */
+/* and the calling thread. Returns when all tasks are finished. */
+void tpool_run(struct tpool_struct *pool, int tasks, tpool_func_t func, void *arg);
+
+/* Stops the worker threads and frees the pool */
+void tpool_destroy(struct tpool_struct *pool);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
+
+
@@ -0,0 +1,295 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "utils.h"
+
+
+static int trace_on=0,
+           trace_max=0,
+           trace_main_tid=0;
+
+static int trace_n=0;  /* events claimed, can exceed trace_max by the number of threads */
+
+static long long trace_dropped=0;
+
+static long long trace_start_ns=0;
+
+static struct trace_event_struct *trace_buf=NULL;
+
+static char trace_path[1024]="";
+
+static __thread int trace_tid=0;
+
+
+static long long trace_time_ns(void);
+static int trace_get_tid(void);
+
+
+
+int trace_open(const char *path, int max_events)
+{
+  if(max_events < 1)
+  {
+    return -1;
+  }
+
+  free(trace_buf);
+
+  trace_buf = (struct trace_event_struct *)malloc(sizeof(struct trace_event_struct) * max_events);
+  if(trace_buf == NULL)
+  {
+    return -1;
+  }
+
+  strlcpy(trace_path, path, 1024);
+
+  trace_max = max_events;
+
+  trace_n = 0;
+
+  trace_dropped = 0;
+
+  trace_main_tid = trace_get_tid();
+
+  trace_start_ns = trace_time_ns();
+
+  trace_on = 1;
+
+  return 0;
+}
+
+
+int trace_enabled(void)
+{
+  return trace_on;
+}
+
+
+long long trace_time(void)
+{
+  if(!trace_on)
+  {
+    return 0;
+  }
+
+  return trace_time_ns();
+}
+
+
+void trace_span(int type, int chan, long long datrec, long long start_ns)
+{
+  if(!trace_on)
+  {
+    return;
+  }
+
+  trace_span_end(type, chan, datrec, start_ns, trace_time_ns());
+}
+
+
+void trace_span_end(int type, int chan, long long datrec, long long start_ns, long long end_ns)
+{
+  int i;
+
+  struct trace_event_struct *ev;
+
+  if(!trace_on)
+  {
+    return;
+  }
+
+  /* when the buffer is full, trace_n stops growing so it can't overflow during a long run */
+  if(__atomic_load_n(&trace_n, __ATOMIC_RELAXED) >= trace_max)
+  {
+    __atomic_add_fetch(&trace_dropped, 1, __ATOMIC_RELAXED);
+
+    return;
+  }
+
+  i = __atomic_fetch_add(&trace_n, 1, __ATOMIC_RELAXED);
+
+  if(i >= trace_max)
+  {
+    __atomic_add_fetch(&trace_dropped, 1, __ATOMIC_RELAXED);
+
+    return;
+  }
+
+  ev = &trace_buf[i];
+
+  ev->start_ns = start_ns;
+  ev->end_ns = end_ns;
+  ev->datrec = datrec;
+  ev->tid = trace_get_tid();
+  ev->type = type;
+  ev->chan = chan;
+}
+
+
+void trace_edflib(int stage, long long datarecord, long long start_ns, long long end_ns, void *arg)
+{
+  (void)arg;
+
+  trace_span_end(TRACE_EDFLIB + stage, -1, datarecord, start_ns, end_ns);
+}
+
+
+int trace_close(void)
+{
+  int i, n, pid, err=0;
+
+  const char type_str[TRACE_TYPES][32]={"generate sine", "generate square", "generate ramp",
+                                        "generate triangle", "generate white noise", "generate pink noise",
+                                        "quantize", "datarecord",
+                                        "write header", "quantize (edflib)", "write TAL", "write", "fflush",
+                                        "pwrite", "edfclose_file"};
+
+  const char cat_str[TRACE_TYPES][16]={"generate", "generate", "generate", "generate", "generate", "generate",
+                                       "generate", "generate",
+                                       "edflib", "edflib", "edflib", "io", "io",
+                                       "io", "io"};
+
+  FILE *f;
+
+  struct trace_event_struct *ev;
+
+  if(!trace_on)
+  {
+    return 0;
+  }
+
+  trace_on = 0;
+
+  n = trace_n;
+
+  if(n > trace_max)
+  {
+    n = trace_max;
+  }
+
+  if(trace_dropped)
+  {
+    fprintf(stderr, "trace: the buffer is full, %lli of %lli events have been dropped\n", trace_dropped, trace_dropped + n);
+  }
+
+  pid = getpid();
+
+  f = fopen(trace_path, "wb");
+  if(f == NULL)
+  {
+    fprintf(stderr, "error: can not open file %s for writing\n", trace_path);
+
+    free(trace_buf);
+
+    trace_buf = NULL;
+
+    return -1;
+  }
+
+  fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+             "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%i,\"tid\":%i,\"args\":{\"name\":\"main\"}}",
+          pid, trace_main_tid);
+
+  for(i=0; i<n; i++)
+  {
+    ev = &trace_buf[i];
+
+    /* the timestamps are in microseconds */
+    fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%i,\"tid\":%i,\"args\":{",
+            type_str[ev->type], cat_str[ev->type],
+            (ev->start_ns - trace_start_ns) / 1e3, (ev->end_ns - ev->start_ns) / 1e3,
+            pid, ev->tid);
+
+    if(ev->chan >= 0)
+    {
+      fprintf(f, "\"signal\":%i%s", ev->chan + 1, (ev->datrec >= 0) ? "," : "");
+    }
+
+    if(ev->datrec >= 0)
+    {
+      fprintf(f, "\"datarecord\":%lli", ev->datrec);
+    }
+
+    fprintf(f, "}}");
+  }
+
+  fprintf(f, "\n]}\n");
+
+  if(fclose(f))
+  {
+    fprintf(stderr, "error: can not write file %s\n", trace_path);
+
+    err = -1;
+  }
+
+  free(trace_buf);
+
+  trace_buf = NULL;
+
+  return err;
+}
+
+
+static long long trace_time_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+
+/* the id of the thread as shown by the kernel (and by top -H) */
+static int trace_get_tid(void)
+{
+  if(!trace_tid)
+  {
+    trace_tid = syscall(SYS_gettid);
+  }
+
+  return trace_tid;
+}
+
+
+
+
+
+
+
+
@@ -0,0 +1,101 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#ifndef TRACE_INCLUDED
+#define TRACE_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdlib.h>
+
+
+/* number of events the buffer can hold, events that don't fit are dropped and counted */
+#define TRACE_DEFAULT_EVENTS  (1 << 20)
+
+/* types of the spans */
+#define TRACE_GEN          (0)   /* generating one signal of one datarecord: TRACE_GEN + waveform */
+#define TRACE_GEN_WAVES    (6)
+#define TRACE_QUANT        (6)   /* conversion of one signal to digital samples */
+#define TRACE_DATAREC      (7)   /* generating all signals of one datarecord */
+#define TRACE_EDFLIB       (8)   /* the stages of edflib: TRACE_EDFLIB + EDFLIB_STATS_... */
+#define TRACE_PWRITE      (13)   /* pwrite() by edfgenerator itself */
+#define TRACE_CLOSE       (14)   /* edfclose_file() */
+#define TRACE_TYPES       (15)
+
+
+/* A span of time on one thread.
+ * The buffer is allocated once by trace_open(), the threads claim the next event
+ * with an atomic increment, no locks are used.
+ */
+struct trace_event_struct
+{
+  long long start_ns;
+  long long end_ns;
+  long long datrec;   /* -1 if not applicable */
+  int tid;
+  short type;
+  short chan;         /* signal, -1 if not applicable */
+};
+
+
+/* Allocates the buffer for max_events events and enables tracing, the events are written to path by trace_close()
+ * returns 0 on success
+ */
+int trace_open(const char *path, int max_events);
+
+int trace_enabled(void);
+
+/* returns the current time (CLOCK_MONOTONIC) or 0 when tracing is disabled, used as start of a span */
+long long trace_time(void);
+
+/* records a span from start_ns until now, does nothing when tracing is disabled */
+void trace_span(int type, int chan, long long datrec, long long start_ns);
+
+/* records a span from start_ns until end_ns */
+void trace_span_end(int type, int chan, long long datrec, long long start_ns, long long end_ns);
+
+/* callback for struct edf_write_stats_struct, records the stages of edflib */
+void trace_edflib(int stage, long long datarecord, long long start_ns, long long end_ns, void *arg);
+
+/* Writes the events in Chrome trace-event format (JSON) and frees the buffer, must be called when all threads have finished
+ * returns 0 on success
+ */
+int trace_close(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
+
+
@@ -2458,7 +2458,7 @@ int t_gcd(int a, int b)
 /* returns least common multiple */
 int t_lcm(int a, int b)
 {
-  return ((a * b) / t_gcd(a, b));
+  return ((a / t_gcd(a, b)) * b);
 }
 
 
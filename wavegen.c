@@ -0,0 +1,361 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+
+#include "wavegen.h"
+
+
+static wavegen_kernel_t kernel_sine=wavegen_sine_scalar,
+                        kernel_square=wavegen_square_scalar,
+                        kernel_ramp=wavegen_ramp_scalar,
+                        kernel_triangle=wavegen_triangle_scalar;
+
+static const char *kernel_isa="scalar";
+
+
+void wavegen_init(int precision)
+{
+  kernel_sine = wavegen_sine_scalar;
+  kernel_square = wavegen_square_scalar;
+  kernel_ramp = wavegen_ramp_scalar;
+  kernel_triangle = wavegen_triangle_scalar;
+  kernel_isa = "scalar";
+
+  if(precision == WAVEGEN_PRECISION_SCALAR)
+  {
+    return;
+  }
+
+  /* only on x86-64, the scalar kernels use SSE2 there as well, on 32-bit x86 they use the x87 fpu */
+  /* and the SIMD kernels would not produce the same bits */
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+
+  if(__builtin_cpu_supports("avx2"))
+  {
+    if((precision == WAVEGEN_PRECISION_FAST) && __builtin_cpu_supports("fma"))
+    {
+      kernel_sine = wavegen_sine_avx2_fma;
+      kernel_square = wavegen_square_avx2_fma;
+      kernel_ramp = wavegen_ramp_avx2_fma;
+      kernel_triangle = wavegen_triangle_avx2_fma;
+      kernel_isa = "avx2+fma";
+    }
+    else
+    {
+      kernel_sine = wavegen_sine_avx2;
+      kernel_square = wavegen_square_avx2;
+      kernel_ramp = wavegen_ramp_avx2;
+      kernel_triangle = wavegen_triangle_avx2;
+      kernel_isa = "avx2";
+    }
+  }
+  else if(__builtin_cpu_supports("sse2"))
+    {
+      kernel_sine = wavegen_sine_sse2;
+      kernel_square = wavegen_square_sse2;
+      kernel_ramp = wavegen_ramp_sse2;
+      kernel_triangle = wavegen_triangle_sse2;
+      kernel_isa = "sse2";
+    }
+#endif
+}
+
+
+const char * wavegen_get_isa(void)
+{
+  return kernel_isa;
+}
+
+
+void wavegen_sine(double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  kernel_sine(buf, start, n, par);
+}
+
+
+void wavegen_square(double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  kernel_square(buf, start, n, par);
+}
+
+
+void wavegen_ramp(double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  kernel_ramp(buf, start, n, par);
+}
+
+
+void wavegen_triangle(double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  kernel_triangle(buf, start, n, par);
+}
+
+
+void wavegen_osc_seed(double *s, double *c, int i, const struct wavegen_par_struct *par)
+{
+  int k;
+
+  double x;
+
+  for(k=0; k<WAVEGEN_OSC_LANES; k++)
+  {
+    x = par->phase + ((i + k) * par->step);
+
+    x -= floor(x);
+
+    s[k] = sin((M_PI * 2.0) * x);
+
+    c[k] = cos((M_PI * 2.0) * x);
+  }
+}
+
+
+/* The SIMD kernels use exactly the same sequence of operations as the scalar kernels.
+ * This is the reason why the scalar kernels are written the way they are.
+ * Do not "simplify" the expressions below without changing the SIMD kernels as well.
+ */
+
+void wavegen_sine_scalar(double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  int i, j, k, blk;
+
+  double s[WAVEGEN_OSC_LANES],
+         c[WAVEGEN_OSC_LANES],
+         tmp,
+         sin_w,
+         cos_w;
+
+  /* every lane advances WAVEGEN_OSC_LANES samples per step */
+  sin_w = sin((M_PI * 2.0) * (par->step * WAVEGEN_OSC_LANES));
+
+  cos_w = cos((M_PI * 2.0) * (par->step * WAVEGEN_OSC_LANES));
+
+  for(i=0; i<n; i+=WAVEGEN_OSC_RENORM)
+  {
+    wavegen_osc_seed(s, c, start + i, par);
+
+    blk = n - i;
+
+    if(blk > WAVEGEN_OSC_RENORM)
+    {
+      blk = WAVEGEN_OSC_RENORM;
+    }
+
+    for(j=0; j<blk; j+=WAVEGEN_OSC_LANES)
+    {
+      for(k=0; k<WAVEGEN_OSC_LANES; k++)
+      {
+        if((j + k) < blk)
+        {
+          buf[i + j + k] = (s[k] * par->amp) + par->dc_offset;
+        }
+
+        tmp = (c[k] * cos_w) - (s[k] * sin_w);
+
+        s[k] = (s[k] * cos_w) + (c[k] * sin_w);
+
+        c[k] = tmp;
+      }
+    }
+  }
+}
+
+
+void wavegen_square_scalar(double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  int i;
+
+  double x,
+         hi,
+         lo;
+
+  hi = par->amp + par->dc_offset;
+
+  lo = -par->amp + par->dc_offset;
+
+  for(i=0; i<n; i++)
+  {
+    x = par->phase + ((start + i) * par->step);
+
+    x -= floor(x);
+
+    if(x < par->dutycycle)
+    {
+      buf[i] = hi;
+    }
+    else
+    {
+      buf[i] = lo;
+    }
+  }
+}
+
+
+void wavegen_ramp_scalar(double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  int i;
+
+  double x,
+         slope,
+         lo;
+
+  slope = par->amp * (2.0 / par->dutycycle);
+
+  lo = -par->amp + par->dc_offset;
+
+  for(i=0; i<n; i++)
+  {
+    x = par->phase + ((start + i) * par->step);
+
+    x -= floor(x);
+
+    if(x < par->dutycycle)
+    {
+      buf[i] = ((slope * x) - par->amp) + par->dc_offset;
+    }
+    else
+    {
+      buf[i] = lo;
+    }
+  }
+}
+
+
+void wavegen_triangle_scalar(double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  int i;
+
+  double x,
+         slope,
+         half,
+         lo;
+
+  slope = par->amp * (4.0 / par->dutycycle);
+
+  half = par->dutycycle / 2.0;
+
+  lo = -par->amp + par->dc_offset;
+
+  for(i=0; i<n; i++)
+  {
+    x = par->phase + ((start + i) * par->step);
+
+    x -= floor(x);
+
+    if(x < half)
+    {
+      /* the rising edge has always been shifted by two times the dc-offset, */
+      /* keep it that way so existing files can be reproduced */
+      buf[i] = (((slope * x) - par->amp) + par->dc_offset) + par->dc_offset;
+    }
+    else if(x < par->dutycycle)
+      {
+        buf[i] = ((slope * (par->dutycycle - x)) - par->amp) + par->dc_offset;
+      }
+      else
+      {
+        buf[i] = lo;
+      }
+  }
+}
+
+
+void wavegen_quant_init(struct wavegen_quant_struct *quant, double physmax, double physmin, int digmax, int digmin)
+{
+  quant->bitvalue = (physmax - physmin) / (digmax - digmin);
+
+  quant->offset = physmax / quant->bitvalue - digmax;
+
+  quant->digmax = digmax;
+
+  quant->digmin = digmin;
+}
+
+
+void wavegen_pack_edf(const double *buf, int n, const struct wavegen_quant_struct *quant, unsigned char *dest)
+{
+  int i, value;
+
+  for(i=0; i<n; i++)
+  {
+    value = (buf[i] / quant->bitvalue) - quant->offset;
+
+    if(value > quant->digmax)
+    {
+      value = quant->digmax;
+    }
+
+    if(value < quant->digmin)
+    {
+      value = quant->digmin;
+    }
+
+    dest[i * 2] = value & 0xff;
+
+    dest[i * 2 + 1] = (value >> 8) & 0xff;
+  }
+}
+
+
+void wavegen_pack_bdf(const double *buf, int n, const struct wavegen_quant_struct *quant, unsigned char *dest)
+{
+  int i, value;
+
+  for(i=0; i<n; i++)
+  {
+    value = (buf[i] / quant->bitvalue) - quant->offset;
+
+    if(value > quant->digmax)
+    {
+      value = quant->digmax;
+    }
+
+    if(value < quant->digmin)
+    {
+      value = quant->digmin;
+    }
+
+    dest[i * 3] = value & 0xff;
+
+    dest[i * 3 + 1] = (value >> 8) & 0xff;
+
+    dest[i * 3 + 2] = (value >> 16) & 0xff;
+  }
+}
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,159 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#ifndef WAVEGEN_INCLUDED
+#define WAVEGEN_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdlib.h>
+#include <math.h>
+
+
+/* The sine generator is a recursive oscillator (complex rotator).
+ * Every WAVEGEN_OSC_RENORM samples the rotator is re-seeded with sin() and cos()
+ * of the exact phase. This bounds the accumulated rounding error of the rotator
+ * to about 1e-12 times the peak amplitude, independent of the length of the file.
+ * Compared to calling sin() for every sample, the digital samples differ at most one LSB,
+ * and only for samples that are within 1e-12 of a quantization boundary.
+ * The oscillator runs WAVEGEN_OSC_LANES interleaved rotators, each one advancing
+ * WAVEGEN_OSC_LANES samples per step. WAVEGEN_OSC_RENORM must be a multiple of WAVEGEN_OSC_LANES.
+ */
+#define WAVEGEN_OSC_RENORM  (1024)
+#define WAVEGEN_OSC_LANES      (8)
+
+/* number of samples that are generated at once before they are converted to digital samples */
+#define WAVEGEN_CHUNK  (WAVEGEN_OSC_RENORM)
+
+/* The phase of every sample is calculated from its index: phase + (i * step).
+ * Version 1.10 accumulated the phase sample after sample, compared to that version samples on the slopes
+ * of the ramp and the triangle can differ one LSB (about 0.2% of the samples) and an edge of a square
+ * or a ramp that falls exactly on a period boundary can move one sample, with both precisions.
+ *
+ * WAVEGEN_PRECISION_EXACT: the SIMD kernels produce exactly the same bits as the scalar kernels
+ * WAVEGEN_PRECISION_FAST: the SIMD kernels may use fused multiply-add, the output can differ
+ *                         one LSB from the scalar kernels for samples close to a quantization
+ *                         boundary or close to the edge of a square/ramp/triangle wave
+ *
+ * Throughput on one core with AVX2, measured with edfbench --kernels (kernels only) and edfbench (end to end):
+ * The AVX2 kernels are 6 - 7 times faster than the scalar kernels for the square, 4.5 - 6.5 times for the ramp,
+ * 3 - 4.5 times for the triangle and 3 - 5 times for the sine. The FMA kernels are 4 - 20% faster than
+ * the exact kernels. End to end (kernels, conversion to digital samples and packing) the gain against
+ * the scalar kernels is only 1.4 - 2.2 times, the 4x target is not reached there, the conversion dominates.
+ * Against the generation loop of version 1.10 the gain is 15 - 50 times kernels only and 4.5 - 7 times end to end.
+ */
+#define WAVEGEN_PRECISION_FAST   (0)
+#define WAVEGEN_PRECISION_EXACT  (1)
+
+/* WAVEGEN_PRECISION_SCALAR: always use the scalar reference kernels (for benchmarks) */
+#define WAVEGEN_PRECISION_SCALAR (2)
+
+
+/* parameters of a periodic waveform, phase and step are expressed in cycles (not radians) */
+struct wavegen_par_struct
+{
+  double phase;      /* phase of the first sample, must be >= 0 */
+  double step;       /* phase increment per sample (signalfrequency / samplefrequency) */
+  double amp;        /* peak amplitude */
+  double dutycycle;  /* 0.001 - 1.0 */
+  double dc_offset;
+};
+
+/* precomputed physical to digital conversion of one signal, identical to the conversion used by edflib */
+struct wavegen_quant_struct
+{
+  double bitvalue;
+  double offset;
+  int digmax;
+  int digmin;
+};
+
+typedef void (*wavegen_kernel_t)(double *, int, int, const struct wavegen_par_struct *);
+
+
+/* Selects the fastest kernels supported by the cpu, must be called once before generating */
+void wavegen_init(int precision);
+
+/* returns the name of the instruction set used by the selected kernels e.g. "avx2" */
+const char * wavegen_get_isa(void);
+
+/* Writes the samples start ... start + n - 1 into buf[0] ... buf[n - 1]
+ * Sample i has phase: par->phase + (i * par->step)
+ * For the sine, start must be a multiple of WAVEGEN_OSC_RENORM
+ */
+void wavegen_sine(double *buf, int start, int n, const struct wavegen_par_struct *par);
+void wavegen_square(double *buf, int start, int n, const struct wavegen_par_struct *par);
+void wavegen_ramp(double *buf, int start, int n, const struct wavegen_par_struct *par);
+void wavegen_triangle(double *buf, int start, int n, const struct wavegen_par_struct *par);
+
+/* scalar reference kernels, also used for the tail of the SIMD kernels */
+void wavegen_sine_scalar(double *buf, int start, int n, const struct wavegen_par_struct *par);
+void wavegen_square_scalar(double *buf, int start, int n, const struct wavegen_par_struct *par);
+void wavegen_ramp_scalar(double *buf, int start, int n, const struct wavegen_par_struct *par);
+void wavegen_triangle_scalar(double *buf, int start, int n, const struct wavegen_par_struct *par);
+
+/* seeds the oscillator lanes for the block starting at sample i */
+void wavegen_osc_seed(double *s, double *c, int i, const struct wavegen_par_struct *par);
+
+/* calculates the physical to digital conversion from the signal parameters */
+void wavegen_quant_init(struct wavegen_quant_struct *quant, double physmax, double physmin, int digmax, int digmin);
+
+/* Converts n physical samples to digital samples and stores them in dest */
+/* as 16-bit (EDF) or 24-bit (BDF) little endian two's complement */
+void wavegen_pack_edf(const double *buf, int n, const struct wavegen_quant_struct *quant, unsigned char *dest);
+void wavegen_pack_bdf(const double *buf, int n, const struct wavegen_quant_struct *quant, unsigned char *dest);
+
+#if defined(__x86_64__)
+void wavegen_sine_sse2(double *, int, int, const struct wavegen_par_struct *);
+void wavegen_square_sse2(double *, int, int, const struct wavegen_par_struct *);
+void wavegen_ramp_sse2(double *, int, int, const struct wavegen_par_struct *);
+void wavegen_triangle_sse2(double *, int, int, const struct wavegen_par_struct *);
+
+void wavegen_sine_avx2(double *, int, int, const struct wavegen_par_struct *);
+void wavegen_square_avx2(double *, int, int, const struct wavegen_par_struct *);
+void wavegen_ramp_avx2(double *, int, int, const struct wavegen_par_struct *);
+void wavegen_triangle_avx2(double *, int, int, const struct wavegen_par_struct *);
+
+void wavegen_sine_avx2_fma(double *, int, int, const struct wavegen_par_struct *);
+void wavegen_square_avx2_fma(double *, int, int, const struct wavegen_par_struct *);
+void wavegen_ramp_avx2_fma(double *, int, int, const struct wavegen_par_struct *);
+void wavegen_triangle_avx2_fma(double *, int, int, const struct wavegen_par_struct *);
+#endif
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
+
+
@@ -0,0 +1,263 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+/* This file is compiled twice: with "-mavx2" and with "-mavx2 -mfma -DWAVEGEN_FMA" */
+/* The kernels without fma produce exactly the same bits as the scalar kernels in wavegen.c */
+
+
+#include "wavegen.h"
+
+
+#if defined(__x86_64__)
+
+#include <immintrin.h>
+
+
+#ifdef WAVEGEN_FMA
+
+#define WAVEGEN_FN(name)  wavegen_##name##_avx2_fma
+#define WAVEGEN_MADD(a, b, c)  _mm256_fmadd_pd((a), (b), (c))
+#define WAVEGEN_MSUB(a, b, c)  _mm256_fmsub_pd((a), (b), (c))
+
+#else
+
+#define WAVEGEN_FN(name)  wavegen_##name##_avx2
+#define WAVEGEN_MADD(a, b, c)  _mm256_add_pd(_mm256_mul_pd((a), (b)), (c))
+#define WAVEGEN_MSUB(a, b, c)  _mm256_sub_pd(_mm256_mul_pd((a), (b)), (c))
+
+#endif
+
+
+/* returns the fractional part of the phase of the four samples starting at sample i */
+static inline __m256d wavegen_phase_avx2(int i, __m256d vidx, __m256d vstep, __m256d vphase)
+{
+  __m256d x;
+
+  x = _mm256_add_pd(_mm256_set1_pd((double)i), vidx);
+
+  x = WAVEGEN_MADD(x, vstep, vphase);
+
+  return _mm256_sub_pd(x, _mm256_floor_pd(x));
+}
+
+
+void WAVEGEN_FN(sine)(double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  int i, j, k, blk;
+
+  double s[WAVEGEN_OSC_LANES],
+         c[WAVEGEN_OSC_LANES],
+         tmp[WAVEGEN_OSC_LANES],
+         sin_w,
+         cos_w;
+
+  __m256d s0, s1, c0, c1, t0, t1,
+          vsin,
+          vcos,
+          vamp,
+          voffset;
+
+  sin_w = sin((M_PI * 2.0) * (par->step * WAVEGEN_OSC_LANES));
+
+  cos_w = cos((M_PI * 2.0) * (par->step * WAVEGEN_OSC_LANES));
+
+  vsin = _mm256_set1_pd(sin_w);
+
+  vcos = _mm256_set1_pd(cos_w);
+
+  vamp = _mm256_set1_pd(par->amp);
+
+  voffset = _mm256_set1_pd(par->dc_offset);
+
+  for(i=0; i<n; i+=WAVEGEN_OSC_RENORM)
+  {
+    wavegen_osc_seed(s, c, start + i, par);
+
+    s0 = _mm256_loadu_pd(s);
+    s1 = _mm256_loadu_pd(s + 4);
+    c0 = _mm256_loadu_pd(c);
+    c1 = _mm256_loadu_pd(c + 4);
+
+    blk = n - i;
+
+    if(blk > WAVEGEN_OSC_RENORM)
+    {
+      blk = WAVEGEN_OSC_RENORM;
+    }
+
+    for(j=0; j<blk; j+=WAVEGEN_OSC_LANES)
+    {
+      if((j + WAVEGEN_OSC_LANES) <= blk)
+      {
+        _mm256_storeu_pd(buf + i + j, WAVEGEN_MADD(s0, vamp, voffset));
+        _mm256_storeu_pd(buf + i + j + 4, WAVEGEN_MADD(s1, vamp, voffset));
+      }
+      else
+      {
+        _mm256_storeu_pd(tmp, WAVEGEN_MADD(s0, vamp, voffset));
+        _mm256_storeu_pd(tmp + 4, WAVEGEN_MADD(s1, vamp, voffset));
+
+        for(k=0; (j + k)<blk; k++)
+        {
+          buf[i + j + k] = tmp[k];
+        }
+      }
+
+      t0 = WAVEGEN_MSUB(c0, vcos, _mm256_mul_pd(s0, vsin));
+      t1 = WAVEGEN_MSUB(c1, vcos, _mm256_mul_pd(s1, vsin));
+
+      s0 = WAVEGEN_MADD(s0, vcos, _mm256_mul_pd(c0, vsin));
+      s1 = WAVEGEN_MADD(s1, vcos, _mm256_mul_pd(c1, vsin));
+
+      c0 = t0;
+      c1 = t1;
+    }
+  }
+}
+
+
+void WAVEGEN_FN(square)(double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  int i;
+
+  __m256d x,
+          vidx,
+          vstep,
+          vphase,
+          vduty,
+          vhi,
+          vlo;
+
+  vidx = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+  vstep = _mm256_set1_pd(par->step);
+  vphase = _mm256_set1_pd(par->phase);
+  vduty = _mm256_set1_pd(par->dutycycle);
+  vhi = _mm256_set1_pd(par->amp + par->dc_offset);
+  vlo = _mm256_set1_pd(-par->amp + par->dc_offset);
+
+  for(i=0; (i + 4)<=n; i+=4)
+  {
+    x = wavegen_phase_avx2(start + i, vidx, vstep, vphase);
+
+    _mm256_storeu_pd(buf + i, _mm256_blendv_pd(vlo, vhi, _mm256_cmp_pd(x, vduty, _CMP_LT_OQ)));
+  }
+
+  wavegen_square_scalar(buf + i, start + i, n - i, par);
+}
+
+
+void WAVEGEN_FN(ramp)(double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  int i;
+
+  __m256d x, y,
+          vidx,
+          vstep,
+          vphase,
+          vduty,
+          vslope,
+          vamp,
+          voffset,
+          vlo;
+
+  vidx = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+  vstep = _mm256_set1_pd(par->step);
+  vphase = _mm256_set1_pd(par->phase);
+  vduty = _mm256_set1_pd(par->dutycycle);
+  vslope = _mm256_set1_pd(par->amp * (2.0 / par->dutycycle));
+  vamp = _mm256_set1_pd(par->amp);
+  voffset = _mm256_set1_pd(par->dc_offset);
+  vlo = _mm256_set1_pd(-par->amp + par->dc_offset);
+
+  for(i=0; (i + 4)<=n; i+=4)
+  {
+    x = wavegen_phase_avx2(start + i, vidx, vstep, vphase);
+
+    y = _mm256_add_pd(WAVEGEN_MSUB(vslope, x, vamp), voffset);
+
+    _mm256_storeu_pd(buf + i, _mm256_blendv_pd(vlo, y, _mm256_cmp_pd(x, vduty, _CMP_LT_OQ)));
+  }
+
+  wavegen_ramp_scalar(buf + i, start + i, n - i, par);
+}
+
+
+void WAVEGEN_FN(triangle)(double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  int i;
+
+  __m256d x, y, rise, fall,
+          vidx,
+          vstep,
+          vphase,
+          vduty,
+          vhalf,
+          vslope,
+          vamp,
+          voffset,
+          vlo;
+
+  vidx = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+  vstep = _mm256_set1_pd(par->step);
+  vphase = _mm256_set1_pd(par->phase);
+  vduty = _mm256_set1_pd(par->dutycycle);
+  vhalf = _mm256_set1_pd(par->dutycycle / 2.0);
+  vslope = _mm256_set1_pd(par->amp * (4.0 / par->dutycycle));
+  vamp = _mm256_set1_pd(par->amp);
+  voffset = _mm256_set1_pd(par->dc_offset);
+  vlo = _mm256_set1_pd(-par->amp + par->dc_offset);
+
+  for(i=0; (i + 4)<=n; i+=4)
+  {
+    x = wavegen_phase_avx2(start + i, vidx, vstep, vphase);
+
+    rise = _mm256_add_pd(_mm256_add_pd(WAVEGEN_MSUB(vslope, x, vamp), voffset), voffset);
+
+    fall = _mm256_add_pd(WAVEGEN_MSUB(vslope, _mm256_sub_pd(vduty, x), vamp), voffset);
+
+    y = _mm256_blendv_pd(vlo, fall, _mm256_cmp_pd(x, vduty, _CMP_LT_OQ));
+
+    y = _mm256_blendv_pd(y, rise, _mm256_cmp_pd(x, vhalf, _CMP_LT_OQ));
+
+    _mm256_storeu_pd(buf + i, y);
+  }
+
+  wavegen_triangle_scalar(buf + i, start + i, n - i, par);
+}
+
+#endif
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,273 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+/* The SSE2 kernels produce exactly the same bits as the scalar kernels in wavegen.c */
+
+
+#include "wavegen.h"
+
+
+#if defined(__x86_64__)
+
+#include <emmintrin.h>
+
+
+/* mask ? a : b */
+static inline __m128d wavegen_select_sse2(__m128d mask, __m128d a, __m128d b)
+{
+  return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+
+/* returns the fractional part of the phase of the two samples starting at sample i */
+/* SSE2 has no floor instruction, adding and subtracting 2^52 rounds to the nearest integer */
+/* this is exact because the phase is never negative and always less than 2^51 */
+static inline __m128d wavegen_phase_sse2(int i, __m128d vidx, __m128d vstep, __m128d vphase)
+{
+  __m128d x, r,
+          magic,
+          one;
+
+  magic = _mm_set1_pd(4503599627370496.0);
+
+  one = _mm_set1_pd(1.0);
+
+  x = _mm_add_pd(_mm_set1_pd((double)i), vidx);
+
+  x = _mm_add_pd(_mm_mul_pd(x, vstep), vphase);
+
+  r = _mm_sub_pd(_mm_add_pd(x, magic), magic);
+
+  r = _mm_sub_pd(r, _mm_and_pd(_mm_cmpgt_pd(r, x), one));
+
+  return _mm_sub_pd(x, r);
+}
+
+
+void wavegen_sine_sse2(double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  int i, j, k, l, blk;
+
+  double s[WAVEGEN_OSC_LANES],
+         c[WAVEGEN_OSC_LANES],
+         tmp[WAVEGEN_OSC_LANES],
+         sin_w,
+         cos_w;
+
+  __m128d vs[WAVEGEN_OSC_LANES / 2],
+          vc[WAVEGEN_OSC_LANES / 2],
+          t,
+          vsin,
+          vcos,
+          vamp,
+          voffset;
+
+  sin_w = sin((M_PI * 2.0) * (par->step * WAVEGEN_OSC_LANES));
+
+  cos_w = cos((M_PI * 2.0) * (par->step * WAVEGEN_OSC_LANES));
+
+  vsin = _mm_set1_pd(sin_w);
+
+  vcos = _mm_set1_pd(cos_w);
+
+  vamp = _mm_set1_pd(par->amp);
+
+  voffset = _mm_set1_pd(par->dc_offset);
+
+  for(i=0; i<n; i+=WAVEGEN_OSC_RENORM)
+  {
+    wavegen_osc_seed(s, c, start + i, par);
+
+    for(l=0; l<(WAVEGEN_OSC_LANES / 2); l++)
+    {
+      vs[l] = _mm_loadu_pd(s + (l * 2));
+      vc[l] = _mm_loadu_pd(c + (l * 2));
+    }
+
+    blk = n - i;
+
+    if(blk > WAVEGEN_OSC_RENORM)
+    {
+      blk = WAVEGEN_OSC_RENORM;
+    }
+
+    for(j=0; j<blk; j+=WAVEGEN_OSC_LANES)
+    {
+      if((j + WAVEGEN_OSC_LANES) <= blk)
+      {
+        for(l=0; l<(WAVEGEN_OSC_LANES / 2); l++)
+        {
+          _mm_storeu_pd(buf + i + j + (l * 2), _mm_add_pd(_mm_mul_pd(vs[l], vamp), voffset));
+        }
+      }
+      else
+      {
+        for(l=0; l<(WAVEGEN_OSC_LANES / 2); l++)
+        {
+          _mm_storeu_pd(tmp + (l * 2), _mm_add_pd(_mm_mul_pd(vs[l], vamp), voffset));
+        }
+
+        for(k=0; (j + k)<blk; k++)
+        {
+          buf[i + j + k] = tmp[k];
+        }
+      }
+
+      for(l=0; l<(WAVEGEN_OSC_LANES / 2); l++)
+      {
+        t = _mm_sub_pd(_mm_mul_pd(vc[l], vcos), _mm_mul_pd(vs[l], vsin));
+
+        vs[l] = _mm_add_pd(_mm_mul_pd(vs[l], vcos), _mm_mul_pd(vc[l], vsin));
+
+        vc[l] = t;
+      }
+    }
+  }
+}
+
+
+void wavegen_square_sse2(double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  int i;
+
+  __m128d x,
+          vidx,
+          vstep,
+          vphase,
+          vduty,
+          vhi,
+          vlo;
+
+  vidx = _mm_set_pd(1.0, 0.0);
+  vstep = _mm_set1_pd(par->step);
+  vphase = _mm_set1_pd(par->phase);
+  vduty = _mm_set1_pd(par->dutycycle);
+  vhi = _mm_set1_pd(par->amp + par->dc_offset);
+  vlo = _mm_set1_pd(-par->amp + par->dc_offset);
+
+  for(i=0; (i + 2)<=n; i+=2)
+  {
+    x = wavegen_phase_sse2(start + i, vidx, vstep, vphase);
+
+    _mm_storeu_pd(buf + i, wavegen_select_sse2(_mm_cmplt_pd(x, vduty), vhi, vlo));
+  }
+
+  wavegen_square_scalar(buf + i, start + i, n - i, par);
+}
+
+
+void wavegen_ramp_sse2(double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  int i;
+
+  __m128d x, y,
+          vidx,
+          vstep,
+          vphase,
+          vduty,
+          vslope,
+          vamp,
+          voffset,
+          vlo;
+
+  vidx = _mm_set_pd(1.0, 0.0);
+  vstep = _mm_set1_pd(par->step);
+  vphase = _mm_set1_pd(par->phase);
+  vduty = _mm_set1_pd(par->dutycycle);
+  vslope = _mm_set1_pd(par->amp * (2.0 / par->dutycycle));
+  vamp = _mm_set1_pd(par->amp);
+  voffset = _mm_set1_pd(par->dc_offset);
+  vlo = _mm_set1_pd(-par->amp + par->dc_offset);
+
+  for(i=0; (i + 2)<=n; i+=2)
+  {
+    x = wavegen_phase_sse2(start + i, vidx, vstep, vphase);
+
+    y = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(vslope, x), vamp), voffset);
+
+    _mm_storeu_pd(buf + i, wavegen_select_sse2(_mm_cmplt_pd(x, vduty), y, vlo));
+  }
+
+  wavegen_ramp_scalar(buf + i, start + i, n - i, par);
+}
+
+
+void wavegen_triangle_sse2(double *buf, int start, int n, const struct wavegen_par_struct *par)
+{
+  int i;
+
+  __m128d x, y, rise, fall,
+          vidx,
+          vstep,
+          vphase,
+          vduty,
+          vhalf,
+          vslope,
+          vamp,
+          voffset,
+          vlo;
+
+  vidx = _mm_set_pd(1.0, 0.0);
+  vstep = _mm_set1_pd(par->step);
+  vphase = _mm_set1_pd(par->phase);
+  vduty = _mm_set1_pd(par->dutycycle);
+  vhalf = _mm_set1_pd(par->dutycycle / 2.0);
+  vslope = _mm_set1_pd(par->amp * (4.0 / par->dutycycle));
+  vamp = _mm_set1_pd(par->amp);
+  voffset = _mm_set1_pd(par->dc_offset);
+  vlo = _mm_set1_pd(-par->amp + par->dc_offset);
+
+  for(i=0; (i + 2)<=n; i+=2)
+  {
+    x = wavegen_phase_sse2(start + i, vidx, vstep, vphase);
+
+    rise = _mm_add_pd(_mm_add_pd(_mm_sub_pd(_mm_mul_pd(vslope, x), vamp), voffset), voffset);
+
+    fall = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(vslope, _mm_sub_pd(vduty, x)), vamp), voffset);
+
+    y = wavegen_select_sse2(_mm_cmplt_pd(x, vduty), fall, vlo);
+
+    y = wavegen_select_sse2(_mm_cmplt_pd(x, vhalf), rise, y);
+
+    _mm_storeu_pd(buf + i, y);
+  }
+
+  wavegen_triangle_scalar(buf + i, start + i, n - i, par);
+}
+
+#endif
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,749 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+
+
+#include "writebehind.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define WB_HAVE_URING
+#endif
+#endif
+
+#ifdef WB_HAVE_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+
+#define WB_ALIGN  (4096)
+
+
+static void * wb_writer(void *);
+static long long wb_time_ns(void);
+
+#ifdef WB_HAVE_URING
+static int wb_uring_init(struct wb_struct *);
+static void wb_uring_exit(struct wb_struct *);
+static int wb_uring_push(struct wb_struct *, int);
+static int wb_uring_wait(struct wb_struct *);
+static void wb_uring_reap(struct wb_struct *);
+#endif
+
+
+
+struct wb_struct * wb_create(int fd, int depth, size_t buf_sz, int backend)
+{
+  int i;
+
+  struct wb_struct *wb;
+
+  if((fd < 0) || (depth < 1) || (depth > WB_MAX_DEPTH) || (buf_sz < 1))
+  {
+    return NULL;
+  }
+
+  wb = (struct wb_struct *)calloc(1, sizeof(struct wb_struct));
+  if(wb == NULL)
+  {
+    return NULL;
+  }
+
+  wb->fd = fd;
+
+  wb->depth = depth;
+
+  wb->ring_fd = -1;
+
+  wb->buf_sz = ((buf_sz + WB_ALIGN - 1) / WB_ALIGN) * WB_ALIGN;
+
+  if(posix_memalign((void **)&wb->mem, WB_ALIGN, wb->buf_sz * depth))
+  {
+    free(wb);
+
+    return NULL;
+  }
+
+  for(i=0; i<depth; i++)
+  {
+    wb->free_list[i] = i;
+  }
+
+  wb->free_cnt = depth;
+
+  pthread_mutex_init(&wb->mtx, NULL);
+
+  pthread_cond_init(&wb->cond, NULL);
+
+  wb->backend = WB_BACKEND_THREADS;
+
+#ifdef WB_HAVE_URING
+  if((backend == WB_BACKEND_URING) && !wb_uring_init(wb))
+  {
+    wb->backend = WB_BACKEND_URING;
+
+    return wb;
+  }
+#else
+  (void)backend;
+#endif
+
+  for(i=0; i<WB_THREADS; i++)
+  {
+    if(pthread_create(&wb->tid[i], NULL, wb_writer, wb))
+    {
+      break;
+    }
+
+    wb->threads++;
+  }
+
+  if(!wb->threads)
+  {
+    wb_destroy(wb);
+
+    return NULL;
+  }
+
+  return wb;
+}
+
+
+unsigned char * wb_get_buf(struct wb_struct *wb)
+{
+  int idx;
+
+  long long t0;
+
+  pthread_mutex_lock(&wb->mtx);
+
+  if(!wb->free_cnt && !wb->err)
+  {
+    wb->stalls++;
+
+    t0 = wb_time_ns();
+
+    while(!wb->free_cnt && !wb->err)
+    {
+#ifdef WB_HAVE_URING
+      if((wb->backend == WB_BACKEND_URING) && wb->in_flight)
+      {
+        /* the completions are handled by the thread that needs a buffer */
+        if(wb_uring_wait(wb))
+        {
+          wb->err = 1;
+        }
+
+        continue;
+      }
+#endif
+      pthread_cond_wait(&wb->cond, &wb->mtx);
+    }
+
+    wb->stall_ns += wb_time_ns() - t0;
+  }
+
+  if(wb->err)
+  {
+    pthread_mutex_unlock(&wb->mtx);
+
+    return NULL;
+  }
+
+  idx = wb->free_list[--wb->free_cnt];
+
+  pthread_mutex_unlock(&wb->mtx);
+
+  return wb->mem + (wb->buf_sz * idx);
+}
+
+
+int wb_submit(struct wb_struct *wb, unsigned char *buf, size_t len, long long offset)
+{
+  int idx;
+
+  idx = (buf - wb->mem) / wb->buf_sz;
+
+  pthread_mutex_lock(&wb->mtx);
+
+  if(wb->err || (len > wb->buf_sz))
+  {
+    wb->free_list[wb->free_cnt++] = idx;
+
+    wb->err = 1;
+
+    pthread_cond_broadcast(&wb->cond);
+
+    pthread_mutex_unlock(&wb->mtx);
+
+    return -1;
+  }
+
+  wb->len[idx] = len;
+
+  wb->offset[idx] = offset;
+
+  wb->iov[idx].iov_base = buf;
+
+  wb->iov[idx].iov_len = len;
+
+  wb->in_flight++;
+
+#ifdef WB_HAVE_URING
+  if(wb->backend == WB_BACKEND_URING)
+  {
+    if(wb_uring_push(wb, idx))
+    {
+      wb->in_flight--;
+
+      wb->free_list[wb->free_cnt++] = idx;
+
+      wb->err = 1;
+    }
+
+    pthread_cond_broadcast(&wb->cond);
+
+    pthread_mutex_unlock(&wb->mtx);
+
+    return wb->err ? -1 : 0;
+  }
+#endif
+
+  wb->queue[(wb->queue_head + wb->queue_cnt) % wb->depth] = idx;
+
+  wb->queue_cnt++;
+
+  pthread_cond_broadcast(&wb->cond);
+
+  pthread_mutex_unlock(&wb->mtx);
+
+  return 0;
+}
+
+
+void wb_abort(struct wb_struct *wb, unsigned char *buf)
+{
+  pthread_mutex_lock(&wb->mtx);
+
+  wb->free_list[wb->free_cnt++] = (buf - wb->mem) / wb->buf_sz;
+
+  wb->err = 1;
+
+  pthread_cond_broadcast(&wb->cond);
+
+  pthread_mutex_unlock(&wb->mtx);
+}
+
+
+int wb_wait(struct wb_struct *wb)
+{
+  int err;
+
+  pthread_mutex_lock(&wb->mtx);
+
+  while(wb->in_flight)
+  {
+#ifdef WB_HAVE_URING
+    if(wb->backend == WB_BACKEND_URING)
+    {
+      if(wb_uring_wait(wb))
+      {
+        wb->err = 1;
+
+        break;
+      }
+
+      continue;
+    }
+#endif
+    pthread_cond_wait(&wb->cond, &wb->mtx);
+  }
+
+  err = wb->err;
+
+  pthread_mutex_unlock(&wb->mtx);
+
+  return err ? -1 : 0;
+}
+
+
+const char * wb_get_backend(struct wb_struct *wb)
+{
+  if(wb->backend == WB_BACKEND_URING)
+  {
+    return "io_uring";
+  }
+
+  return "threads";
+}
+
+
+void wb_destroy(struct wb_struct *wb)
+{
+  int i,
+      in_flight=0;
+
+  if(wb == NULL)
+  {
+    return;
+  }
+
+  wb_wait(wb);
+
+  pthread_mutex_lock(&wb->mtx);
+
+#ifdef WB_HAVE_URING
+  /* wb_wait() gives up after an error, the kernel may still be writing from the buffers */
+  while((wb->backend == WB_BACKEND_URING) && wb->in_flight)
+  {
+    if(wb_uring_wait(wb))
+    {
+      break;
+    }
+  }
+
+  in_flight = wb->in_flight;
+#endif
+
+  wb->stop = 1;
+
+  pthread_cond_broadcast(&wb->cond);
+
+  pthread_mutex_unlock(&wb->mtx);
+
+  for(i=0; i<wb->threads; i++)
+  {
+    pthread_join(wb->tid[i], NULL);
+  }
+
+#ifdef WB_HAVE_URING
+  wb_uring_exit(wb);
+#endif
+
+  pthread_cond_destroy(&wb->cond);
+
+  pthread_mutex_destroy(&wb->mtx);
+
+  /* closing the ring cancels the outstanding writes asynchronously, */
+  /* the buffers are not freed when the kernel could still read from them */
+  if(!in_flight)
+  {
+    free(wb->mem);
+  }
+
+  free(wb);
+}
+
+
+/* fallback: the buffers are written with pwrite() by a few threads */
+static void * wb_writer(void *arg)
+{
+  int idx, err;
+
+  ssize_t n;
+
+  unsigned char *ptr;
+
+  size_t len;
+
+  long long offset;
+
+  struct wb_struct *wb;
+
+  wb = (struct wb_struct *)arg;
+
+  pthread_mutex_lock(&wb->mtx);
+
+  while(1)
+  {
+    while(!wb->queue_cnt && !wb->stop)
+    {
+      pthread_cond_wait(&wb->cond, &wb->mtx);
+    }
+
+    if(!wb->queue_cnt)
+    {
+      break;
+    }
+
+    idx = wb->queue[wb->queue_head];
+
+    wb->queue_head = (wb->queue_head + 1) % wb->depth;
+
+    wb->queue_cnt--;
+
+    pthread_mutex_unlock(&wb->mtx);
+
+    ptr = wb->mem + (wb->buf_sz * idx);
+
+    len = wb->len[idx];
+
+    offset = wb->offset[idx];
+
+    err = 0;
+
+    while(len > 0)
+    {
+      n = pwrite(wb->fd, ptr, len, offset);
+
+      if(n < 1)
+      {
+        if((n < 0) && (errno == EINTR))
+        {
+          continue;
+        }
+
+        err = 1;
+
+        break;
+      }
+
+      ptr += n;
+
+      offset += n;
+
+      len -= n;
+    }
+
+    pthread_mutex_lock(&wb->mtx);
+
+    if(err)
+    {
+      wb->err = 1;
+    }
+
+    wb->free_list[wb->free_cnt++] = idx;
+
+    wb->in_flight--;
+
+    pthread_cond_broadcast(&wb->cond);
+  }
+
+  pthread_mutex_unlock(&wb->mtx);
+
+  return NULL;
+}
+
+
+static long long wb_time_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+
+#ifdef WB_HAVE_URING
+
+/* There's no dependency on liburing, the rings are set up with the raw system calls. */
+/* A submission queue entry is consumed by the kernel in io_uring_enter(), the submission queue */
+/* can't overflow because there are never more than depth writes in flight. */
+static int wb_uring_init(struct wb_struct *wb)
+{
+  struct io_uring_params p;
+
+  unsigned char *sq, *cq;
+
+  memset(&p, 0, sizeof(struct io_uring_params));
+
+  wb->ring_fd = syscall(__NR_io_uring_setup, wb->depth, &p);
+  if(wb->ring_fd < 0)
+  {
+    wb->ring_fd = -1;
+
+    return -1;
+  }
+
+  wb->sq_sz = p.sq_off.array + (p.sq_entries * sizeof(unsigned int));
+
+  wb->cq_sz = p.cq_off.cqes + (p.cq_entries * sizeof(struct io_uring_cqe));
+
+  if(p.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if(wb->cq_sz > wb->sq_sz)
+    {
+      wb->sq_sz = wb->cq_sz;
+    }
+
+    wb->cq_sz = 0;
+  }
+
+  wb->sq_ptr = mmap(NULL, wb->sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, wb->ring_fd, IORING_OFF_SQ_RING);
+  if(wb->sq_ptr == MAP_FAILED)
+  {
+    wb->sq_ptr = NULL;
+
+    wb_uring_exit(wb);
+
+    return -1;
+  }
+
+  if(wb->cq_sz)
+  {
+    wb->cq_ptr = mmap(NULL, wb->cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, wb->ring_fd, IORING_OFF_CQ_RING);
+    if(wb->cq_ptr == MAP_FAILED)
+    {
+      wb->cq_ptr = NULL;
+
+      wb_uring_exit(wb);
+
+      return -1;
+    }
+  }
+  else
+  {
+    wb->cq_ptr = wb->sq_ptr;
+  }
+
+  wb->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+
+  wb->sqes = mmap(NULL, wb->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, wb->ring_fd, IORING_OFF_SQES);
+  if(wb->sqes == MAP_FAILED)
+  {
+    wb->sqes = NULL;
+
+    wb_uring_exit(wb);
+
+    return -1;
+  }
+
+  sq = (unsigned char *)wb->sq_ptr;
+
+  cq = (unsigned char *)wb->cq_ptr;
+
+  wb->sq_tail = (unsigned int *)(sq + p.sq_off.tail);
+
+  wb->sq_mask = (unsigned int *)(sq + p.sq_off.ring_mask);
+
+  wb->sq_array = (unsigned int *)(sq + p.sq_off.array);
+
+  wb->cq_head = (unsigned int *)(cq + p.cq_off.head);
+
+  wb->cq_tail = (unsigned int *)(cq + p.cq_off.tail);
+
+  wb->cq_mask = (unsigned int *)(cq + p.cq_off.ring_mask);
+
+  wb->cqes = cq + p.cq_off.cqes;
+
+  return 0;
+}
+
+
+static void wb_uring_exit(struct wb_struct *wb)
+{
+  if(wb->sqes != NULL)
+  {
+    munmap(wb->sqes, wb->sqes_sz);
+
+    wb->sqes = NULL;
+  }
+
+  if((wb->cq_ptr != NULL) && (wb->cq_ptr != wb->sq_ptr))
+  {
+    munmap(wb->cq_ptr, wb->cq_sz);
+  }
+
+  wb->cq_ptr = NULL;
+
+  if(wb->sq_ptr != NULL)
+  {
+    munmap(wb->sq_ptr, wb->sq_sz);
+
+    wb->sq_ptr = NULL;
+  }
+
+  if(wb->ring_fd >= 0)
+  {
+    close(wb->ring_fd);
+
+    wb->ring_fd = -1;
+  }
+}
+
+
+/* queues the (remaining part of the) buffer and submits it, must be called with the mutex locked */
+static int wb_uring_push(struct wb_struct *wb, int idx)
+{
+  int ret;
+
+  unsigned int tail, pos;
+
+  struct io_uring_sqe *sqe;
+
+  tail = *wb->sq_tail;
+
+  pos = tail & *wb->sq_mask;
+
+  sqe = (struct io_uring_sqe *)wb->sqes + pos;
+
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+  sqe->opcode = IORING_OP_WRITEV;
+
+  sqe->fd = wb->fd;
+
+  sqe->addr = (uint64_t)(uintptr_t)&wb->iov[idx];
+
+  sqe->len = 1;
+
+  sqe->off = wb->offset[idx];
+
+  sqe->user_data = idx;
+
+  wb->sq_array[pos] = pos;
+
+  __atomic_store_n(wb->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  do
+  {
+    ret = syscall(__NR_io_uring_enter, wb->ring_fd, 1, 0, 0, NULL, 0);
+  }
+  while((ret < 0) && (errno == EINTR));
+
+  if(ret != 1)
+  {
+    /* the kernel did not consume the entry, take it back so the caller can reuse the buffer */
+    __atomic_store_n(wb->sq_tail, tail, __ATOMIC_RELEASE);
+
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* Waits for at least one completed write and handles the completions.
+ * The mutex is released while waiting in the kernel, so the other threads can submit their buffers.
+ * Only one thread waits in the kernel, the others wait on the condition variable until it has reaped.
+ * Must be called with the mutex locked, returns with the mutex locked.
+ */
+static int wb_uring_wait(struct wb_struct *wb)
+{
+  int ret;
+
+  if(wb->reaping)
+  {
+    pthread_cond_wait(&wb->cond, &wb->mtx);
+
+    return 0;
+  }
+
+  wb->reaping = 1;
+
+  pthread_mutex_unlock(&wb->mtx);
+
+  do
+  {
+    ret = syscall(__NR_io_uring_enter, wb->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+  }
+  while((ret < 0) && (errno == EINTR));
+
+  pthread_mutex_lock(&wb->mtx);
+
+  wb->reaping = 0;
+
+  if(ret < 0)
+  {
+    pthread_cond_broadcast(&wb->cond);
+
+    return -1;
+  }
+
+  wb_uring_reap(wb);
+
+  return 0;
+}
+
+
+/* handles the completed writes, must be called with the mutex locked */
+static void wb_uring_reap(struct wb_struct *wb)
+{
+  int ret, idx;
+
+  unsigned int head, tail;
+
+  struct io_uring_cqe *cqe;
+
+  head = *wb->cq_head;
+
+  tail = __atomic_load_n(wb->cq_tail, __ATOMIC_ACQUIRE);
+
+  for(; head != tail; head++)
+  {
+    cqe = (struct io_uring_cqe *)wb->cqes + (head & *wb->cq_mask);
+
+    idx = cqe->user_data;
+
+    ret = cqe->res;
+
+    __atomic_store_n(wb->cq_head, head + 1, __ATOMIC_RELEASE);
+
+    if(ret <= 0)
+    {
+      wb->err = 1;
+    }
+    else if((size_t)ret < wb->len[idx])
+      {
+        /* short write, submit the rest */
+        wb->len[idx] -= ret;
+
+        wb->offset[idx] += ret;
+
+        wb->iov[idx].iov_base = (unsigned char *)wb->iov[idx].iov_base + ret;
+
+        wb->iov[idx].iov_len = wb->len[idx];
+
+        if(!wb_uring_push(wb, idx))
+        {
+          continue;
+        }
+
+        wb->err = 1;
+      }
+
+    wb->free_list[wb->free_cnt++] = idx;
+
+    wb->in_flight--;
+  }
+
+  pthread_cond_broadcast(&wb->cond);
+}
+
+#endif
+
@@ -0,0 +1,140 @@
+/*
+***************************************************************************
+*
+* Author: Teunis van Beelen
+*
+* Copyright (C) 2018 - 2022 Teunis van Beelen
+*
+* Email: teuniz@protonmail.com
+*
+***************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************
+*/
+
+
+
+#ifndef WRITEBEHIND_INCLUDED
+#define WRITEBEHIND_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+
+#define WB_MAX_DEPTH   (256)
+
+#define WB_THREADS       (2)
+
+#define WB_BACKEND_URING    (0)
+#define WB_BACKEND_THREADS  (1)
+
+
+/* Write-behind of fixed size buffers at a given file offset.
+ * The caller takes a free buffer, fills it and submits it, the write is done in the background.
+ * At most depth buffers exist, when all of them are in flight wb_get_buf() waits for a write to complete,
+ * so memory use is bounded and a completed buffer is reused for the next write.
+ * The writes are submitted with io_uring, if the kernel doesn't support it (or on other systems)
+ * a few writer threads do the writes with pwrite().
+ * wb_get_buf() and wb_submit() can be called from multiple threads.
+ */
+struct wb_struct
+{
+  int fd;
+  int depth;
+  int backend;
+  size_t buf_sz;
+  unsigned char *mem;
+
+  size_t len[WB_MAX_DEPTH];       /* bytes left to write */
+  long long offset[WB_MAX_DEPTH];
+  struct iovec iov[WB_MAX_DEPTH];
+
+  int free_list[WB_MAX_DEPTH];    /* buffers that can be filled */
+  int free_cnt;
+  int queue[WB_MAX_DEPTH];        /* buffers waiting for a writer thread */
+  int queue_head;
+  int queue_cnt;
+  int in_flight;
+  int err;
+  int stop;
+  int reaping;                    /* a thread waits for completions in io_uring_enter() without the mutex */
+
+  pthread_mutex_t mtx;
+  pthread_cond_t cond;
+  pthread_t tid[WB_THREADS];
+  int threads;
+
+  long long stalls;               /* times wb_get_buf() had to wait for a write */
+  long long stall_ns;
+
+  /* io_uring */
+  int ring_fd;
+  void *sq_ptr;
+  size_t sq_sz;
+  void *cq_ptr;
+  size_t cq_sz;
+  void *sqes;
+  size_t sqes_sz;
+  unsigned int *sq_tail;
+  unsigned int *sq_mask;
+  unsigned int *sq_array;
+  unsigned int *cq_head;
+  unsigned int *cq_tail;
+  unsigned int *cq_mask;
+  void *cqes;
+};
+
+
+/* Creates a write-behind queue for file descriptor fd with depth buffers of buf_sz bytes.
+ * backend is WB_BACKEND_URING (falls back to threads if io_uring is not available) or WB_BACKEND_THREADS.
+ * Returns NULL on error
+ */
+struct wb_struct * wb_create(int fd, int depth, size_t buf_sz, int backend);
+
+/* Returns a free buffer, waits while all buffers are in flight. Returns NULL after a write error */
+unsigned char * wb_get_buf(struct wb_struct *wb);
+
+/* Writes len bytes of buf (returned by wb_get_buf()) at offset in the background. Returns 0 on success, -1 after a write error */
+int wb_submit(struct wb_struct *wb, unsigned char *buf, size_t len, long long offset);
+
+/* Gives back a buffer (returned by wb_get_buf()) that will not be submitted because the caller failed to fill it.
+ * The queue is put in the error state, wb_get_buf() returns NULL from now on.
+ */
+void wb_abort(struct wb_struct *wb, unsigned char *buf);
+
+/* Waits until all submitted writes are complete. Returns 0 if all writes succeeded, otherwise -1 */
+int wb_wait(struct wb_struct *wb);
+
+/* returns the name of the backend that is used e.g. "io_uring" */
+const char * wb_get_backend(struct wb_struct *wb);
+
+/* waits for the writes in flight and frees everything */
+void wb_destroy(struct wb_struct *wb);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
+
+